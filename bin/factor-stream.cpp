@@ -0,0 +1,68 @@
+// factorizes every whitespace separated number of its input, in order, as fast as it can
+// factor-stream [--threads N] [--chunk BYTES] [--window CHUNKS] [--binary] [--stats] [FILE...]
+// no files (or `-`) reads stdin, regular files are mapped, see ivl/stream-factorize.hpp for the output formats
+
+#include <ivl/stream-factorize.hpp>
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+  std::ios::sync_with_stdio(false);
+
+  ivl::nt::StreamOptions options;
+  bool stats = false;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const auto value = [&]() -> std::size_t {
+      if (i + 1 >= argc) {
+        std::cerr << "missing value after " << arg << std::endl;
+        std::exit(2);
+      }
+      return std::stoul(argv[++i]);
+    };
+    if (arg == "--threads") {
+      options.threads = value();
+    } else if (arg == "--chunk") {
+      options.chunk_bytes = value();
+    } else if (arg == "--window") {
+      options.window = value();
+    } else if (arg == "--binary") {
+      options.format = ivl::nt::StreamFormat::binary;
+    } else if (arg == "--stats") {
+      stats = true;
+    } else if (arg.starts_with("--")) {
+      std::cerr << "usage: " << argv[0]
+                << " [--threads N] [--chunk BYTES] [--window CHUNKS] [--binary] [--stats] [FILE...]" << std::endl;
+      return 2;
+    } else {
+      files.emplace_back(arg);
+    }
+  }
+  if (files.empty()) files.emplace_back("-");
+
+  try {
+    for (const auto &file : files) {
+      const auto start = std::chrono::steady_clock::now();
+      const ivl::nt::StreamStats s = file == "-" ? ivl::nt::factorize_stream(std::cin, std::cout, options)
+                                                 : ivl::nt::factorize_file(file, std::cout, options);
+      if (stats) {
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cerr << file << ": " << s.numbers << " numbers, " << s.bytes_in << " bytes in, " << s.bytes_out
+                  << " bytes out, " << s.chunks << " chunks, " << elapsed.count() << "s, "
+                  << static_cast<double>(s.numbers) / elapsed.count() << " numbers/s" << std::endl;
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cout.flush();
+    std::cerr << argv[0] << ": " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
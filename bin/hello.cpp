@@ -38,7 +38,7 @@ int main()
     ivl::nt::DivisorIterable di{ f };
     std::cout << "divisors: ";
     for (auto d : di)// ivl::nt::DivisorIterable{f})
-      std::cout << "[" << d << "] ";
+      std::cout << "[" << d.factorization << "] ";
     std::cout << std::endl;
 
     // std::cout << "tau(" << n << ") -- " << ivl::nt::tau_v1(f,
@@ -32,7 +32,7 @@ int main()
 
     ivl::nt::DivisorIterable di{ factorize(lazy) };
     std::cout << "divisors: ";
-    for (auto d : ivl::nt::DivisorIterable{ factorize(lazy) }) std::cout << ivl::nt::id(d) << " ";
+    for (const auto &d : ivl::nt::DivisorIterable{ factorize(lazy) }) std::cout << d.value << " ";
     // std::cout << "[" << d << "] ";
     std::cout << std::endl;
 
@@ -0,0 +1,122 @@
+// writes a table file (see ivl/table-file.hpp) for everything up to a limit, or checks one
+// make-tables --limit N [--threads N] [--primes] [--spf] [--tau] [--sigma] [--phi] [--mu] FILE
+// make-tables --verify FILE
+// sections are named after their flag, spf entries are 16 bit below 2^32 and 32 bit above,
+// tau is 32 bit, sigma and phi 64 bit, mu 8 bit
+// every section is sieved and written a window at a time, the limit isn't bounded by memory
+
+#include <ivl/multi-fns.hpp>
+#include <ivl/multi-table.hpp>
+#include <ivl/spf.hpp>
+#include <ivl/table-file.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// values a window at a time, only one window of the table is ever in memory
+constexpr std::uint64_t window = 1 << 22;
+
+template<typename R, typename Callable>
+void add_function(ivl::nt::TableFileWriter &out,
+  std::string_view name,
+  Callable &&callable,
+  std::uint64_t limit,
+  std::uint32_t threads)
+{
+  out.begin_section(name, ivl::nt::TableKind::values, ivl::nt::table_element<R>(), limit);
+  ivl::nt::AlignedTable<R> table(static_cast<std::size_t>(std::min(limit + 1, window)));
+  for (std::uint64_t first = 0; first <= limit; first += window) {
+    const auto part = table.span().first(static_cast<std::size_t>(std::min(limit + 1 - first, window)));
+    if (first == 0) part[0] = 0;
+    ivl::nt::multiplicative_table_window(callable, part, first, threads);
+    out.append(part.data(), part.size_bytes());
+  }
+  out.end_section();
+}
+
+int verify(const std::string &path)
+{
+  const ivl::nt::TableFile file{ path };
+  file.verify();
+  for (const auto &s : file.sections()) {
+    std::cout << s.name << ": limit " << s.limit << ", " << s.bytes << " bytes" << std::endl;
+  }
+  return 0;
+}
+
+}// namespace
+
+int main(int argc, char **argv)
+{
+  std::uint64_t limit = 0;
+  std::uint32_t threads = 1;
+  std::vector<std::string> sections;
+  std::string path, verify_path;
+  const auto usage = [&] {
+    std::cerr << "usage: " << argv[0]
+              << " --limit N [--threads N] [--primes] [--spf] [--tau] [--sigma] [--phi] [--mu] FILE\n"
+              << "       " << argv[0] << " --verify FILE" << std::endl;
+    return 2;
+  };
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if ((arg == "--limit" || arg == "--threads" || arg == "--verify") && i + 1 >= argc) return usage();
+    if (arg == "--limit") {
+      limit = std::stoull(argv[++i]);
+    } else if (arg == "--threads") {
+      threads = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+    } else if (arg == "--verify") {
+      verify_path = argv[++i];
+    } else if (arg == "--primes" || arg == "--spf" || arg == "--tau" || arg == "--sigma" || arg == "--phi"
+               || arg == "--mu") {
+      sections.emplace_back(arg.substr(2));
+    } else if (arg.starts_with("--") || !path.empty()) {
+      return usage();
+    } else {
+      path = arg;
+    }
+  }
+
+  try {
+    if (!verify_path.empty()) return verify(verify_path);
+    if (path.empty() || limit < 2 || sections.empty()) return usage();
+    ivl::nt::TableFileWriter out{ path };
+    for (const auto &name : sections) {
+      const auto start = std::chrono::steady_clock::now();
+      if (name == "primes") {
+        out.add_primes(name, limit);
+      } else if (name == "spf") {
+        if (limit < (std::uint64_t{ 1 } << 32)) {
+          out.add_spf<std::uint16_t>(name, limit);
+        } else {
+          out.add_spf<std::uint32_t>(name, limit);
+        }
+      } else if (name == "tau") {
+        add_function<std::uint32_t>(out, name, [](auto, auto e) { return e + 1; }, limit, threads);
+      } else if (name == "sigma") {
+        add_function<std::uint64_t>(out, name, ivl::nt::powsum, limit, threads);
+      } else if (name == "phi") {
+        add_function<std::uint64_t>(out, name, ivl::nt::phi_prime_power, limit, threads);
+      } else if (name == "mu") {
+        add_function<std::int8_t>(out, name, ivl::nt::mu_prime_power, limit, threads);
+      }
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      std::cerr << name << ": " << elapsed.count() << "s" << std::endl;
+    }
+    out.finish();
+  } catch (const std::exception &e) {
+    std::cerr << argv[0] << ": " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
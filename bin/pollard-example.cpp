@@ -1,28 +1,44 @@
 // #include <ivl/bignum.hpp>
-// #include <ivl/pollard-rho.hpp>
+#include <ivl/batch-gcd.hpp>
+#include <ivl/flint-factorize.hpp>
 // #include <gmpxx.h>
-#include <flint/fmpz_factorxx.h>
 #include <flint/fmpzxx.h>
 
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 // using Integer = ivl::nt::Bignum<std::uint64_t, (1ULL << 31)>;
 using Integer = flint::fmpzxx;
 
-int main()
+// with --batch every input is read first and the batch shares its factors (see ivl/batch-gcd.hpp),
+// worth it when the inputs are related, e.g. keys generated with too little entropy
+int main(int argc, char **argv)
 {
+  const bool batch = argc > 1 && std::string_view{ argv[1] } == "--batch";
+  const auto print = [](const Integer &n, const auto &factorization) {
+    std::cout << "input: " << n << "\n";
+    for (const auto &[p, e] : factorization) std::cout << p << "^" << e << " ";
+    std::cout << "\n";
+  };
 
+  std::vector<Integer> inputs;
   std::string input;
   while (std::cin >> input) {
     Integer parsed;
     for (auto c : input) parsed = parsed * Integer{ 10 } + Integer{ c - '0' };
-    std::cout << "input: " << parsed << std::endl;
-    // std::cout << "magic: " << ivl::nt::pollard_rho::magic_algo(parsed, Integer{ 2 }) << std::endl;
-    auto f = flint::factor(parsed);
-    // f.print();
-    for (ssize_t i = 0; i < static_cast<ssize_t>(f.size()); ++i) std::cout << f.p(i) << "^" << f.exp(i) << " ";
-    std::cout << std::endl;
+    if (batch) {
+      inputs.push_back(parsed);
+      continue;
+    }
+    // small factors and 64bit cofactors never reach flint, see ivl/flint-factorize.hpp
+    print(parsed, ivl::nt::factorize(parsed, ivl::nt::default_flint_chain));
+  }
+
+  if (batch) {
+    const auto factorizations = ivl::nt::batch_factorize(inputs, ivl::nt::default_flint_chain);
+    for (std::size_t i = 0; i < inputs.size(); ++i) print(inputs[i], factorizations[i]);
   }
 
   return 0;
@@ -0,0 +1,182 @@
+#pragma once
+
+// tiny benchmark harness for `ptest`
+// every case runs `warmup` times untimed, then `repetitions` times timed,
+// one run goes over all of its inputs, results are per input
+// cycles come from the time stamp counter (reference cycles, not core cycles), 0 where there is none
+// with an allocation counter set, the allocations of the median run get a column too
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace bench {
+
+inline std::uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// deterministic inputs, the same on every machine
+struct SplitMix
+{
+  std::uint64_t state;
+
+  std::uint64_t operator()()
+  {
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+};
+
+// results get folded into this so the optimizer can't drop the work
+inline volatile std::uint64_t sink = 0;
+
+struct Options
+{
+  std::size_t warmup = 1;
+  std::size_t repetitions = 5;
+  std::string filter;// only cases whose name contains this
+  bool json = false;
+  // a running count of heap allocations, e.g. `ivl::nt::fmpz_allocations`, read around every timed run
+  std::function<std::uint64_t()> allocations;
+};
+
+struct Stats
+{
+  double min = 0, median = 0, mean = 0, stddev = 0;// nanoseconds per input
+  double cycles = 0;// median, per input
+  double allocations = 0;// median, per input
+};
+
+struct Case
+{
+  std::string name;// operation/strategy/input class, e.g. "factorize/trial/semiprime32"
+  std::size_t items;// inputs per run
+  // one run over every input, returns a checksum
+  std::function<std::uint64_t()> run;
+};
+
+inline Stats measure(const Case &c, const Options &options)
+{
+  for (std::size_t i = 0; i < options.warmup; ++i) sink = sink + c.run();
+  std::vector<double> ns, cyc, allocs;
+  for (std::size_t i = 0; i < std::max<std::size_t>(options.repetitions, 1); ++i) {
+    const std::uint64_t start_allocations = options.allocations ? options.allocations() : 0;
+    const auto start = std::chrono::steady_clock::now();
+    const std::uint64_t start_cycles = cycles();
+    sink = sink + c.run();
+    const std::uint64_t stop_cycles = cycles();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    const std::uint64_t stop_allocations = options.allocations ? options.allocations() : 0;
+    ns.push_back(elapsed.count() / static_cast<double>(c.items));
+    cyc.push_back(static_cast<double>(stop_cycles - start_cycles) / static_cast<double>(c.items));
+    allocs.push_back(static_cast<double>(stop_allocations - start_allocations) / static_cast<double>(c.items));
+  }
+  std::sort(ns.begin(), ns.end());
+  std::sort(cyc.begin(), cyc.end());
+  std::sort(allocs.begin(), allocs.end());
+  Stats out;
+  out.min = ns.front();
+  out.median = ns[ns.size() / 2];
+  for (double x : ns) out.mean += x / static_cast<double>(ns.size());
+  for (double x : ns) out.stddev += (x - out.mean) * (x - out.mean) / static_cast<double>(ns.size());
+  out.stddev = std::sqrt(out.stddev);
+  out.cycles = cyc[cyc.size() / 2];
+  out.allocations = allocs[allocs.size() / 2];
+  return out;
+}
+
+inline std::string compiler()
+{
+#if defined(__clang__)
+  return "clang " __clang_version__;
+#elif defined(__GNUC__)
+  return "gcc " __VERSION__;
+#else
+  return "unknown";
+#endif
+}
+
+// --warmup N --reps N --filter S --json
+inline Options parse_options(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        std::cerr << "missing value after " << arg << std::endl;
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--json") {
+      options.json = true;
+    } else if (arg == "--warmup") {
+      options.warmup = std::stoul(value());
+    } else if (arg == "--reps") {
+      options.repetitions = std::stoul(value());
+    } else if (arg == "--filter") {
+      options.filter = value();
+    } else {
+      std::cerr << "usage: " << argv[0] << " [--warmup N] [--reps N] [--filter SUBSTRING] [--json]" << std::endl;
+      std::exit(2);
+    }
+  }
+  return options;
+}
+
+// names are plain ascii without quotes, nothing to escape
+inline void run(const std::vector<Case> &cases, const Options &options)
+{
+  if (options.json) {
+    std::cout << "{\n  \"compiler\": \"" << compiler() << "\",\n  \"warmup\": " << options.warmup
+              << ",\n  \"repetitions\": " << options.repetitions << ",\n  \"results\": [";
+  } else {
+    std::cout << std::left << std::setw(48) << "case" << std::right << std::setw(8) << "items" << std::setw(12)
+              << "median ns" << std::setw(12) << "min ns" << std::setw(10) << "stddev" << std::setw(12) << "cycles";
+    if (options.allocations) std::cout << std::setw(10) << "allocs";
+    std::cout << std::endl;
+  }
+  bool first = true;
+  for (const auto &c : cases) {
+    if (c.name.find(options.filter) == std::string::npos) continue;
+    const Stats s = measure(c, options);
+    if (options.json) {
+      std::cout << (first ? "\n" : ",\n") << "    {\"name\": \"" << c.name << "\", \"items\": " << c.items
+                << ", \"median_ns\": " << s.median << ", \"min_ns\": " << s.min << ", \"mean_ns\": " << s.mean
+                << ", \"stddev_ns\": " << s.stddev << ", \"cycles\": " << s.cycles;
+      if (options.allocations) std::cout << ", \"allocations\": " << s.allocations;
+      std::cout << "}";
+    } else {
+      std::cout << std::left << std::setw(48) << c.name << std::right << std::setw(8) << c.items << std::fixed
+                << std::setprecision(1) << std::setw(12) << s.median << std::setw(12) << s.min << std::setw(10)
+                << s.stddev << std::setw(12) << s.cycles;
+      if (options.allocations) std::cout << std::setw(10) << s.allocations;
+      std::cout << std::endl;
+    }
+    first = false;
+  }
+  if (options.json) std::cout << "\n  ]\n}" << std::endl;
+}
+
+}// namespace bench
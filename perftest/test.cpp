@@ -1,20 +1,560 @@
-// #include <ivl/bignum.hpp>
+// benchmarks, see bench.hpp for the harness
+// ptest [--warmup N] [--reps N] [--filter SUBSTRING] [--json]
+// case names are operation/strategy/input class, the input classes are
+// * smoothN: products of primes below 100, up to N bits
+// * semiprimeN: two random primes of N/2 bits each
+// * primeN: random N bit primes
+// * hcN: the numbers below 2^N with the most divisors (highly composite or close)
+// * randomN: uniformly random N bit values
+
+#include "bench.hpp"
+
+#include <ivl/bignum.hpp>
+#include <ivl/divisors.hpp>
+#include <ivl/factorization-algebra.hpp>
+#include <ivl/factorization-cache.hpp>
+#include <ivl/factorize.hpp>
+#include <ivl/lazy.hpp>
+#include <ivl/multi-fns.hpp>
+#include <ivl/pollard-rho.hpp>
+#include <ivl/simd-divisibility.hpp>
+#include <ivl/spf.hpp>
+#include <ivl/stream-factorize.hpp>
+#include <ivl/table-file.hpp>
+
+#if __has_include(<flint/fmpzxx.h>)
+#include <flint/fmpz_factorxx.h>
 #include <flint/fmpzxx.h>
+#include <ivl/batch-gcd.hpp>
+#include <ivl/flint-accumulate.hpp>
+#include <ivl/flint-factorize.hpp>
+#define IVL_NT_BENCH_FLINT
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-#include <iostream>
+namespace {
 
-int main()
+using ivl::nt::uint128_t;
+
+constexpr std::uint32_t small_primes[]{ 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47,
+  53, 59, 61, 67, 71, 73, 79, 83, 89, 97 };
+
+std::vector<uint128_t> smooth(std::uint32_t bits, std::size_t count, bench::SplitMix &rng)
 {
-  using Integer = flint::fmpzxx;
+  const uint128_t limit = bits == 128 ? ~uint128_t{ 0 } : (uint128_t{ 1 } << bits) - 1;
+  std::vector<uint128_t> out;
+  while (out.size() < count) {
+    uint128_t n = 1;
+    // stop at the first prime that doesn't fit, so the values stay close to the limit
+    while (true) {
+      const std::uint32_t p = small_primes[rng() % std::size(small_primes)];
+      if (n > limit / p) break;
+      n *= p;
+    }
+    out.push_back(n);
+  }
+  return out;
+}
+
+std::uint64_t random_prime(std::uint32_t bits, bench::SplitMix &rng)
+{
+  std::uint64_t n = (rng() >> (64 - bits)) | (std::uint64_t{ 1 } << (bits - 1)) | 1;
+  while (!ivl::nt::pollard_rho::is_prime(n)) n += 2;
+  return n;
+}
+
+std::vector<uint128_t> random(std::uint32_t bits, std::size_t count, bench::SplitMix &rng)
+{
+  std::vector<uint128_t> out;
+  while (out.size() < count) out.push_back((rng() >> (64 - bits)) | 1);
+  return out;
+}
+
+std::vector<uint128_t> primes(std::uint32_t bits, std::size_t count, bench::SplitMix &rng)
+{
+  std::vector<uint128_t> out;
+  while (out.size() < count) out.push_back(random_prime(bits, rng));
+  return out;
+}
+
+std::vector<uint128_t> semiprimes(std::uint32_t bits, std::size_t count, bench::SplitMix &rng)
+{
+  std::vector<uint128_t> out;
+  while (out.size() < count) out.push_back(uint128_t{ random_prime(bits / 2, rng) } * random_prime(bits / 2, rng));
+  return out;
+}
+
+// numbers with non increasing exponents over consecutive primes, the `count` with the most divisors
+std::vector<uint128_t> highly_composite(std::uint32_t bits, std::size_t count)
+{
+  const uint128_t limit = (uint128_t{ 1 } << bits) - 1;
+  std::vector<std::pair<std::uint64_t, uint128_t>> found;// (divisor count, n)
+  const auto walk = [&](auto &self, std::size_t i, std::uint32_t max_e, uint128_t n, std::uint64_t tau) -> void {
+    found.emplace_back(tau, n);
+    if (i == std::size(small_primes)) return;
+    uint128_t m = n;
+    for (std::uint32_t e = 1; e <= max_e && m <= limit / small_primes[i]; ++e) {
+      m *= small_primes[i];
+      self(self, i + 1, e, m, tau * (e + 1));
+    }
+  };
+  walk(walk, 0, 64, 1, 1);
+  std::sort(found.begin(), found.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+  std::vector<uint128_t> out;
+  for (std::size_t i = 0; i < std::min(count, found.size()); ++i) out.push_back(found[i].second);
+  return out;
+}
+
+template<typename T> std::vector<T> narrow(const std::vector<uint128_t> &values)
+{
+  return std::vector<T>(values.begin(), values.end());
+}
+
+template<typename F> std::uint64_t checksum(const F &factorization)
+{
+  std::uint64_t out = 0;
+  for (auto [p, e] : factorization) out = out * 31 + static_cast<std::uint64_t>(p) + e;
+  return out;
+}
+
+struct Inputs
+{
+  std::string name;
+  std::vector<uint128_t> values;
+};
+
+}// namespace
+
+int main(int argc, char **argv)
+{
+  using ivl::nt::factorize;
+
+  bench::Options options = bench::parse_options(argc, argv);
+#ifdef IVL_NT_BENCH_FLINT
+  options.allocations = ivl::nt::fmpz_allocations;
+#endif
+  bench::SplitMix rng{ 2024 };
+  std::vector<bench::Case> cases;
+
+  // the strategies, each over the input classes it is meant for
+  // trial division is hopeless for balanced 64bit semiprimes, it gets 40 bit ones
+  // random16 is all lookups in the small tables once IVL_NT_SMALL_TABLE_BOUND is 2^16, trial division below that
+  const std::vector<Inputs> trial_inputs{ { "random16", random(16, 10000, rng) },
+    { "smooth32", smooth(32, 1000, rng) },
+    { "semiprime32", semiprimes(32, 1000, rng) },
+    { "prime32", primes(32, 1000, rng) },
+    { "smooth64", smooth(64, 1000, rng) },
+    { "hc64", highly_composite(64, 200) },
+    { "semiprime40", semiprimes(40, 20, rng) },
+    { "prime40", primes(40, 20, rng) } };
+  for (const auto &in : trial_inputs) {
+    cases.push_back({ "factorize/trial/" + in.name, in.values.size(), [values = narrow<std::uint64_t>(in.values)] {
+                       std::uint64_t sum = 0;
+                       for (auto n : values) sum += checksum(factorize(n));
+                       return sum;
+                     } });
+    cases.push_back({ "factorize/trial-inline/" + in.name, in.values.size(),
+      [values = narrow<std::uint64_t>(in.values)] {
+        std::uint64_t sum = 0;
+        for (auto n : values) {
+          using Inline = ivl::nt::InlineFactorization<std::uint64_t>;
+          sum += checksum(factorize<std::uint64_t, ivl::nt::ExponentType, Inline>(n));
+        }
+        return sum;
+      } });
+  }
+  // the first stage of trial division with each kernel this cpu has, one value against the primes up to its root
+  for (auto level : { ivl::nt::SimdLevel::scalar, ivl::nt::SimdLevel::avx2, ivl::nt::SimdLevel::avx512 }) {
+    if (level > ivl::nt::simd_level) continue;
+    constexpr const char *names[]{ "scalar", "avx2", "avx512" };
+    for (const auto &in : trial_inputs) {
+      if (in.name != "prime32" && in.name != "smooth64") continue;
+      cases.push_back({ std::string{ "divisibility/first-divisor-" } + names[static_cast<int>(level)] + "/" + in.name,
+        in.values.size(),
+        [level, values = narrow<std::uint64_t>(in.values)] {
+          std::uint64_t sum = 0;
+          for (auto n : values) sum += ivl::nt::first_divisor(n, 0, ivl::nt::DivisibilityPrimes::size(), level);
+          return sum;
+        } });
+    }
+  }
+  // many values at once, the table primes stripped from all of them, then the cofactors
+  for (const auto &in : trial_inputs) {
+    if (in.name != "smooth64" && in.name != "semiprime32" && in.name != "smooth32") continue;
+    cases.push_back({ "factorize/trial-batch/" + in.name, in.values.size(),
+      [values = narrow<std::uint64_t>(in.values)] {
+        auto left = values;
+        std::uint64_t sum = 0;
+        ivl::nt::strip_small_factors(left, [&](std::size_t, std::uint64_t p, std::uint32_t e) { sum += p * e; });
+        for (auto n : left) {
+          if (n != 1) sum += checksum(factorize(n));
+        }
+        return sum;
+      } });
+  }
+
+  const std::vector<Inputs> rho_inputs{ { "smooth64", smooth(64, 1000, rng) },
+    { "hc64", highly_composite(64, 200) },
+    { "semiprime32", semiprimes(32, 1000, rng) },
+    { "prime32", primes(32, 1000, rng) },
+    { "semiprime64", semiprimes(64, 200, rng) },
+    { "prime64", primes(64, 1000, rng) } };
+  for (const auto &in : rho_inputs) {
+    cases.push_back({ "factorize/pollard-rho/" + in.name, in.values.size(),
+      [values = narrow<std::uint64_t>(in.values)] {
+        std::uint64_t sum = 0;
+        for (auto n : values) sum += checksum(factorize(n, ivl::nt::pollard_rho_strategy));
+        return sum;
+      } });
+  }
+
+  // the table is built once, outside of the timed runs
+  const auto spf = std::make_shared<ivl::nt::SpfTable<std::uint16_t>>(1 << 24);
+  const std::vector<Inputs> spf_inputs{ { "smooth24", smooth(24, 10000, rng) },
+    { "semiprime24", semiprimes(24, 10000, rng) },
+    { "prime24", primes(24, 10000, rng) } };
+  for (const auto &in : spf_inputs) {
+    cases.push_back({ "factorize/spf/" + in.name, in.values.size(), [spf, values = narrow<std::uint32_t>(in.values)] {
+                       std::uint64_t sum = 0;
+                       for (auto n : values) sum += checksum(factorize(n, *spf));
+                       return sum;
+                     } });
+  }
+
+  // the same table read through a mapped file, what a process that didn't sieve it pays
+  {
+    const auto path = (std::filesystem::temp_directory_path() / "ivl-nt-perftest-spf.bin").string();
+    {
+      ivl::nt::TableFileWriter out{ path };
+      out.add_spf("spf", *spf);
+      out.finish();
+    }
+    const auto file = std::make_shared<ivl::nt::TableFile>(path);
+    std::filesystem::remove(path);// the mapping outlives the name
+    for (const auto &in : spf_inputs) {
+      cases.push_back({ "factorize/spf-mapped/" + in.name,
+        in.values.size(),
+        [file, values = narrow<std::uint32_t>(in.values)] {
+          const auto table = file->spf<std::uint16_t>();
+          std::uint64_t sum = 0;
+          for (auto n : values) sum += checksum(factorize(n, table));
+          return sum;
+        } });
+    }
+  }
+
+  // a warm cache, every lookup hits
+  {
+    auto values = narrow<std::uint64_t>(semiprimes(40, 20, rng));
+    auto cache = std::make_shared<ivl::nt::FactorizationCache<std::uint64_t>>(1024);
+    for (auto n : values) factorize(n, *cache);
+    cases.push_back({ "factorize/cache-hit/semiprime40", values.size(), [cache, values] {
+                       std::uint64_t sum = 0;
+                       for (auto n : values) sum += checksum(factorize(n, *cache));
+                       return sum;
+                     } });
+  }
+
+  // wider types, same trial division
+  {
+    const auto values = smooth(128, 200, rng);
+    cases.push_back({ "factorize/trial/smooth128", values.size(), [values] {
+                       std::uint64_t sum = 0;
+                       for (auto n : values) sum += checksum(factorize(n));
+                       return sum;
+                     } });
+#ifdef IVL_NT_BENCH_FLINT
+    std::vector<flint::fmpzxx> big;
+    for (auto n : values) {
+      flint::fmpzxx x{ static_cast<unsigned long>(n >> 64) };
+      x = x * flint::fmpzxx{ 1UL << 32 } * flint::fmpzxx{ 1UL << 32 } + flint::fmpzxx{ static_cast<unsigned long>(n) };
+      big.push_back(x);
+    }
+    cases.push_back({ "factorize/trial/smooth128-fmpzxx", big.size(), [big] {
+                       std::uint64_t sum = 0;
+                       for (const auto &n : big) sum += factorize(n).size();
+                       return sum;
+                     } });
+#endif
+  }
+
+#ifdef IVL_NT_BENCH_FLINT
+  // the common bignum shape: a smooth part times one large prime, the strategy chain vs a full `flint::factor`
+  {
+    std::vector<flint::fmpzxx> values;
+    for (auto n : smooth(64, 100, rng)) {
+      // a ~190 bit prime: three random words, then the next probable prime
+      flint::fmpzxx p{ 1UL };
+      for (int i = 0; i < 3; ++i) {
+        p = p * flint::fmpzxx{ 1UL << 32 } * flint::fmpzxx{ 1UL << 32 } + flint::fmpzxx{ rng() };
+      }
+      if (fmpz_tdiv_ui(p._fmpz(), 2) == 0) fmpz_add_ui(p._fmpz(), p._fmpz(), 1);
+      while (!fmpz_is_probabprime(p._fmpz())) fmpz_add_ui(p._fmpz(), p._fmpz(), 2);
+      values.push_back(p * flint::fmpzxx{ static_cast<unsigned long>(n) });
+    }
+    cases.push_back({ "factorize/flint-chain/smooth64-prime192", values.size(), [values] {
+                       std::uint64_t sum = 0;
+                       for (const auto &n : values) sum += factorize(n, ivl::nt::default_flint_chain).size();
+                       return sum;
+                     } });
+    cases.push_back({ "factorize/flint-factor/smooth64-prime192", values.size(), [values] {
+                       std::uint64_t sum = 0;
+                       for (const auto &n : values) sum += static_cast<std::uint64_t>(flint::factor(n).size());
+                       return sum;
+                     } });
+  }
+
+  // products of two 64 bit primes out of a pool half as large as the batch, most of them share a prime with another
+  {
+    std::vector<flint::fmpzxx> pool, values;
+    for (auto p : primes(64, 100, rng)) pool.emplace_back(static_cast<unsigned long>(p));
+    while (values.size() < 200) values.push_back(pool[rng() % pool.size()] * pool[rng() % pool.size()]);
+    cases.push_back({ "factorize/flint-chain/semiprime128-shared", values.size(), [values] {
+                       std::uint64_t sum = 0;
+                       for (const auto &n : values) sum += factorize(n, ivl::nt::default_flint_chain).size();
+                       return sum;
+                     } });
+    cases.push_back({ "factorize/flint-batch/semiprime128-shared", values.size(), [values] {
+                       std::uint64_t sum = 0;
+                       const auto factorizations = ivl::nt::batch_factorize(values, ivl::nt::default_flint_chain);
+                       for (const auto &f : factorizations) sum += f.size();
+                       return sum;
+                     } });
+  }
+#endif
+
+  // the factorization of a product of factorized numbers: one k-way merge, pairwise merges, or from scratch
+  // (products of the inputs fit in 128 bits)
+  const std::vector<Inputs> product_inputs{ { "random8x16", random(8, 16, rng) }, { "prime24x5", primes(24, 5, rng) } };
+  for (const auto &in : product_inputs) {
+    std::vector<ivl::nt::Factorization<uint128_t>> factorizations;
+    uint128_t product = 1;
+    for (auto n : in.values) {
+      factorizations.push_back(factorize(n));
+      product *= n;
+    }
+    cases.push_back({ "factorization/multiply-kway/" + in.name, 1, [factorizations] {
+                       return ivl::nt::multiply_factorizations(factorizations).size();
+                     } });
+    cases.push_back({ "factorization/multiply-pairwise/" + in.name, 1, [factorizations] {
+                       auto out = factorizations[0];
+                       for (std::size_t i = 1; i < factorizations.size(); ++i) {
+                         out = ivl::nt::merge_factorizations(out, factorizations[i]);
+                       }
+                       return out.size();
+                     } });
+    cases.push_back({ "factorization/multiply-refactorize/" + in.name, 1, [product] {
+                       return factorize(product).size();
+                     } });
+  }
+
+  // divisors of numbers with a lot of them
+  {
+    std::vector<ivl::nt::Factorization<std::uint64_t>> factorizations;
+    for (auto n : highly_composite(64, 50)) factorizations.push_back(factorize(static_cast<std::uint64_t>(n)));
+    cases.push_back({ "divisors/generate_all_divisors/hc64", factorizations.size(), [factorizations] {
+                       std::uint64_t sum = 0;
+                       for (const auto &f : factorizations) {
+                         for (auto d : ivl::nt::generate_all_divisors(f)) sum += d;
+                       }
+                       return sum;
+                     } });
+    cases.push_back({ "divisors/DivisorIterable/hc64", factorizations.size(), [factorizations] {
+                       std::uint64_t sum = 0;
+                       for (const auto &f : factorizations) {
+                         for (const auto &d : ivl::nt::DivisorIterable{ f }) sum += d.value;
+                       }
+                       return sum;
+                     } });
+  }
+
+  // a product of two factorized values: merging the factorizations vs factorizing the product
+  {
+    const auto left = narrow<std::int64_t>(smooth(32, 1000, rng));
+    const auto right = narrow<std::int64_t>(smooth(31, 1000, rng));
+    cases.push_back({ "lazy/product-merge/smooth63", left.size(), [left, right] {
+                       std::uint64_t sum = 0;
+                       for (std::size_t i = 0; i < left.size(); ++i) {
+                         ivl::nt::Lazy<> a{ left[i] }, b{ right[i] };
+                         factorize(a);
+                         factorize(b);
+                         sum += checksum(factorize(a * b));
+                       }
+                       return sum;
+                     } });
+    cases.push_back({ "lazy/product-refactorize/smooth63", left.size(), [left, right] {
+                       std::uint64_t sum = 0;
+                       for (std::size_t i = 0; i < left.size(); ++i) {
+                         factorize(left[i]);
+                         factorize(right[i]);
+                         sum += checksum(factorize(left[i] * right[i]));
+                       }
+                       return sum;
+                     } });
+  }
+
+  // the multiplicative completions, from a value (factorization included) and from a factorization
+  {
+    const auto values = narrow<std::uint64_t>(smooth(32, 1000, rng));
+    std::vector<ivl::nt::Factorization<std::uint64_t>> factorizations;
+    for (auto n : values) factorizations.push_back(factorize(n));
+    const auto add = [&](std::string name, auto fn) {
+      cases.push_back({ "multi-fns/" + name + "/smooth32", values.size(), [values, fn] {
+                         std::uint64_t sum = 0;
+                         for (auto n : values) sum += static_cast<std::uint64_t>(fn(n));
+                         return sum;
+                       } });
+      cases.push_back({ "multi-fns/" + name + "/smooth32-factorized", values.size(), [factorizations, fn] {
+                         std::uint64_t sum = 0;
+                         for (const auto &f : factorizations) sum += static_cast<std::uint64_t>(fn(f));
+                         return sum;
+                       } });
+    };
+    add("tau_compiletime", ivl::nt::tau_compiletime);
+    add("tau_runtime", ivl::nt::tau_runtime);
+    add("sigma_compiletime", ivl::nt::sigma_compiletime);
+    add("sigma_dirichlet", ivl::nt::sigma_dirichlet);
+    add("sigma_dirichlet_generic", ivl::nt::compiletime::generic_dirichlet_convolution<ivl::nt::one, ivl::nt::id>);
+    add("tau_mu_dirichlet",
+      ivl::nt::compiletime::dirichlet_convolution<ivl::nt::tau_dirichlet, ivl::nt::mu_compiletime>);
+    add("tau_mu_dirichlet_generic",
+      ivl::nt::compiletime::generic_dirichlet_convolution<ivl::nt::tau_dirichlet, ivl::nt::mu_compiletime>);
+    add("phi_compiletime", ivl::nt::phi_compiletime);
+    add("mu_compiletime", ivl::nt::mu_compiletime);
+  }
+
+  // the whole text pipeline: parsing, factorizing and formatting, one worker so the numbers are per core
+  {
+    std::string text;
+    for (auto n : smooth(32, 100000, rng)) text += std::to_string(static_cast<std::uint64_t>(n)) + "\n";
+    for (const auto format : { ivl::nt::StreamFormat::text, ivl::nt::StreamFormat::binary }) {
+      const std::string name = format == ivl::nt::StreamFormat::text ? "text" : "binary";
+      cases.push_back({ "stream/" + name + "/smooth32", 100000, [text, format] {
+                         std::ostringstream out;
+                         const ivl::nt::StreamOptions stream_options{ .threads = 1, .format = format };
+                         return ivl::nt::factorize_stream(text, out, stream_options).bytes_out;
+                       } });
+    }
+  }
+
+  // the fixed width bignums: karatsuba against schoolbook (where `karatsuba_threshold` comes from),
+  // long division and a montgomery modexp
+  {
+    const auto limbs = [&]<std::size_t N>(std::integral_constant<std::size_t, N>) {
+      std::vector<std::array<std::uint64_t, N>> out(100);
+      for (auto &a : out) {
+        for (auto &x : a) x = rng();
+      }
+      return out;
+    };
+    const auto add_mul = [&]<std::size_t N>(std::integral_constant<std::size_t, N> n) {
+      const auto values = limbs(n);
+      const std::string bits = std::to_string(64 * N);
+      cases.push_back({ "bignum/mul-schoolbook/random" + bits, values.size() - 1, [values] {
+                         std::uint64_t sum = 0;
+                         std::array<std::uint64_t, 2 * N> out;
+                         for (std::size_t i = 0; i + 1 < values.size(); ++i) {
+                           const auto &a = values[i], &b = values[i + 1];
+                           ivl::nt::bignum_detail::mul_schoolbook(a.data(), N, b.data(), N, out.data());
+                           sum += out[N];
+                         }
+                         return sum;
+                       } });
+      cases.push_back({ "bignum/mul-karatsuba/random" + bits, values.size() - 1, [values] {
+                         std::uint64_t sum = 0;
+                         for (std::size_t i = 0; i + 1 < values.size(); ++i) {
+                           sum += ivl::nt::bignum_detail::mul_full<N>(values[i].data(), values[i + 1].data())[N];
+                         }
+                         return sum;
+                       } });
+    };
+    add_mul(std::integral_constant<std::size_t, 8>{});
+    add_mul(std::integral_constant<std::size_t, 16>{});
+    add_mul(std::integral_constant<std::size_t, 32>{});
+    add_mul(std::integral_constant<std::size_t, 64>{});
+
+    using U = ivl::nt::UnsignedBignum<1024>;
+    std::vector<std::pair<U, U>> pairs;
+    for (const auto &a : limbs(std::integral_constant<std::size_t, 16>{})) {
+      pairs.emplace_back(U::from_limbs(a), U::from_limbs(a) >> (64 * (1 + rng() % 15)));
+    }
+    cases.push_back({ "bignum/divmod/random1024", pairs.size(), [pairs] {
+                       std::uint64_t sum = 0;
+                       for (const auto &[a, b] : pairs) sum += divmod(a, b).second.limb(0);
+                       return sum;
+                     } });
 
-  Integer a{ 123 };
-  Integer b{ 10219 };
-  Integer c{ 1092 };
+    using M = ivl::nt::UnsignedBignum<512>;
+    std::vector<M> bases;
+    for (const auto &a : limbs(std::integral_constant<std::size_t, 8>{})) bases.push_back(M::from_limbs(a));
+    const ivl::nt::BignumMontgomery<512> mont{ bases.back() | 1 };
+    cases.push_back({ "bignum/montgomery-pow/random512", bases.size(), [bases, mont] {
+                       std::uint64_t sum = 0;
+                       for (const auto &a : bases) sum += mont.pow(mont.to(a % mont.modulus()), a).limb(0);
+                       return sum;
+                     } });
+  }
 
-  for (std::uint32_t i = 0; i < 5000; ++i) { c = c * a + a * c + b; }
+#ifdef IVL_NT_BENCH_FLINT
+  // the shape of our bignum kernels, c = c * a + a * c + b with a growing c: operators vs the accumulator
+  {
+    const std::size_t iterations = 2000;
+    cases.push_back({ "bignum/expression-operators/fmpzxx", iterations, [] {
+                       flint::fmpzxx a{ 123 }, b{ 10219 }, c{ 1092 };
+                       for (std::size_t i = 0; i < iterations; ++i) c = c * a + a * c + b;
+                       return static_cast<std::uint64_t>(fmpz_bits(c._fmpz()));
+                     } });
+    cases.push_back({ "bignum/expression-accumulator/fmpzxx", iterations, [] {
+                       flint::fmpzxx a{ 123 }, b{ 10219 }, c{ 1092 };
+                       for (std::size_t i = 0; i < iterations; ++i) {
+                         ivl::nt::FmpzAccumulator{}.addmul(c, a).addmul(a, c).add(b).store(c);
+                       }
+                       return static_cast<std::uint64_t>(fmpz_bits(c._fmpz()));
+                     } });
 
-  c %= Integer{ 1000000007 };
-  std::cout << c << std::endl;
+    // the library paths, with the generic loops they used to be as the baseline
+    std::vector<flint::fmpzxx> values;
+    for (auto n : primes(64, 100, rng)) values.emplace_back(static_cast<unsigned long>(n));
+    cases.push_back({ "multi-fns/powsum/prime64-fmpzxx", values.size(), [values] {
+                       std::uint64_t sum = 0;
+                       for (const auto &n : values) sum += fmpz_bits(ivl::nt::powsum(n, 40)._fmpz());
+                       return sum;
+                     } });
+    cases.push_back({ "multi-fns/powsum-horner/prime64-fmpzxx", values.size(), [values] {
+                       std::uint64_t sum = 0;
+                       for (const auto &n : values) {
+                         flint::fmpzxx out{ 1 };
+                         for (std::uint32_t i = 0; i < 40; ++i) out = out * n + flint::fmpzxx{ 1 };
+                         sum += fmpz_bits(out._fmpz());
+                       }
+                       return sum;
+                     } });
+    std::vector<ivl::nt::Factorization<flint::fmpzxx>> factorizations;
+    for (auto n : highly_composite(64, 50)) {
+      ivl::nt::Factorization<flint::fmpzxx> f;
+      for (auto [p, e] : factorize(static_cast<std::uint64_t>(n))) {
+        f.emplace_back(flint::fmpzxx{ static_cast<unsigned long>(p) }, e * 8);
+      }
+      factorizations.push_back(f);
+    }
+    cases.push_back({ "multi-fns/id/hc64-pow8-fmpzxx", factorizations.size(), [factorizations] {
+                       std::uint64_t sum = 0;
+                       for (const auto &f : factorizations) sum += fmpz_bits(ivl::nt::id(f)._fmpz());
+                       return sum;
+                     } });
+  }
+#endif
 
+  bench::run(cases, options);
   return 0;
 }
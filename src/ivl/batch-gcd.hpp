@@ -0,0 +1,194 @@
+#pragma once
+
+// shared factors across a batch of flint bignums, bernstein's batch gcd
+// factorizing every value on its own throws away that two values have a prime in common,
+// a gcd finds it in no time, but there are n^2 / 2 pairs to try
+// instead:
+// * product tree: the values are the leaves, every node is the product of its two children, the root is their product P
+// * remainder tree: from the root down, every node is its parent's remainder modulo the node squared,
+//   at the leaf x that is P mod x^2, and (P mod x^2) / x = (P / x) mod x
+// * gcd(x, (P / x) mod x) = gcd(x, product of all the other values), the part of x shared with the rest of the batch
+// O(M(N) log n) for N bits of input in total, the nodes of one level are independent and split between threads
+// (the top levels are a few huge multiplications, those stay on one thread each)
+//
+// batch_gcd(values, threads): the shared part of every value, 1 where a value shares nothing
+// batch_factorize(values, chain, threads): a factorization per value, the shared parts are split off (and split
+// by each other) before the strategy chain sees them, so a value that shares each of its large primes never reaches
+// ecm or flint
+
+#include <ivl/factorize.hpp>
+#include <ivl/flint-factorize.hpp>
+
+#include <flint/fmpz.h>
+#include <flint/fmpzxx.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ivl::nt {
+
+class BatchGcdZeroException : public std::exception
+{
+public:
+  virtual const char *what() const noexcept override { return "batch gcd of a batch containing 0"; }
+};
+
+namespace batch_gcd_detail {
+
+  // f(i) for every i in [0, n), contiguous runs of i on up to `threads` threads,
+  // the first exception thrown by any of them is rethrown once all are done
+  template<typename F> void parallel_for(std::size_t n, std::uint32_t threads, F &&f)
+  {
+    const std::size_t used = std::clamp<std::size_t>(threads, 1, std::max<std::size_t>(n, 1));
+    const std::size_t block = (n + used - 1) / used;
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    const auto run = [&](std::size_t t) {
+      try {
+        for (std::size_t i = t * block; i < std::min(n, (t + 1) * block); ++i) f(i);
+      } catch (...) {
+        const std::lock_guard lock{ error_mutex };
+        if (!error) error = std::current_exception();
+      }
+    };
+    {
+      std::vector<std::jthread> pool;
+      for (std::size_t t = 1; t < used; ++t) pool.emplace_back(run, t);
+      run(0);
+    }
+    if (error) std::rethrow_exception(error);
+  }
+
+  // levels[0] are the values, levels.back() the single root
+  inline std::vector<std::vector<flint::fmpzxx>> product_tree(std::vector<flint::fmpzxx> leaves,
+    std::uint32_t threads)
+  {
+    std::vector<std::vector<flint::fmpzxx>> levels;
+    levels.push_back(std::move(leaves));
+    while (levels.back().size() > 1) {
+      const auto &below = levels.back();
+      std::vector<flint::fmpzxx> level((below.size() + 1) / 2);
+      parallel_for(level.size(), threads, [&](std::size_t i) {
+        if (2 * i + 1 < below.size()) {
+          fmpz_mul(level[i]._fmpz(), below[2 * i]._fmpz(), below[2 * i + 1]._fmpz());
+        } else {
+          fmpz_set(level[i]._fmpz(), below[2 * i]._fmpz());
+        }
+      });
+      levels.push_back(std::move(level));
+    }
+    return levels;
+  }
+
+}// namespace batch_gcd_detail
+
+// gcd(|x_i|, product of |x_j| for j != i) for every value, empty for an empty batch
+inline std::vector<flint::fmpzxx> batch_gcd(std::span<const flint::fmpzxx> values, std::uint32_t threads = 1)
+{
+  if (values.empty()) return {};
+  std::vector<flint::fmpzxx> leaves(values.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    if (fmpz_is_zero(values[i]._fmpz())) throw BatchGcdZeroException{};
+    fmpz_abs(leaves[i]._fmpz(), values[i]._fmpz());
+  }
+  auto levels = batch_gcd_detail::product_tree(std::move(leaves), threads);
+
+  // the remainders replace the products level by level, the root's remainder is P itself
+  for (std::size_t k = levels.size() - 1; k-- > 0;) {
+    const auto &above = levels[k + 1];
+    auto &level = levels[k];
+    batch_gcd_detail::parallel_for(level.size(), threads, [&](std::size_t i) {
+      flint::fmpzxx square;
+      fmpz_sqr(square._fmpz(), level[i]._fmpz());
+      fmpz_mod(square._fmpz(), above[i / 2]._fmpz(), square._fmpz());
+      fmpz_swap(level[i]._fmpz(), square._fmpz());
+    });
+    levels[k + 1].clear();
+  }
+
+  // P mod x^2 is a multiple of x
+  std::vector<flint::fmpzxx> out(values.size());
+  batch_gcd_detail::parallel_for(values.size(), threads, [&](std::size_t i) {
+    fmpz *shared = out[i]._fmpz();
+    fmpz_abs(shared, values[i]._fmpz());
+    fmpz_divexact(levels[0][i]._fmpz(), levels[0][i]._fmpz(), shared);
+    fmpz_gcd(shared, shared, levels[0][i]._fmpz());
+  });
+  return out;
+}
+
+// the factorization of every value through `chain`, in order, signs dropped, with what the batch shares split off first
+// equal values are factorized once, the shared part of a value is split further by the shared parts of the others,
+// so x = pq next to pr and qs becomes p and q without the chain, at one gcd per piece and value that shares anything
+// (few when factors are shared by accident)
+template<typename T = flint::fmpzxx, typename ET = ExponentType, typename F = Factorization<T, ET>, typename... Stages>
+  requires std::same_as<T, flint::fmpzxx>
+std::vector<F> batch_factorize(std::span<const flint::fmpzxx> values,
+  const FlintStrategyChain<Stages...> &chain,
+  std::uint32_t threads = 1)
+{
+  std::vector<flint::fmpzxx> distinct(values.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    if (fmpz_is_zero(values[i]._fmpz())) throw ZeroFactorizationException{};
+    fmpz_abs(distinct[i]._fmpz(), values[i]._fmpz());
+  }
+  const auto less = [](const flint::fmpzxx &a, const flint::fmpzxx &b) { return fmpz_cmp(a._fmpz(), b._fmpz()) < 0; };
+  std::vector<std::size_t> order(values.size());
+  std::iota(order.begin(), order.end(), std::size_t{ 0 });
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return less(distinct[a], distinct[b]); });
+  std::vector<std::size_t> slot(values.size());// values[i] is distinct[slot[i]] once deduplicated
+  std::vector<flint::fmpzxx> unique;
+  for (std::size_t i : order) {
+    if (unique.empty() || !fmpz_equal(unique.back()._fmpz(), distinct[i]._fmpz())) {
+      unique.push_back(std::move(distinct[i]));
+    }
+    slot[i] = unique.size() - 1;
+  }
+
+  const auto shared = batch_gcd(unique, threads);
+  std::vector<std::size_t> sharing;
+  for (std::size_t i = 0; i < unique.size(); ++i) {
+    if (!fmpz_is_one(shared[i]._fmpz())) sharing.push_back(i);
+  }
+
+  std::vector<F> factorizations(unique.size());
+  batch_gcd_detail::parallel_for(unique.size(), threads, [&](std::size_t i) {
+    const flint::fmpzxx &x = unique[i];
+    flint_detail::Work work;
+    if (fmpz_is_one(shared[i]._fmpz())) {
+      work.add(x, 1);
+      factorizations[i] = flint_detail::run_chain<T, ET, F>(work, chain);
+      return;
+    }
+    // the pieces multiply to x, each one is split wherever the shared part of another value cuts through it
+    std::vector<flint::fmpzxx> pieces{ shared[i] };
+    fmpz_divexact(pieces.emplace_back()._fmpz(), x._fmpz(), shared[i]._fmpz());
+    flint::fmpzxx d;
+    for (std::size_t j : sharing) {
+      if (j == i) continue;
+      for (std::size_t k = 0; k < pieces.size(); ++k) {
+        fmpz_gcd(d._fmpz(), pieces[k]._fmpz(), shared[j]._fmpz());
+        if (!flint_detail::nontrivial(d, pieces[k])) continue;
+        fmpz_divexact(pieces[k]._fmpz(), pieces[k]._fmpz(), d._fmpz());
+        pieces.push_back(d);
+      }
+    }
+    for (auto &piece : pieces) work.add(std::move(piece), 1);
+    factorizations[i] = flint_detail::run_chain<T, ET, F>(work, chain);
+  });
+
+  std::vector<F> out;
+  out.reserve(values.size());
+  for (std::size_t i = 0; i < values.size(); ++i) out.push_back(factorizations[slot[i]]);
+  return out;
+}
+
+}// namespace ivl::nt
@@ -0,0 +1,723 @@
+#pragma once
+
+// fixed width integers with their limbs in place, for numbers too big for 128 bits but too small to be worth
+// a heap allocation on every operation (which is what `flint::fmpzxx` does)
+// `Bits` is a multiple of 64, the usual ones are 128, 256, 512 and 1024
+// they behave like the builtin integers: everything wraps modulo 2^Bits, division truncates toward zero,
+// (the signed ones wrap too, no ub, no overflow detection either) and everything is constexpr
+// `Bignum<Bits>` is signed (two's complement), `UnsignedBignum<Bits>` isn't
+// `BignumMontgomery<Bits>` does arithmetic modulo an odd number without dividing
+
+#include <ivl/int128.hpp>
+#include <ivl/modint.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace ivl::nt {
+
+class BignumDivisionByZeroException : public std::exception
+{
+public:
+  virtual const char *what() const noexcept override { return "bignum division by zero"; }
+};
+
+class BignumParseException : public std::exception
+{
+public:
+  virtual const char *what() const noexcept override { return "not a decimal integer"; }
+};
+
+namespace bignum_detail {
+
+  using Limb = std::uint64_t;
+
+  // from here on the products are cheaper with karatsuba than with schoolbook, measured with ptest (bignum/mul):
+  // splitting 4096 bits into two schoolbook halves wins by ~20%, splitting anything smaller doesn't pay off
+  inline constexpr std::size_t karatsuba_threshold = 64;
+
+  // a + b + carry, the carry goes in and out as 0 or 1
+  constexpr Limb add_carry(Limb a, Limb b, Limb &carry)
+  {
+    const uint128_t sum = uint128_t{ a } + b + carry;
+    carry = static_cast<Limb>(sum >> 64);
+    return static_cast<Limb>(sum);
+  }
+
+  // a - b - borrow, the borrow goes in and out as 0 or 1
+  constexpr Limb sub_borrow(Limb a, Limb b, Limb &borrow)
+  {
+    const Limb out = a - b - borrow;
+    borrow = (a < b) || (a - b < borrow) ? 1 : 0;
+    return out;
+  }
+
+  // out[0, n + m) = a[0, n) * b[0, m)
+  constexpr void mul_schoolbook(const Limb *a, std::size_t n, const Limb *b, std::size_t m, Limb *out)
+  {
+    std::fill(out, out + n + m, Limb{ 0 });
+    for (std::size_t i = 0; i < n; ++i) {
+      Limb carry = 0;
+      for (std::size_t j = 0; j < m; ++j) {
+        const uint128_t t = uint128_t{ a[i] } * b[j] + out[i + j] + carry;
+        out[i + j] = static_cast<Limb>(t);
+        carry = static_cast<Limb>(t >> 64);
+      }
+      out[i + m] = carry;
+    }
+  }
+
+  // out[0, n) = a[0, n) * b[0, n) mod 2^(64n), about half the work of the whole product
+  constexpr void mul_low_schoolbook(const Limb *a, const Limb *b, std::size_t n, Limb *out)
+  {
+    std::fill(out, out + n, Limb{ 0 });
+    for (std::size_t i = 0; i < n; ++i) {
+      Limb carry = 0;
+      for (std::size_t j = 0; i + j < n; ++j) {
+        const uint128_t t = uint128_t{ a[i] } * b[j] + out[i + j] + carry;
+        out[i + j] = static_cast<Limb>(t);
+        carry = static_cast<Limb>(t >> 64);
+      }
+    }
+  }
+
+  // out[0, n) += a[0, m), the carry keeps going up to n, returns what falls off the top
+  constexpr Limb add_into(Limb *out, std::size_t n, const Limb *a, std::size_t m)
+  {
+    Limb carry = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      if (i >= m && carry == 0) break;
+      out[i] = add_carry(out[i], i < m ? a[i] : 0, carry);
+    }
+    return carry;
+  }
+
+  // out[0, n) -= a[0, m), returns the borrow out of the top
+  constexpr Limb sub_from(Limb *out, std::size_t n, const Limb *a, std::size_t m)
+  {
+    Limb borrow = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      if (i >= m && borrow == 0) break;
+      out[i] = sub_borrow(out[i], i < m ? a[i] : 0, borrow);
+    }
+    return borrow;
+  }
+
+  // out = |a - b|, true if a < b
+  template<std::size_t N> constexpr bool sub_abs(const Limb *a, const Limb *b, std::array<Limb, N> &out)
+  {
+    bool less = false;
+    for (std::size_t i = N; i-- > 0;) {
+      if (a[i] != b[i]) {
+        less = a[i] < b[i];
+        break;
+      }
+    }
+    if (less) std::swap(a, b);
+    Limb borrow = 0;
+    for (std::size_t i = 0; i < N; ++i) out[i] = sub_borrow(a[i], b[i], borrow);
+    return less;
+  }
+
+  // the whole 2N limb product, karatsuba from `karatsuba_threshold` limbs on:
+  // with a = a1 B + a0 and b = b1 B + b0, a0 b1 + a1 b0 = a0 b0 + a1 b1 + (a0 - a1)(b1 - b0)
+  template<std::size_t N> constexpr std::array<Limb, 2 * N> mul_full(const Limb *a, const Limb *b)
+  {
+    std::array<Limb, 2 * N> out{};
+    if constexpr (N < karatsuba_threshold || N % 2 == 1) {
+      mul_schoolbook(a, N, b, N, out.data());
+    } else {
+      constexpr std::size_t H = N / 2;
+      const auto low = mul_full<H>(a, b);
+      const auto high = mul_full<H>(a + H, b + H);
+      std::array<Limb, H> da{}, db{};
+      const bool negative = sub_abs(a, a + H, da) != sub_abs(b + H, b, db);
+      const auto cross = mul_full<H>(da.data(), db.data());
+      // a0 b1 + a1 b0 < 2^(64N + 1), one limb more than the products
+      std::array<Limb, N + 1> middle{};
+      add_into(middle.data(), N + 1, low.data(), N);
+      add_into(middle.data(), N + 1, high.data(), N);
+      if (negative) {
+        sub_from(middle.data(), N + 1, cross.data(), N);
+      } else {
+        add_into(middle.data(), N + 1, cross.data(), N);
+      }
+      std::copy(low.begin(), low.end(), out.begin());
+      std::copy(high.begin(), high.end(), out.begin() + N);
+      add_into(out.data() + H, 2 * N - H, middle.data(), N + 1);
+    }
+    return out;
+  }
+
+  // the low N limbs of the product: a0 b0 whole, and only the low halves of the cross terms
+  template<std::size_t N> constexpr std::array<Limb, N> mul_low(const Limb *a, const Limb *b)
+  {
+    std::array<Limb, N> out{};
+    if constexpr (N < karatsuba_threshold || N % 2 == 1) {
+      mul_low_schoolbook(a, b, N, out.data());
+    } else {
+      constexpr std::size_t H = N / 2;
+      out = mul_full<H>(a, b);
+      const auto left = mul_low<H>(a, b + H);
+      const auto right = mul_low<H>(a + H, b);
+      add_into(out.data() + H, H, left.data(), H);
+      add_into(out.data() + H, H, right.data(), H);
+    }
+    return out;
+  }
+
+  // division of two limbs by a fixed one with a precomputed reciprocal, two multiplications instead of a `div`
+  // (möller and granlund, "improved division by invariant integers")
+  class LimbDivisor
+  {
+  private:
+    Limb m_divisor;// normalized, top bit set
+    int m_shift;
+    Limb m_reciprocal;// floor((2^128 - 1) / m_divisor) - 2^64
+
+  public:
+    explicit constexpr LimbDivisor(Limb d)
+      : m_divisor(d << std::countl_zero(d)), m_shift(std::countl_zero(d)),
+        m_reciprocal(static_cast<Limb>(~uint128_t{ 0 } / m_divisor))
+    {}
+
+    constexpr int shift() const { return m_shift; }
+
+    // (u1 u0) / d for a normalized (u1 u0) with u1 < d, the remainder goes into `r`
+    constexpr Limb divide(Limb u1, Limb u0, Limb &r) const
+    {
+      const uint128_t q = uint128_t{ m_reciprocal } * u1 + ((uint128_t{ u1 } << 64) | u0);
+      Limb q1 = static_cast<Limb>(q >> 64) + 1;
+      r = u0 - q1 * m_divisor;
+      if (r > static_cast<Limb>(q)) {
+        --q1;
+        r += m_divisor;
+      }
+      if (r >= m_divisor) {
+        ++q1;
+        r -= m_divisor;
+      }
+      return q1;
+    }
+
+    // x[0, n) /= d in place, returns x % d
+    constexpr Limb divide(Limb *x, std::size_t n) const
+    {
+      Limb r = 0;
+      if (m_shift == 0) {
+        for (std::size_t i = n; i-- > 0;) x[i] = divide(r, x[i], r);
+        return r;
+      }
+      // dividing x * 2^shift by d * 2^shift, the quotient doesn't change
+      r = x[n - 1] >> (64 - m_shift);
+      for (std::size_t i = n; i-- > 0;) {
+        const Limb u = (x[i] << m_shift) | (i > 0 ? x[i - 1] >> (64 - m_shift) : 0);
+        x[i] = divide(r, u, r);
+      }
+      return r >> m_shift;
+    }
+  };
+
+  // number of limbs without the leading zero ones
+  constexpr std::size_t significant(const Limb *x, std::size_t n)
+  {
+    while (n > 0 && x[n - 1] == 0) --n;
+    return n;
+  }
+
+  // knuth's algorithm d, q = u / v and r = u % v for v with at least two significant limbs
+  template<std::size_t N> constexpr void divmod_long(const Limb *u, const Limb *v, Limb *q, Limb *r)
+  {
+    const std::size_t m = significant(u, N);
+    const std::size_t n = significant(v, N);
+    std::fill(q, q + N, Limb{ 0 });
+    std::fill(r, r + N, Limb{ 0 });
+    if (m < n) {
+      std::copy(u, u + N, r);
+      return;
+    }
+    const int s = std::countl_zero(v[n - 1]);
+    const auto shifted = [s](const Limb *x, std::size_t i) {
+      return s == 0 ? x[i] : (x[i] << s) | (i > 0 ? x[i - 1] >> (64 - s) : 0);
+    };
+    std::array<Limb, N> vn{};
+    std::array<Limb, N + 1> un{};
+    for (std::size_t i = 0; i < n; ++i) vn[i] = shifted(v, i);
+    for (std::size_t i = 0; i < m; ++i) un[i] = shifted(u, i);
+    un[m] = s == 0 ? 0 : u[m - 1] >> (64 - s);
+    constexpr uint128_t base = uint128_t{ 1 } << 64;
+    for (std::size_t j = m - n + 1; j-- > 0;) {
+      const uint128_t top = (uint128_t{ un[j + n] } << 64) | un[j + n - 1];
+      uint128_t qhat = top / vn[n - 1];
+      uint128_t rhat = top % vn[n - 1];
+      while (qhat >= base || qhat * vn[n - 2] > ((rhat << 64) | un[j + n - 2])) {
+        --qhat;
+        rhat += vn[n - 1];
+        if (rhat >= base) break;
+      }
+      // un[j, j + n] -= qhat * vn
+      Limb carry = 0, borrow = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        const uint128_t p = qhat * vn[i] + carry;
+        carry = static_cast<Limb>(p >> 64);
+        un[i + j] = sub_borrow(un[i + j], static_cast<Limb>(p), borrow);
+      }
+      un[j + n] = sub_borrow(un[j + n], carry, borrow);
+      // qhat was one too big, rare (about 2/2^64 of the time)
+      if (borrow) {
+        --qhat;
+        Limb c = 0;
+        for (std::size_t i = 0; i < n; ++i) un[i + j] = add_carry(un[i + j], vn[i], c);
+        un[j + n] += c;
+      }
+      q[j] = static_cast<Limb>(qhat);
+    }
+    for (std::size_t i = 0; i < n; ++i) r[i] = s == 0 ? un[i] : (un[i] >> s) | (un[i + 1] << (64 - s));
+  }
+
+}// namespace bignum_detail
+
+template<std::size_t Bits, bool Signed> class BasicBignum
+{
+  static_assert(Bits % 64 == 0 && Bits >= 128, "use the builtin types below 128 bits");
+
+public:
+  using Limb = bignum_detail::Limb;
+  static constexpr std::size_t limbs = Bits / 64;
+
+private:
+  std::array<Limb, limbs> m_limbs{};// least significant first
+
+  template<std::size_t, bool> friend class BasicBignum;
+
+  constexpr bool top_bit() const { return m_limbs[limbs - 1] >> 63; }
+
+  constexpr BasicBignum magnitude() const { return negative() ? -*this : *this; }
+
+  // unsigned division of the magnitudes, `quotient` and `remainder` can be null
+  static constexpr void divide_unsigned(const BasicBignum &a,
+    const BasicBignum &b,
+    BasicBignum *quotient,
+    BasicBignum *remainder)
+  {
+    const std::size_t n = bignum_detail::significant(b.m_limbs.data(), limbs);
+    if (n == 0) throw BignumDivisionByZeroException{};
+    BasicBignum q, r;
+    if (n == 1) {
+      q = a;
+      r.m_limbs[0] = bignum_detail::LimbDivisor{ b.m_limbs[0] }.divide(q.m_limbs.data(), limbs);
+    } else {
+      bignum_detail::divmod_long<limbs>(a.m_limbs.data(), b.m_limbs.data(), q.m_limbs.data(), r.m_limbs.data());
+    }
+    if (quotient) *quotient = q;
+    if (remainder) *remainder = r;
+  }
+
+  // truncating, the remainder has the sign of the dividend, like the builtin ones
+  static constexpr void divide(const BasicBignum &a, const BasicBignum &b, BasicBignum *q, BasicBignum *r)
+  {
+    if constexpr (Signed) {
+      // before dividing, `q` or `r` can be `&a`
+      const bool a_negative = a.negative(), b_negative = b.negative();
+      divide_unsigned(a.magnitude(), b.magnitude(), q, r);
+      if (q && a_negative != b_negative) *q = -*q;
+      if (r && a_negative) *r = -*r;
+    } else {
+      divide_unsigned(a, b, q, r);
+    }
+  }
+
+public:
+  constexpr BasicBignum() = default;
+
+  // implicit, like the conversions between builtin integers, sign extended for negative values
+  template<typename I>
+    requires std::is_integral_v<I>
+  constexpr BasicBignum(I value)
+  {
+    // through 128 bits, which sign extends the narrower ones
+    using Wide = std::conditional_t<std::is_signed_v<I>, int128_t, uint128_t>;
+    const auto wide = static_cast<uint128_t>(static_cast<Wide>(value));
+    const Limb fill = value < I{ 0 } ? ~Limb{ 0 } : 0;
+    m_limbs[0] = static_cast<Limb>(wide);
+    m_limbs[1] = static_cast<Limb>(wide >> 64);
+    for (std::size_t i = 2; i < limbs; ++i) m_limbs[i] = fill;
+  }
+
+  // between widths and signedness, truncating or extending (by sign if the source is signed)
+  template<std::size_t OtherBits, bool OtherSigned>
+    requires(OtherBits != Bits || OtherSigned != Signed)
+  explicit constexpr BasicBignum(const BasicBignum<OtherBits, OtherSigned> &other)
+  {
+    const Limb fill = other.negative() ? ~Limb{ 0 } : 0;
+    for (std::size_t i = 0; i < limbs; ++i) m_limbs[i] = i < other.limbs ? other.m_limbs[i] : fill;
+  }
+
+  // decimal, with a '-' in front for negative values of the signed ones, wraps like everything else
+  static constexpr BasicBignum parse(std::string_view text)
+  {
+    const bool minus = !text.empty() && text.front() == '-';
+    if (minus) text.remove_prefix(1);
+    if (text.empty() || (minus && !Signed)) throw BignumParseException{};
+    BasicBignum out;
+    for (char c : text) {
+      if (c < '0' || c > '9') throw BignumParseException{};
+      out = out * BasicBignum{ 10 } + BasicBignum{ c - '0' };
+    }
+    return minus ? -out : out;
+  }
+
+  static constexpr BasicBignum from_limbs(const std::array<Limb, limbs> &limbs_)
+  {
+    BasicBignum out;
+    out.m_limbs = limbs_;
+    return out;
+  }
+
+  constexpr const std::array<Limb, limbs> &limb_array() const { return m_limbs; }
+  constexpr Limb limb(std::size_t i) const { return m_limbs[i]; }
+
+  constexpr bool negative() const
+  {
+    if constexpr (Signed) {
+      return top_bit();
+    } else {
+      return false;
+    }
+  }
+
+  // the low bits, converted like a builtin integer would be
+  template<typename I>
+    requires std::is_integral_v<I>
+  constexpr I get() const
+  {
+    using U = std::make_unsigned_t<I>;
+    U out = 0;
+    for (std::size_t i = 0; i < limbs && 64 * i < sizeof(I) * 8; ++i) out |= static_cast<U>(m_limbs[i]) << (64 * i);
+    return static_cast<I>(out);
+  }
+
+  template<typename I>
+    requires std::is_integral_v<I>
+  explicit constexpr operator I() const
+  {
+    return get<I>();
+  }
+
+  explicit constexpr operator bool() const { return *this != BasicBignum{}; }
+
+  // number of bits of the magnitude
+  constexpr std::size_t bit_width() const
+  {
+    const BasicBignum m = magnitude();
+    const std::size_t n = bignum_detail::significant(m.m_limbs.data(), limbs);
+    return n == 0 ? 0 : 64 * (n - 1) + static_cast<std::size_t>(std::bit_width(m.m_limbs[n - 1]));
+  }
+
+  constexpr BasicBignum &operator+=(const BasicBignum &other)
+  {
+    bignum_detail::add_into(m_limbs.data(), limbs, other.m_limbs.data(), limbs);
+    return *this;
+  }
+
+  constexpr BasicBignum &operator-=(const BasicBignum &other)
+  {
+    bignum_detail::sub_from(m_limbs.data(), limbs, other.m_limbs.data(), limbs);
+    return *this;
+  }
+
+  // two's complement makes the low half of the product the same for signed and unsigned
+  constexpr BasicBignum &operator*=(const BasicBignum &other)
+  {
+    m_limbs = bignum_detail::mul_low<limbs>(m_limbs.data(), other.m_limbs.data());
+    return *this;
+  }
+
+  constexpr BasicBignum &operator/=(const BasicBignum &other)
+  {
+    divide(*this, other, this, nullptr);
+    return *this;
+  }
+
+  constexpr BasicBignum &operator%=(const BasicBignum &other)
+  {
+    divide(*this, other, nullptr, this);
+    return *this;
+  }
+
+  constexpr BasicBignum &operator&=(const BasicBignum &other)
+  {
+    for (std::size_t i = 0; i < limbs; ++i) m_limbs[i] &= other.m_limbs[i];
+    return *this;
+  }
+
+  constexpr BasicBignum &operator|=(const BasicBignum &other)
+  {
+    for (std::size_t i = 0; i < limbs; ++i) m_limbs[i] |= other.m_limbs[i];
+    return *this;
+  }
+
+  constexpr BasicBignum &operator^=(const BasicBignum &other)
+  {
+    for (std::size_t i = 0; i < limbs; ++i) m_limbs[i] ^= other.m_limbs[i];
+    return *this;
+  }
+
+  // shifts by Bits or more give 0 (or -1 for negative values shifted right)
+  constexpr BasicBignum &operator<<=(std::size_t shift)
+  {
+    const std::size_t whole = shift / 64, bits = shift % 64;
+    for (std::size_t i = limbs; i-- > 0;) {
+      const Limb hi = i >= whole ? m_limbs[i - whole] : 0;
+      const Limb lo = i >= whole + 1 ? m_limbs[i - whole - 1] : 0;
+      m_limbs[i] = bits == 0 ? hi : (hi << bits) | (lo >> (64 - bits));
+    }
+    return *this;
+  }
+
+  // arithmetic for the signed ones
+  constexpr BasicBignum &operator>>=(std::size_t shift)
+  {
+    const Limb fill = negative() ? ~Limb{ 0 } : 0;
+    const std::size_t whole = shift / 64, bits = shift % 64;
+    for (std::size_t i = 0; i < limbs; ++i) {
+      const Limb lo = i + whole < limbs ? m_limbs[i + whole] : fill;
+      const Limb hi = i + whole + 1 < limbs ? m_limbs[i + whole + 1] : fill;
+      m_limbs[i] = bits == 0 ? lo : (lo >> bits) | (hi << (64 - bits));
+    }
+    return *this;
+  }
+
+  constexpr BasicBignum operator~() const
+  {
+    BasicBignum out;
+    for (std::size_t i = 0; i < limbs; ++i) out.m_limbs[i] = ~m_limbs[i];
+    return out;
+  }
+
+  constexpr BasicBignum operator-() const { return ~*this + BasicBignum{ 1 }; }
+  constexpr BasicBignum operator+() const { return *this; }
+
+  constexpr BasicBignum &operator++() { return *this += BasicBignum{ 1 }; }
+  constexpr BasicBignum &operator--() { return *this -= BasicBignum{ 1 }; }
+
+  constexpr BasicBignum operator++(int)
+  {
+    auto out = *this;
+    ++*this;
+    return out;
+  }
+
+  constexpr BasicBignum operator--(int)
+  {
+    auto out = *this;
+    --*this;
+    return out;
+  }
+
+  friend constexpr BasicBignum operator+(BasicBignum left, const BasicBignum &right) { return left += right; }
+  friend constexpr BasicBignum operator-(BasicBignum left, const BasicBignum &right) { return left -= right; }
+  friend constexpr BasicBignum operator*(BasicBignum left, const BasicBignum &right) { return left *= right; }
+  friend constexpr BasicBignum operator/(BasicBignum left, const BasicBignum &right) { return left /= right; }
+  friend constexpr BasicBignum operator%(BasicBignum left, const BasicBignum &right) { return left %= right; }
+  friend constexpr BasicBignum operator&(BasicBignum left, const BasicBignum &right) { return left &= right; }
+  friend constexpr BasicBignum operator|(BasicBignum left, const BasicBignum &right) { return left |= right; }
+  friend constexpr BasicBignum operator^(BasicBignum left, const BasicBignum &right) { return left ^= right; }
+  friend constexpr BasicBignum operator<<(BasicBignum left, std::size_t shift) { return left <<= shift; }
+  friend constexpr BasicBignum operator>>(BasicBignum left, std::size_t shift) { return left >>= shift; }
+
+  friend constexpr bool operator==(const BasicBignum &left, const BasicBignum &right) = default;
+
+  friend constexpr std::strong_ordering operator<=>(const BasicBignum &left, const BasicBignum &right)
+  {
+    if (left.negative() != right.negative()) return left.negative() ? std::strong_ordering::less
+                                                                      : std::strong_ordering::greater;
+    for (std::size_t i = limbs; i-- > 0;) {
+      if (left.m_limbs[i] != right.m_limbs[i]) return left.m_limbs[i] <=> right.m_limbs[i];
+    }
+    return std::strong_ordering::equal;
+  }
+
+  // both at once, for the price of one
+  friend constexpr std::pair<BasicBignum, BasicBignum> divmod(const BasicBignum &a, const BasicBignum &b)
+  {
+    std::pair<BasicBignum, BasicBignum> out;
+    divide(a, b, &out.first, &out.second);
+    return out;
+  }
+
+  // 19 decimal digits per division by one limb
+  std::string to_string() const
+  {
+    constexpr Limb chunk = 10'000'000'000'000'000'000ULL;
+    const bignum_detail::LimbDivisor divisor{ chunk };
+    BasicBignum m = magnitude();
+    std::string out;
+    do {
+      Limb r = divisor.divide(m.m_limbs.data(), limbs);
+      const bool last = m == BasicBignum{};
+      for (int i = 0; i < 19 && (!last || r != 0); ++i) {
+        out.push_back(static_cast<char>('0' + r % 10));
+        r /= 10;
+      }
+    } while (m != BasicBignum{});
+    if (out.empty()) out = "0";
+    if (negative()) out.push_back('-');
+    std::reverse(out.begin(), out.end());
+    return out;
+  }
+
+  friend std::ostream &operator<<(std::ostream &out, const BasicBignum &x) { return out << x.to_string(); }
+};
+
+template<std::size_t Bits> using Bignum = BasicBignum<Bits, true>;
+template<std::size_t Bits> using UnsignedBignum = BasicBignum<Bits, false>;
+
+static_assert(sizeof(Bignum<256>) == 32 && std::is_trivially_copyable_v<Bignum<256>>);
+static_assert(Bignum<128>{ -5 } / Bignum<128>{ 2 } == -2 && Bignum<128>{ -5 } % Bignum<128>{ 2 } == -1);
+static_assert(Bignum<128>{ -1 } < Bignum<128>{ 0 } && UnsignedBignum<128>{ -1 } > UnsignedBignum<128>{ 0 });
+static_assert((UnsignedBignum<256>{ 1 } << 200 >> 199) == 2 && (Bignum<256>{ -8 } >> 2) == -2);
+static_assert(UnsignedBignum<128>{ ~std::uint64_t{ 0 } } * UnsignedBignum<128>{ ~std::uint64_t{ 0 } }
+              == UnsignedBignum<128>{ uint128_t{ ~std::uint64_t{ 0 } } * ~std::uint64_t{ 0 } });
+static_assert(divmod(Bignum<512>::parse("-123456789012345678901234567890"), Bignum<512>{ 1234567890123 })
+              == std::pair{ Bignum<512>{ -100000000000036999 }, Bignum<512>{ -1123867907013 } });
+
+// montgomery arithmetic modulo an odd n with R = 2^Bits, values in [0, n) and in montgomery form,
+// same interface as `Montgomery64`: `to`, `from`, `mul`, `one`, `pow`, plus `add` and `sub`
+template<std::size_t Bits> class BignumMontgomery
+{
+public:
+  using value_type = UnsignedBignum<Bits>;
+
+private:
+  using Limb = bignum_detail::Limb;
+  static constexpr std::size_t limbs = value_type::limbs;
+
+  value_type m_n;
+  Limb m_n_neg_inv;// -n^-1 mod 2^64
+  value_type m_r2;// R^2 mod n
+
+  // t[0, 2 limbs] * R^-1 mod n, t < n R
+  constexpr value_type reduce(std::array<Limb, 2 * limbs + 1> t) const
+  {
+    const auto &n = m_n.limb_array();
+    for (std::size_t i = 0; i < limbs; ++i) {
+      const Limb m = t[i] * m_n_neg_inv;
+      Limb carry = 0;
+      for (std::size_t j = 0; j < limbs; ++j) {
+        const uint128_t s = uint128_t{ m } * n[j] + t[i + j] + carry;
+        t[i + j] = static_cast<Limb>(s);
+        carry = static_cast<Limb>(s >> 64);
+      }
+      bignum_detail::add_into(t.data() + i + limbs, limbs + 1 - i, &carry, 1);
+    }
+    std::array<Limb, limbs> out{};
+    std::copy(t.begin() + limbs, t.begin() + 2 * limbs, out.begin());
+    auto r = value_type::from_limbs(out);
+    if (t[2 * limbs] != 0 || r >= m_n) r -= m_n;
+    return r;
+  }
+
+public:
+  static constexpr bool supports(const value_type &m) { return m.limb(0) % 2 == 1; }
+
+  explicit constexpr BignumMontgomery(const value_type &n) : m_n(n), m_n_neg_inv(n.limb(0)), m_r2(0)
+  {
+    if (!supports(n)) throw InvalidModulusException{};
+    // newton iteration, each step doubles the number of correct bits (3 -> 96)
+    for (std::uint32_t i = 0; i < 5; ++i) m_n_neg_inv *= 2 - n.limb(0) * m_n_neg_inv;
+    m_n_neg_inv = 0 - m_n_neg_inv;
+    // R mod n, then doubled Bits times
+    value_type r = (value_type{} - n) % n;
+    for (std::size_t i = 0; i < Bits; ++i) {
+      const bool overflow = (r >> (Bits - 1)) != value_type{};
+      r += r;
+      if (overflow || r >= n) r -= n;
+    }
+    m_r2 = r;
+  }
+
+  constexpr const value_type &modulus() const { return m_n; }
+
+  // a * b * R^-1 mod n, the whole product first (karatsuba for the big ones) and then the reduction
+  constexpr value_type mul(const value_type &a, const value_type &b) const
+  {
+    const auto product = bignum_detail::mul_full<limbs>(a.limb_array().data(), b.limb_array().data());
+    std::array<Limb, 2 * limbs + 1> t{};
+    std::copy(product.begin(), product.end(), t.begin());
+    return reduce(t);
+  }
+
+  constexpr value_type add(const value_type &a, const value_type &b) const
+  {
+    value_type out = a + b;
+    // a + b can wrap around 2^Bits when n is close to it
+    if (out < a || out >= m_n) out -= m_n;
+    return out;
+  }
+
+  constexpr value_type sub(const value_type &a, const value_type &b) const { return a >= b ? a - b : a - b + m_n; }
+
+  constexpr value_type to(const value_type &a) const { return mul(a % m_n, m_r2); }
+  constexpr value_type from(const value_type &a) const
+  {
+    std::array<Limb, 2 * limbs + 1> t{};
+    std::copy(a.limb_array().begin(), a.limb_array().end(), t.begin());
+    return reduce(t);
+  }
+  constexpr value_type one() const { return to(value_type{ 1 }); }
+
+  // a in montgomery form, so is the result
+  constexpr value_type pow(value_type a, value_type e) const
+  {
+    value_type out = one();
+    while (e != value_type{}) {
+      if (e.limb(0) % 2 == 1) out = mul(out, a);
+      e >>= 1;
+      a = mul(a, a);
+    }
+    return out;
+  }
+};
+
+static_assert([] {
+  // the secp256k1 prime, 2^256 - 2^32 - 977, so fermat says 3^(p - 1) == 1
+  const auto p = (UnsignedBignum<256>{ 1 } << 256) - (UnsignedBignum<256>{ 1 } << 32) - 977;
+  const BignumMontgomery<256> mont{ p };
+  return mont.from(mont.pow(mont.to(3), p - 1)) == 1 && mont.from(mont.mul(mont.to(7), mont.to(6))) == 42;
+}());
+
+}// namespace ivl::nt
+
+// so that `numeric_limits`-driven code (e.g. `DefaultFactorization`) treats them like the builtin integers
+template<std::size_t Bits, bool Signed> struct std::numeric_limits<ivl::nt::BasicBignum<Bits, Signed>>
+{
+private:
+  using T = ivl::nt::BasicBignum<Bits, Signed>;
+
+public:
+  static constexpr bool is_specialized = true;
+  static constexpr bool is_signed = Signed;
+  static constexpr bool is_integer = true;
+  static constexpr bool is_exact = true;
+  static constexpr bool is_modulo = true;
+  static constexpr int radix = 2;
+  static constexpr int digits = static_cast<int>(Bits) - (Signed ? 1 : 0);
+  static constexpr int digits10 = digits * 30103 / 100000;
+
+  static constexpr T min() { return Signed ? T{ 1 } << (Bits - 1) : T{}; }
+  static constexpr T lowest() { return min(); }
+  static constexpr T max() { return ~min(); }
+};
@@ -1,22 +1,32 @@
 #pragma once
 
 #include <ivl/factorize.hpp>
+#include <ivl/instrument.hpp>
 
-#include <functional>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <vector>
 
 namespace ivl::nt {
 
 // fun fact: first * last = 2nd * 2nd last = ...
-template<typename T> std::vector<T> generate_all_divisors(const Factorization<T> &factorization)
+template<FactorizationLike F> auto generate_all_divisors(const F &factorization)
 {
+  using T = std::remove_cvref_t<decltype(prime_at(factorization, 0))>;
   std::uint32_t full_count = 1;
-  for (auto [p, e] : factorization) { full_count *= e + 1; }// full_count = tau
+  for (std::size_t j = 0; j < factorization_size(factorization); ++j) {
+    full_count *= exponent_at(factorization, j) + 1;// full_count = tau
+  }
+  instrument::add(instrument::Counter::divisors_generated, full_count);
   std::vector<T> out(full_count);
   std::uint32_t count = 1;
   out[0] = 1;
-  for (auto [p, e] : factorization) {
+  for (std::size_t j = 0; j < factorization_size(factorization); ++j) {
+    const T &p = prime_at(factorization, j);
     const auto prev_count = count;
-    for (uint32_t i = 0; i < e * prev_count; ++i) {
+    for (uint32_t i = 0; i < exponent_at(factorization, j) * prev_count; ++i) {
       out[count] = out[count - prev_count] * p;
       ++count;
     }
@@ -24,69 +34,112 @@ template<typename T> std::vector<T> generate_all_divisors(const Factorization<T>
   return out;
 }
 
-template<typename T> class DivisorIterable
+// walks the divisors in reflected gray code order: consecutive divisors differ in one exponent by one,
+// so every step is a single multiplication or exact division of the value, O(1) amortized
+// `*it` has the divisor's `value` and its `factorization` (same type as the one given,
+// all of its primes, with the divisor's exponents), both kept up to date in place
+// an iterator holds its divisor, so copying one (`it++` and ranges algorithms do) copies the factorization,
+// with an `InlineFactorization` that is a fixed size copy and the whole walk is allocation free,
+// a `Factorization` allocates on every copy
+// `end()` is `std::default_sentinel`
+template<FactorizationLike F> class DivisorIterable
 {
-private:
-  std::reference_wrapper<const Factorization<T>> factorization;
-
 public:
-  DivisorIterable(const Factorization<T> &_factorization) : factorization(_factorization) {}
+  using ValueType = std::remove_cvref_t<decltype(prime_at(std::declval<const F &>(), 0))>;
 
-  class Iterator;
-  friend class Iterator;
+  struct Divisor
+  {
+    ValueType value;
+    F factorization;
+  };
 
-  Iterator begin() const { return Iterator{ *this }; }
-  Iterator end() const { return Iterator{}; }
+private:
+  const F *m_factorization;
+
+public:
+  DivisorIterable(const F &factorization) : m_factorization(&factorization) {}
 
-  // TODO: iterator_tag stuff
   class Iterator
   {
   private:
-    // not reference wrapper bc we nullify it in end
-    const Factorization<T> *factorization;
-    // TODO-think: oof this makes me feel like
-    // the correct choice was [[p1, p2, ...], [e1, e2, ...]]
-    // instead of [[p1, e2], [p2, e2], ...]
-    Factorization<T> divisor;
+    // nullptr once past the last divisor
+    const F *m_factorization = nullptr;
+    Divisor m_divisor{};
+    // bit i set means exponent i is currently going down
+    // more than 64 distinct primes would be more than 2^64 divisors anyway
+    std::uint64_t m_directions = 0;
+    std::uint64_t m_index = 0;
 
   public:
-    // to construct `end`
-    Iterator() : factorization(nullptr), divisor() {}
+    using value_type = Divisor;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() = default;
 
-    explicit Iterator(const DivisorIterable &parent)
-      : factorization(&(parent.factorization.get())), divisor(*factorization)
+    explicit Iterator(const F &factorization)
+      : m_factorization(&factorization), m_divisor{ ValueType{ 1 }, factorization }
     {
-      for (auto &[p, e] : divisor) e = 0;
+      if (factorization_size(factorization) > 64) throw FactorizationCapacityException{};
+      for (std::size_t i = 0; i < factorization_size(m_divisor.factorization); ++i) {
+        exponent_at(m_divisor.factorization, i) = 0;
+      }
+      instrument::add(instrument::Counter::divisors_generated);
     }
 
+    const Divisor &operator*() const { return m_divisor; }
+    const Divisor *operator->() const { return &m_divisor; }
+
     Iterator &operator++()
     {
-      std::size_t i = 0;
-      // TODO: refactor
-      for (; i < divisor.size(); ++i) {
-        if (++divisor[i].second == (*factorization)[i].second + 1) {
-          divisor[i].second = 0;
-        } else {
-          break;
+      // the first exponent that can still move in its direction moves,
+      // the ones before it are stuck at an end and turn around
+      std::uint64_t bit = 1;
+      for (std::size_t i = 0; i < factorization_size(m_divisor.factorization); ++i, bit <<= 1) {
+        auto &e = exponent_at(m_divisor.factorization, i);
+        if (m_directions & bit) {
+          if (e > 0) {
+            --e;
+            m_divisor.value /= prime_at(m_divisor.factorization, i);
+            ++m_index;
+            instrument::add(instrument::Counter::divisors_generated);
+            return *this;
+          }
+        } else if (e < exponent_at(*m_factorization, i)) {
+          ++e;
+          m_divisor.value *= prime_at(m_divisor.factorization, i);
+          ++m_index;
+          instrument::add(instrument::Counter::divisors_generated);
+          return *this;
         }
+        m_directions ^= bit;
       }
-      if (i == divisor.size()) {
-        // end
-        factorization = nullptr;
-        divisor.clear();
-      }
+      m_factorization = nullptr;
       return *this;
     }
 
-    const Factorization<T> &operator*() const { return divisor; }
+    Iterator operator++(int)
+    {
+      auto out = *this;
+      ++*this;
+      return out;
+    }
 
     friend bool operator==(const Iterator &left, const Iterator &right)
     {
-      return left.factorization == right.factorization && left.divisor == right.divisor;
+      return left.m_factorization == right.m_factorization
+             && (left.m_factorization == nullptr || left.m_index == right.m_index);
     }
+
+    friend bool operator==(const Iterator &it, std::default_sentinel_t) { return it.m_factorization == nullptr; }
   };
+
+  Iterator begin() const { return Iterator{ *m_factorization }; }
+  std::default_sentinel_t end() const { return std::default_sentinel; }
 };
 
-template<typename T> DivisorIterable(const Factorization<T> &) -> DivisorIterable<T>;
+template<FactorizationLike F> DivisorIterable(const F &) -> DivisorIterable<F>;
+
+static_assert(std::ranges::forward_range<DivisorIterable<Factorization<int>>>);
+static_assert(std::ranges::forward_range<DivisorIterable<InlineFactorization<std::uint64_t>>>);
 
 }// namespace ivl::nt
@@ -0,0 +1,202 @@
+#pragma once
+
+// arithmetic on factorizations, so that a product, quotient, gcd, ... of factorized numbers stays factorized
+// everything walks the primes in increasing order, nothing is ever factorized again
+// * `multiply_factorizations(range)`: the product of any number of them in one pass (k-way merge with a heap),
+//   `merge_factorizations` from factorize.hpp is the two argument version
+// * `gcd_factorizations`, `lcm_factorizations`
+// * `divides_factorization(d, n)`, `divide_factorizations(n, d)` (exact, throws otherwise)
+// * `pow_factorization(f, k)`
+// the ones that take a factorization by value work in its storage, pass an rvalue to skip the copy
+
+#include <ivl/factorize.hpp>
+#include <ivl/instrument.hpp>
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ivl::nt {
+
+class FactorizationDivisionException : public std::exception
+{
+public:
+  virtual const char *what() const noexcept override
+  {
+    return "divided a factorization by one that doesn't divide it";
+  }
+};
+
+namespace factorization_algebra_detail {
+
+  // the union of the primes of both, increasing, as f(p, exponent in left, exponent in right), 0 where one lacks p
+  template<typename F, typename Callable> constexpr void for_each_prime(const F &left, const F &right, Callable &&f)
+  {
+    using ET = std::remove_cvref_t<decltype(exponent_at(left, 0))>;
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < factorization_size(left) || j < factorization_size(right)) {
+      if (j == factorization_size(right) || (i < factorization_size(left) && prime_at(left, i) < prime_at(right, j))) {
+        f(prime_at(left, i), exponent_at(left, i), ET{ 0 });
+        ++i;
+      } else if (i == factorization_size(left) || prime_at(right, j) < prime_at(left, i)) {
+        f(prime_at(right, j), ET{ 0 }, exponent_at(right, j));
+        ++j;
+      } else {
+        f(prime_at(left, i), exponent_at(left, i), exponent_at(right, j));
+        ++i;
+        ++j;
+      }
+    }
+  }
+
+  // removes the primes whose exponent went down to 0, in place for a vector
+  template<typename F> constexpr void drop_zero_exponents(F &f)
+  {
+    if constexpr (requires { std::erase_if(f, [](const auto &) { return false; }); }) {
+      std::erase_if(f, [](const auto &pair) { return pair.second == 0; });
+    } else {
+      F out;
+      for (std::size_t i = 0; i < factorization_size(f); ++i) {
+        if (exponent_at(f, i) != 0) append_factor(out, prime_at(f, i), exponent_at(f, i));
+      }
+      f = std::move(out);
+    }
+  }
+
+}// namespace factorization_algebra_detail
+
+// the product of every factorization in the range
+template<std::ranges::forward_range R>
+  requires BuildableFactorization<std::ranges::range_value_t<R>>
+constexpr std::ranges::range_value_t<R> multiply_factorizations(const R &factorizations)
+{
+  using F = std::ranges::range_value_t<R>;
+  instrument::add(instrument::Counter::merges);
+  std::vector<std::ranges::iterator_t<const R>> sources;
+  for (auto it = std::ranges::begin(factorizations); it != std::ranges::end(factorizations); ++it) {
+    sources.push_back(it);
+  }
+  // (source, position in it), the smallest prime on top
+  std::vector<std::pair<std::size_t, std::size_t>> heap;
+  const auto prime = [&](const std::pair<std::size_t, std::size_t> &at) -> decltype(auto) {
+    return prime_at(*sources[at.first], at.second);
+  };
+  const auto later = [&](const auto &a, const auto &b) { return prime(b) < prime(a); };
+  for (std::size_t s = 0; s < sources.size(); ++s) {
+    if (factorization_size(*sources[s]) != 0) heap.emplace_back(s, 0);
+  }
+  std::make_heap(heap.begin(), heap.end(), later);
+  F out;
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), later);
+    auto &[s, i] = heap.back();
+    const auto &p = prime_at(*sources[s], i);
+    const auto e = exponent_at(*sources[s], i);
+    const std::size_t size = factorization_size(out);
+    if (size != 0 && prime_at(out, size - 1) == p) {
+      exponent_at(out, size - 1) += e;
+    } else {
+      append_factor(out, p, e);
+    }
+    if (++i == factorization_size(*sources[s])) {
+      heap.pop_back();
+    } else {
+      std::push_heap(heap.begin(), heap.end(), later);
+    }
+  }
+  return out;
+}
+
+template<BuildableFactorization F> constexpr F gcd_factorizations(F left, const F &right)
+{
+  std::size_t j = 0;
+  for (std::size_t i = 0; i < factorization_size(left); ++i) {
+    while (j < factorization_size(right) && prime_at(right, j) < prime_at(left, i)) ++j;
+    auto &e = exponent_at(left, i);
+    e = j < factorization_size(right) && prime_at(right, j) == prime_at(left, i) ? std::min(e, exponent_at(right, j))
+                                                                                  : 0;
+  }
+  factorization_algebra_detail::drop_zero_exponents(left);
+  return left;
+}
+
+template<BuildableFactorization F> constexpr F lcm_factorizations(const F &left, const F &right)
+{
+  F out;
+  factorization_algebra_detail::for_each_prime(
+    left, right, [&](const auto &p, auto a, auto b) { append_factor(out, p, std::max(a, b)); });
+  return out;
+}
+
+// whether the number `d` factorizes into divides the one of `n`
+template<FactorizationLike F> constexpr bool divides_factorization(const F &d, const F &n)
+{
+  bool out = true;
+  factorization_algebra_detail::for_each_prime(d, n, [&](const auto &, auto a, auto b) { out = out && a <= b; });
+  return out;
+}
+
+// n / d, `FactorizationDivisionException` unless d divides n
+template<BuildableFactorization F> constexpr F divide_factorizations(F n, const F &d)
+{
+  std::size_t i = 0;
+  for (std::size_t j = 0; j < factorization_size(d); ++j) {
+    while (i < factorization_size(n) && prime_at(n, i) < prime_at(d, j)) ++i;
+    if (i == factorization_size(n) || prime_at(d, j) < prime_at(n, i) || exponent_at(n, i) < exponent_at(d, j)) {
+      throw FactorizationDivisionException{};
+    }
+    exponent_at(n, i) -= exponent_at(d, j);
+  }
+  factorization_algebra_detail::drop_zero_exponents(n);
+  return n;
+}
+
+// f^k, the empty factorization (of 1) for k = 0
+template<BuildableFactorization F, std::unsigned_integral K> constexpr F pow_factorization(F f, K k)
+{
+  if (k == 0) return F{};
+  for (std::size_t i = 0; i < factorization_size(f); ++i) {
+    auto &e = exponent_at(f, i);
+    e = static_cast<std::remove_cvref_t<decltype(e)>>(e * k);
+  }
+  return f;
+}
+
+namespace factorization_algebra_detail {
+
+  // (no initializer lists of vectors in constant expressions, gcc 12 chokes on them)
+  template<typename F = Factorization<int>> constexpr std::vector<F> factorize_all(auto... n)
+  {
+    std::vector<F> out;
+    (..., out.push_back(factorize<int, ExponentType, F>(n)));
+    return out;
+  }
+
+}// namespace factorization_algebra_detail
+
+static_assert(multiply_factorizations(factorization_algebra_detail::factorize_all(12, 90, 1, 77))
+              == factorize(12 * 90 * 77));
+static_assert(multiply_factorizations(std::vector<Factorization<int>>{}).empty());
+static_assert(multiply_factorizations(factorization_algebra_detail::factorize_all<InlineFactorization<int>>(12, 35, 6))
+              == factorize<int, ExponentType, InlineFactorization<int>>(2520));
+static_assert(gcd_factorizations(factorize(360), factorize(2100)) == factorize(60)
+              && gcd_factorizations(factorize(7), factorize(10)).empty());
+static_assert(gcd_factorizations(factorize<int, ExponentType, InlineFactorization<int>>(360),
+                factorize<int, ExponentType, InlineFactorization<int>>(2100))
+              == factorize<int, ExponentType, InlineFactorization<int>>(60));
+static_assert(lcm_factorizations(factorize(360), factorize(2100)) == factorize(12600));
+static_assert(divides_factorization(factorize(60), factorize(360)) && divides_factorization(factorize(1), factorize(7))
+              && !divides_factorization(factorize(7), factorize(360))
+              && !divides_factorization(factorize(8), factorize(60)));
+static_assert(divide_factorizations(factorize(360), factorize(60)) == factorize(6)
+              && divide_factorizations(factorize(360), factorize(360)).empty());
+static_assert(pow_factorization(factorize(12), 3U) == factorize(1728) && pow_factorization(factorize(12), 0U).empty());
+
+}// namespace ivl::nt
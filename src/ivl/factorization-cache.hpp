@@ -0,0 +1,215 @@
+#pragma once
+
+// bounded factorization cache that can be shared between threads
+// set associative: a value hashes to one set of `ways` entries, a full set evicts with CLOCK
+// (second chance), sets are guarded by striped mutexes, so threads only contend on the same stripe
+// nothing allocates after construction when the factorization type is `InlineFactorization`
+
+#include <ivl/factorize.hpp>
+#include <ivl/instrument.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// entries of the process wide caches, see `shared_factorization_cache`
+#ifndef IVL_NT_FACTORIZATION_CACHE_CAPACITY
+#define IVL_NT_FACTORIZATION_CACHE_CAPACITY (1 << 16)
+#endif
+
+namespace ivl::nt {
+
+struct FactorizationCacheStats
+{
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  std::uint64_t evictions = 0;
+  std::uint64_t size = 0;
+};
+
+namespace cache_detail {
+
+  // splitmix64 finalizer, consecutive integers end up in unrelated sets
+  constexpr std::uint64_t mix(std::uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+  }
+
+  template<typename T> std::uint64_t hash(const T &value)
+  {
+    if constexpr (std::is_integral_v<T>) {
+      return mix(static_cast<std::uint64_t>(value));
+    } else {
+      return mix(std::hash<T>{}(value));
+    }
+  }
+
+}// namespace cache_detail
+
+template<typename T, typename F = DefaultFactorization<T>, std::size_t Ways = 8> class FactorizationCache
+{
+private:
+  struct Entry
+  {
+    T key{};
+    F value{};
+    bool occupied = false;
+    bool referenced = false;
+  };
+
+  // one per stripe, on its own cache line so the mutexes don't false share
+  struct alignas(64) Stripe
+  {
+    std::mutex mutex;
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t size = 0;
+  };
+
+  std::size_t m_sets;
+  std::size_t m_stripe_count;
+  std::vector<Entry> m_entries;// set s is [s * Ways, (s + 1) * Ways)
+  std::vector<std::uint8_t> m_hands;// clock hand of every set
+  std::unique_ptr<Stripe[]> m_stripes;
+
+  std::size_t set_of(const T &n) const { return static_cast<std::size_t>(cache_detail::hash(n) % m_sets); }
+  Stripe &stripe_of(std::size_t set) const { return m_stripes[set % m_stripe_count]; }
+
+  // caller holds the stripe
+  Entry *lookup(std::size_t set, const T &n)
+  {
+    for (std::size_t w = 0; w < Ways; ++w) {
+      auto &entry = m_entries[set * Ways + w];
+      if (entry.occupied && entry.key == n) return &entry;
+    }
+    return nullptr;
+  }
+
+public:
+  // `capacity` is rounded up to whole sets
+  explicit FactorizationCache(std::size_t capacity, std::size_t stripes = 64)
+    : m_sets(std::max<std::size_t>((capacity + Ways - 1) / Ways, 1)),
+      m_stripe_count(std::clamp<std::size_t>(stripes, 1, m_sets)), m_entries(m_sets * Ways), m_hands(m_sets, 0),
+      m_stripes(new Stripe[m_stripe_count])
+  {
+    static_assert(Ways > 0 && Ways <= 255);
+  }
+
+  FactorizationCache(const FactorizationCache &) = delete;
+  FactorizationCache &operator=(const FactorizationCache &) = delete;
+
+  std::size_t capacity() const { return m_entries.size(); }
+
+  // a copy, the entry can get evicted as soon as the lock is gone
+  std::optional<F> find(const T &n)
+  {
+    const std::size_t set = set_of(n);
+    auto &stripe = stripe_of(set);
+    std::lock_guard lock{ stripe.mutex };
+    if (auto *entry = lookup(set, n)) {
+      ++stripe.hits;
+      instrument::add(instrument::Counter::cache_hits);
+      entry->referenced = true;
+      return entry->value;
+    }
+    ++stripe.misses;
+    instrument::add(instrument::Counter::cache_misses);
+    return std::nullopt;
+  }
+
+  void insert(const T &n, const F &factorization)
+  {
+    const std::size_t set = set_of(n);
+    auto &stripe = stripe_of(set);
+    std::lock_guard lock{ stripe.mutex };
+    if (auto *entry = lookup(set, n)) {
+      entry->referenced = true;
+      return;
+    }
+    // second chance: referenced entries get skipped once, with their bit cleared
+    auto &hand = m_hands[set];
+    while (true) {
+      auto &entry = m_entries[set * Ways + hand];
+      hand = static_cast<std::uint8_t>((hand + 1) % Ways);
+      if (entry.occupied && entry.referenced) {
+        entry.referenced = false;
+        continue;
+      }
+      if (entry.occupied) {
+        ++stripe.evictions;
+      } else {
+        ++stripe.size;
+      }
+      entry = { n, factorization, true, false };
+      return;
+    }
+  }
+
+  // `compute(n)` runs without any lock held on a miss,
+  // so two threads missing on the same value at once both compute it
+  template<typename Compute> F get_or_compute(const T &n, Compute &&compute)
+  {
+    if (auto found = find(n)) return *std::move(found);
+    F factorization = compute(n);
+    insert(n, factorization);
+    return factorization;
+  }
+
+  FactorizationCacheStats stats() const
+  {
+    FactorizationCacheStats out;
+    for (std::size_t s = 0; s < m_stripe_count; ++s) {
+      auto &stripe = m_stripes[s];
+      std::lock_guard lock{ stripe.mutex };
+      out.hits += stripe.hits;
+      out.misses += stripe.misses;
+      out.evictions += stripe.evictions;
+      out.size += stripe.size;
+    }
+    return out;
+  }
+
+  // drops the entries, keeps the counters
+  void clear()
+  {
+    for (std::size_t s = 0; s < m_stripe_count; ++s) {
+      auto &stripe = m_stripes[s];
+      std::lock_guard lock{ stripe.mutex };
+      for (std::size_t set = s; set < m_sets; set += m_stripe_count) {
+        for (std::size_t w = 0; w < Ways; ++w) m_entries[set * Ways + w] = {};
+      }
+      stripe.size = 0;
+    }
+  }
+};
+
+// one cache per (T, F) for the whole process, opt in from `Lazy` with `LazySharedCacheTraits`
+// or from plain code with `factorize(n, shared_factorization_cache<T>())`
+template<typename T, typename F = DefaultFactorization<T>> FactorizationCache<T, F> &shared_factorization_cache()
+{
+  static FactorizationCache<T, F> cache{ IVL_NT_FACTORIZATION_CACHE_CAPACITY };
+  return cache;
+}
+
+// the default `factorize` on a miss
+template<typename T, typename F, std::size_t Ways> F factorize(const T &n, FactorizationCache<T, F, Ways> &cache)
+{
+  return cache.get_or_compute(n, [](const T &v) {
+    using ::ivl::nt::factorize;
+    return factorize<T, ExponentType, F>(v);
+  });
+}
+
+}// namespace ivl::nt
@@ -1,6 +1,22 @@
 #pragma once
 
+#include <ivl/instrument.hpp>
+#include <ivl/int128.hpp>
+#include <ivl/simd-divisibility.hpp>
+#include <ivl/small-tables.hpp>
+#include <ivl/wheel.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
 #include <cstdint>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <ranges>
+#include <span>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -18,34 +34,379 @@ namespace ivl::nt {
 // though that might be annoying since you can't `using namespace <class>;`
 using ExponentType = std::uint32_t;
 
-// TODO-think: is `std::vector` the best choice for the factorization?
-// no idea, it probably should be customizable, whatever for now
 // TODO: make this a wrapper around `std::vector`, this is prone to bugs:
 // Factorization<int> f{100}; <-- doesn't do what a lot of people would think
+// `InlineFactorization` below is the allocation free alternative,
+// everything that takes a factorization goes through the accessors further down
+// and doesn't care which one it gets
 template<typename T, typename ET = ExponentType> using Factorization = std::vector<std::pair<T, ET>>;
 
+// non-owning view of a factorization that lives in some bigger buffer
+template<typename T, typename ET = ExponentType> using FactorizationView = std::span<const std::pair<T, ET>>;
+
+namespace factorization_detail {
+
+  inline constexpr std::array<std::uint32_t, 26> small_primes{
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97, 101
+  };
+
+  // largest k such that the product of the first k primes fits in T
+  template<typename T> constexpr std::size_t max_distinct_primes()
+  {
+    constexpr int digits = std::numeric_limits<T>::digits;
+    static_assert(std::numeric_limits<T>::is_integer && digits <= 128, "capacity has to be given explicitly");
+    const uint128_t limit = digits == 128 ? ~uint128_t{ 0 } : (uint128_t{ 1 } << digits) - 1;
+    uint128_t product = 1;
+    std::size_t k = 0;
+    for (std::uint32_t p : small_primes) {
+      if (product > limit / p) break;
+      product *= p;
+      ++k;
+    }
+    return k;
+  }
+
+}// namespace factorization_detail
+
+// iterates as (prime, exponent) pairs that convert to T and ET, e.g. a `Factorization` or a `FactorizationView`
+template<typename R, typename T, typename ET> concept FactorPairRange =
+  std::ranges::input_range<const R> && requires(std::ranges::range_reference_t<const R> pair) {
+    static_cast<T>(std::get<0>(pair));
+    static_cast<ET>(std::get<1>(pair));
+  };
+
+// number of distinct primes a T can have
+template<typename T> inline constexpr std::size_t max_distinct_primes = factorization_detail::max_distinct_primes<T>();
+
+static_assert(max_distinct_primes<std::uint64_t> == 15 && max_distinct_primes<std::int64_t> == 15);
+static_assert(max_distinct_primes<std::uint32_t> == 9 && max_distinct_primes<std::int8_t> == 3);
+
+class FactorizationCapacityException : public std::exception
+{
+public:
+  virtual const char *what() const noexcept override
+  {
+    return "factorization has more distinct primes than it has room for";
+  }
+};
+
+// fixed capacity factorization stored in place, primes and exponents in separate arrays
+// copying it never allocates, so it's the one to use in hot loops and in `Lazy`
+// iterating gives `std::pair<T, ET>` by value, same structured bindings as `Factorization`
+template<typename T, typename ET = ExponentType, std::size_t Capacity = max_distinct_primes<T>>
+class InlineFactorization
+{
+private:
+  std::array<T, Capacity> m_primes{};
+  std::array<ET, Capacity> m_exponents{};
+  std::size_t m_size = 0;
+
+public:
+  constexpr InlineFactorization() = default;
+
+  // from anything that iterates as (prime, exponent) pairs, e.g. a `Factorization`
+  template<FactorPairRange<T, ET> R>
+    requires(!std::is_same_v<std::remove_cvref_t<R>, InlineFactorization>)
+  constexpr explicit InlineFactorization(const R &pairs)
+  {
+    for (const auto &[p, e] : pairs) push_back(static_cast<T>(p), static_cast<ET>(e));
+  }
+
+  static constexpr std::size_t capacity() { return Capacity; }
+  constexpr std::size_t size() const { return m_size; }
+  constexpr bool empty() const { return m_size == 0; }
+
+  constexpr const T &prime(std::size_t i) const { return m_primes[i]; }
+  constexpr ET &exponent(std::size_t i) { return m_exponents[i]; }
+  constexpr const ET &exponent(std::size_t i) const { return m_exponents[i]; }
+
+  constexpr std::span<const T> primes() const { return { m_primes.data(), m_size }; }
+  constexpr std::span<const ET> exponents() const { return { m_exponents.data(), m_size }; }
+
+  constexpr void push_back(const T &p, ET e)
+  {
+    if (m_size == Capacity) throw FactorizationCapacityException{};
+    m_primes[m_size] = p;
+    m_exponents[m_size] = e;
+    ++m_size;
+  }
+
+  constexpr void clear() { m_size = 0; }
+
+  class Iterator
+  {
+  private:
+    const InlineFactorization *m_parent = nullptr;
+    std::size_t m_index = 0;
+
+  public:
+    using value_type = std::pair<T, ET>;
+    using difference_type = std::ptrdiff_t;
+
+    constexpr Iterator() = default;
+    constexpr Iterator(const InlineFactorization *parent, std::size_t index) : m_parent(parent), m_index(index) {}
+
+    constexpr value_type operator*() const { return { m_parent->m_primes[m_index], m_parent->m_exponents[m_index] }; }
+
+    constexpr Iterator &operator++()
+    {
+      ++m_index;
+      return *this;
+    }
+
+    constexpr Iterator operator++(int)
+    {
+      auto out = *this;
+      ++m_index;
+      return out;
+    }
+
+    friend constexpr bool operator==(const Iterator &left, const Iterator &right)
+    {
+      return left.m_index == right.m_index;
+    }
+  };
+
+  constexpr Iterator begin() const { return { this, 0 }; }
+  constexpr Iterator end() const { return { this, m_size }; }
+
+  friend constexpr bool operator==(const InlineFactorization &left, const InlineFactorization &right)
+  {
+    if (left.m_size != right.m_size) return false;
+    for (std::size_t i = 0; i < left.m_size; ++i) {
+      if (left.m_primes[i] != right.m_primes[i] || left.m_exponents[i] != right.m_exponents[i]) return false;
+    }
+    return true;
+  }
+};
+
+static_assert(std::forward_iterator<InlineFactorization<std::uint64_t>::Iterator>);
+static_assert(std::constructible_from<InlineFactorization<int>, FactorizationView<int>>);
+static_assert(!std::constructible_from<InlineFactorization<int>, std::vector<int>>);
+
+// the inline one wherever the capacity is known, the vector otherwise (bignums and such)
+template<typename T, typename ET = ExponentType> struct DefaultFactorizationImpl
+{
+  using type = Factorization<T, ET>;
+};
+
+template<typename T, typename ET>
+  requires(std::numeric_limits<T>::is_specialized && std::numeric_limits<T>::is_integer
+           && std::numeric_limits<T>::digits <= 128)
+struct DefaultFactorizationImpl<T, ET>
+{
+  using type = InlineFactorization<T, ET>;
+};
+
+template<typename T, typename ET = ExponentType>
+using DefaultFactorization = typename DefaultFactorizationImpl<T, ET>::type;
+
+// everything below (and in the other headers) reads and builds factorizations through these
+// `Factorization` and `FactorizationView` keep pairs next to each other, `InlineFactorization` doesn't
+template<typename F>
+  requires requires(F &f) { f[0].first; }
+constexpr std::size_t factorization_size(const F &f)
+{
+  return std::size(f);
+}
+
+template<typename F>
+  requires requires(F &f) { f[0].first; }
+constexpr decltype(auto) prime_at(F &&f, std::size_t i)
+{
+  return (f[i].first);
+}
+
+template<typename F>
+  requires requires(F &f) { f[0].second; }
+constexpr decltype(auto) exponent_at(F &&f, std::size_t i)
+{
+  return (f[i].second);
+}
+
+template<typename T, typename ET> constexpr void append_factor(Factorization<T, ET> &f, const T &p, ET e)
+{
+  f.emplace_back(p, e);
+}
+
+template<typename T, typename ET, std::size_t C>
+constexpr std::size_t factorization_size(const InlineFactorization<T, ET, C> &f)
+{
+  return f.size();
+}
+
+template<typename T, typename ET, std::size_t C>
+constexpr const T &prime_at(const InlineFactorization<T, ET, C> &f, std::size_t i)
+{
+  return f.prime(i);
+}
+
+template<typename T, typename ET, std::size_t C>
+constexpr ET &exponent_at(InlineFactorization<T, ET, C> &f, std::size_t i)
+{
+  return f.exponent(i);
+}
+
+template<typename T, typename ET, std::size_t C>
+constexpr const ET &exponent_at(const InlineFactorization<T, ET, C> &f, std::size_t i)
+{
+  return f.exponent(i);
+}
+
+template<typename T, typename ET, std::size_t C>
+constexpr void append_factor(InlineFactorization<T, ET, C> &f, const T &p, ET e)
+{
+  f.push_back(p, e);
+}
+
+template<typename F> concept FactorizationLike = requires(const F &f) {
+  factorization_size(f);
+  prime_at(f, 0);
+  exponent_at(f, 0);
+};
+
+static_assert(FactorizationLike<Factorization<int>> && FactorizationLike<FactorizationView<int>>);
+static_assert(FactorizationLike<InlineFactorization<int>> && !FactorizationLike<std::vector<int>>);
+
+// one that results can be built in, starting empty and growing by `append_factor`
+// (a `FactorizationView` is read only, it can be an argument but never a result)
+template<typename F> concept BuildableFactorization =
+  FactorizationLike<F> && std::default_initializable<F> && requires(F &out, const F &f) {
+    append_factor(out, prime_at(f, 0), exponent_at(f, 0));
+    exponent_at(out, 0) += exponent_at(f, 0);
+  };
+
+static_assert(BuildableFactorization<Factorization<int>> && BuildableFactorization<InlineFactorization<int>>);
+static_assert(!BuildableFactorization<FactorizationView<int>>);
+
 class ZeroFactorizationException : public std::exception
 {
 public:
   virtual const char *what() const noexcept override { return "tried to factorize 0 (zero)"; }
 };
 
-template<typename T, typename ET = ExponentType> constexpr Factorization<T, ET> factorize(T n)
+namespace factorization_detail {
+
+  // `cofactor` is what trial division couldn't split, only builtin integers report it
+  template<typename T> constexpr void instrument_trial_division(std::uint64_t trials, const T &cofactor)
+  {
+    instrument::add(instrument::Counter::factorizations);
+    instrument::add(instrument::Counter::trial_divisions, trials);
+    if constexpr (std::is_integral_v<T>) {
+      const auto value = sizeof(T) > sizeof(std::uint64_t) && cofactor > T(~std::uint64_t{ 0 })
+                           ? ~std::uint64_t{ 0 }
+                           : static_cast<std::uint64_t>(cofactor);
+      instrument::record_max(instrument::Max::cofactor, value);
+      instrument::observe(instrument::Histogram::cofactor_bits, value);
+    }
+  }
+
+  // builtin integers that fit in 64 bits get the tables
+  template<typename T> inline constexpr bool small_tabled = std::is_integral_v<T> && sizeof(T) <= sizeof(std::uint64_t);
+
+  // n < `small_table_bound`, one smallest prime factor lookup per prime factor
+  template<typename T, typename ET, typename F> constexpr void factorize_small(std::uint32_t n, F &factorization)
+  {
+    while (n != 1) {
+      const std::uint32_t p = small_tables.spf[n];
+      ET e = 0;
+      do {
+        n /= p;
+        ++e;
+      } while (n % p == 0);
+      append_factor(factorization, static_cast<T>(p), e);
+    }
+  }
+
+  // the first odd primes go one at a time, that's all smooth numbers need and there is nothing to set up
+  inline constexpr std::size_t scalar_trial_primes = std::min<std::size_t>(32, DivisibilityPrimes::size());
+
+  // divides out the odd primes of the table, returns whether that left 1 or a prime
+  // (a quotient by p is a multiplication by its inverse, once p is known to divide)
+  // past `scalar_trial_primes` the primes up to sqrt(n) are tested a vector at a time (simd-divisibility.hpp),
+  // the trials counted are the same either way
+  template<typename T, typename ET, typename F>
+  constexpr bool trial_divide_small(std::uint64_t &n, F &factorization, std::uint64_t &trials)
+  {
+    const auto *primes = small_divisibility_primes.begin();
+    const auto divide_out = [&](const DivisibilityPrime &d) {
+      ET e = 0;
+      do {
+        n *= d.inverse;
+        ++e;
+      } while (d.divides(n));
+      append_factor(factorization, static_cast<T>(d.p), e);
+    };
+    for (std::size_t i = 0; i < scalar_trial_primes; ++i) {
+      if (std::uint64_t{ primes[i].p } * primes[i].p > n) return true;
+      ++trials;
+      if (primes[i].divides(n)) divide_out(primes[i]);
+    }
+    for (std::size_t i = scalar_trial_primes;;) {
+      // the first prime past sqrt(n)
+      const std::size_t stop = static_cast<std::size_t>(
+        std::partition_point(primes + i, small_divisibility_primes.end(), [&](const DivisibilityPrime &d) {
+          return std::uint64_t{ d.p } * d.p <= n;
+        })
+        - primes);
+      const std::size_t k = first_divisor(n, i, stop);
+      trials += k - i;
+      if (k == stop) return stop < DivisibilityPrimes::size();
+      ++trials;
+      divide_out(primes[k]);
+      i = k + 1;
+    }
+  }
+
+}// namespace factorization_detail
+
+// `F` is `Factorization<T, ET>` or `InlineFactorization<T, ET>` (or anything with `append_factor`)
+template<typename T, typename ET = ExponentType, typename F = Factorization<T, ET>> constexpr F factorize(T n)
 {
   if (n < T{ 0 }) n = -n;
   // this could be moved into a contract if those existed in C++
   if (n == T{ 0 }) throw ZeroFactorizationException{};
-  Factorization<T, ET> factorization;
-  for (T p{ 2 }; p * p <= n; ++p) {
+  F factorization;
+  if constexpr (factorization_detail::small_tabled<T>) {
+    if (static_cast<std::uint64_t>(n) < small_table_bound) {
+      factorization_detail::factorize_small<T, ET>(static_cast<std::uint32_t>(n), factorization);
+      factorization_detail::instrument_trial_division(0, T{ 1 });
+      return factorization;
+    }
+  }
+  const auto trial_divide = [&](const T &p) {
     if (n % p == T{ 0 }) {
-      factorization.emplace_back(p, 0);
+      ET e = 0;
       while (n % p == T{ 0 }) {
         n /= p;
-        ++factorization.back().second;
+        ++e;
       }
+      append_factor(factorization, p, e);
     }
+  };
+  trial_divide(T{ 2 });
+  std::uint64_t trials = 1;
+  // where the wheel starts, past whatever the table took care of
+  std::uint64_t start = 7;
+  bool done = false;
+  if constexpr (factorization_detail::small_tabled<T>) {
+    auto m = static_cast<std::uint64_t>(n);
+    done = factorization_detail::trial_divide_small<T, ET>(m, factorization, trials);
+    n = static_cast<T>(m);
+    start = small_divisibility_primes.primes[small_divisibility_primes.size() - 1].p + 2;
+    while (wheel30::index[start % 30] == 8) ++start;
+  } else {
+    trial_divide(T{ 3 });
+    trial_divide(T{ 5 });
+    trials += 2;
   }
-  if (n != T{ 1 }) { factorization.emplace_back(n, 1); }
+  // same mod 30 wheel as the prime sieve, skips 11 out of every 15 candidates
+  std::size_t i = wheel30::index[start % 30];
+  for (T p(start); !done && p * p <= n; p += T(wheel30::gaps[i]), i = (i + 1) % wheel30::gaps.size(), ++trials) {
+    trial_divide(p);
+  }
+  factorization_detail::instrument_trial_division(trials, n);
+  if (n != T{ 1 }) { append_factor(factorization, n, ET{ 1 }); }
   return factorization;
 }
 
@@ -55,40 +416,106 @@ constexpr const Factorization<T, ET> &factorize(const Factorization<T, ET> &f)
   return f;
 }
 
+template<typename T, typename ET> constexpr FactorizationView<T, ET> factorize(FactorizationView<T, ET> f) { return f; }
+
+template<typename T, typename ET, std::size_t C>
+constexpr const InlineFactorization<T, ET, C> &factorize(const InlineFactorization<T, ET, C> &f)
+{
+  return f;
+}
+
+// the table primes (2 included) divided out of many values at once, `on_factor(i, p, e)` for every p^e divided out
+// of values[i], in increasing p for each i, and values[i] is left with the rest, which is 1, a prime
+// (that may itself be in the table, a value stops being tested once it is below p^2), or has no prime factor
+// in the table
+// the other way around from `factorize`: every prime is tested against a vector of values per instruction,
+// values leave (every 16 primes) once the primes are past their square root
+template<typename OnFactor>
+void strip_small_factors(std::span<std::uint64_t> values, OnFactor &&on_factor, SimdLevel level = simd_level)
+{
+  std::vector<std::uint64_t> active;
+  std::vector<std::size_t> index;// active[j] is what's left of values[index[j]]
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    if (values[i] == 0) throw ZeroFactorizationException{};
+    if (values[i] % 2 == 0) {
+      const auto e = static_cast<ExponentType>(std::countr_zero(values[i]));
+      values[i] >>= e;
+      on_factor(i, std::uint64_t{ 2 }, e);
+    }
+    if (values[i] >= 9) {
+      active.push_back(values[i]);
+      index.push_back(i);
+    }
+  }
+  std::uint64_t trials = 0;
+  for (std::size_t k = 0; k < DivisibilityPrimes::size() && !active.empty(); ++k) {
+    const auto &d = small_divisibility_primes.primes[k];
+    if (k % 16 == 0) {
+      std::size_t kept = 0;
+      for (std::size_t j = 0; j < active.size(); ++j) {
+        if (std::uint64_t{ d.p } * d.p > active[j]) {
+          values[index[j]] = active[j];
+          continue;
+        }
+        active[kept] = active[j];
+        index[kept++] = index[j];
+      }
+      active.resize(kept);
+      index.resize(kept);
+    }
+    trials += active.size();
+    for (std::size_t b = 0; b < active.size(); b += 64) {
+      auto mask = divisible_mask(active.data() + b, std::min<std::size_t>(64, active.size() - b), k, level);
+      for (; mask != 0; mask &= mask - 1) {
+        const std::size_t j = b + static_cast<std::size_t>(std::countr_zero(mask));
+        std::uint64_t &n = active[j];
+        ExponentType e = 0;
+        do {
+          n *= d.inverse;
+          ++e;
+        } while (d.divides(n));
+        on_factor(index[j], std::uint64_t{ d.p }, e);
+      }
+    }
+  }
+  for (std::size_t j = 0; j < active.size(); ++j) values[index[j]] = active[j];
+  instrument::add(instrument::Counter::trial_divisions, trials);
+}
+
 static_assert(factorize<int, std::uint32_t>(2100)
               == std::vector<std::pair<int, std::uint32_t>>{ { 2, 2 }, { 3, 1 }, { 5, 2 }, { 7, 1 } });
+static_assert(factorize<int, std::uint32_t, InlineFactorization<int>>(2100)
+              == InlineFactorization<int>{ Factorization<int>{ { 2, 2 }, { 3, 1 }, { 5, 2 }, { 7, 1 } } });
 
 // for now not mixing factorizations of different types,
 // seems like the safer choice a priori
-template<typename T>
-constexpr Factorization<T> merge_factorizations(const Factorization<T> &left, const Factorization<T> &right)
-{
-  Factorization<T> out;
-  auto it_left = left.begin();
-  auto it_right = right.begin();
-  while (it_left != left.end() && it_right != right.end()) {
-    if (it_left->first < it_right->first) {
-      out.push_back(*it_left);
-      ++it_left;
-    } else if (it_left->first > it_right->first) {
-      out.push_back(*it_right);
-      ++it_right;
+template<BuildableFactorization F> constexpr F merge_factorizations(const F &left, const F &right)
+{
+  instrument::add(instrument::Counter::merges);
+  F out;
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i < factorization_size(left) && j < factorization_size(right)) {
+    if (prime_at(left, i) < prime_at(right, j)) {
+      append_factor(out, prime_at(left, i), exponent_at(left, i));
+      ++i;
+    } else if (prime_at(right, j) < prime_at(left, i)) {
+      append_factor(out, prime_at(right, j), exponent_at(right, j));
+      ++j;
     } else {// ==
-      out.emplace_back({ it_left->first, it_left->second + it_right->second });
-      ++it_left;
-      ++it_right;
+      append_factor(out, prime_at(left, i), exponent_at(left, i) + exponent_at(right, j));
+      ++i;
+      ++j;
     }
   }
-  while (it_left != left.end()) {
-    out.push_back(*it_left);
-    ++it_left;
-  }
-  while (it_right != right.end()) {
-    out.push_back(*it_right);
-    ++it_right;
-  }
+  for (; i < factorization_size(left); ++i) append_factor(out, prime_at(left, i), exponent_at(left, i));
+  for (; j < factorization_size(right); ++j) append_factor(out, prime_at(right, j), exponent_at(right, j));
   return out;
 }
 
+static_assert(merge_factorizations(factorize(12), factorize(90)) == factorize(1080));
+static_assert(merge_factorizations(factorize<int, ExponentType, InlineFactorization<int>>(12),
+                factorize<int, ExponentType, InlineFactorization<int>>(35))
+              == factorize<int, ExponentType, InlineFactorization<int>>(420));
 
 }// namespace ivl::nt
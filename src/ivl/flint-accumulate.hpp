@@ -0,0 +1,251 @@
+#pragma once
+
+// flint integers without the temporaries
+// every `*` and `+` of `flint::fmpzxx` that flintxx can't fuse materializes a heap allocated temporary,
+// c = c * a + a * c + b makes two of them per evaluation, each with limbs of its own
+// `FmpzAccumulator` writes every step straight into one integer, fused where flint can (addmul, submul):
+//   FmpzAccumulator{}.addmul(c, a).addmul(a, c).add(b).store(c);
+// that integer is borrowed from a per thread pool (`FmpzScratch`), pooled integers keep their limbs,
+// so a loop like the one above stops allocating once its sizes stop growing
+// `pow`, `powsum` and `id` from multi-fns.hpp go through `InPlaceArithmetic<flint::fmpzxx>`, defined here,
+// multi-fns.hpp includes this header whenever flint is there, so every TU sees the same specialization
+// `fmpz_allocations()` counts what flint and gmp allocate, for the benchmarks
+
+#include <flint/flint.h>
+#include <flint/fmpz.h>
+#include <flint/fmpzxx.h>
+#include <gmp.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace ivl::nt {
+
+// defined in multi-fns.hpp, which includes this header before it uses the specialization below
+template<typename T> struct InPlaceArithmetic;
+
+namespace flint_detail {
+
+  // more than any nesting this library does, what doesn't fit is freed
+  inline constexpr std::size_t scratch_pool_size = 16;
+
+  inline std::vector<flint::fmpzxx> &scratch_pool()
+  {
+    thread_local std::vector<flint::fmpzxx> pool = [] {
+      std::vector<flint::fmpzxx> out;
+      out.reserve(scratch_pool_size);
+      return out;
+    }();
+    return pool;
+  }
+
+  inline std::atomic<std::uint64_t> allocations{ 0 };
+
+  // the functions the counting ones forward to
+  inline void *(*flint_alloc)(std::size_t) = nullptr;
+  inline void *(*flint_calloc)(std::size_t, std::size_t) = nullptr;
+  inline void *(*flint_realloc)(void *, std::size_t) = nullptr;
+  inline void (*flint_free)(void *) = nullptr;
+  inline void *(*gmp_alloc)(std::size_t) = nullptr;
+  inline void *(*gmp_realloc)(void *, std::size_t, std::size_t) = nullptr;
+  inline void (*gmp_free)(void *, std::size_t) = nullptr;
+
+  inline void count() { allocations.fetch_add(1, std::memory_order_relaxed); }
+
+  // a realloc counts as an allocation, growing limbs is what it is used for
+  inline void install_counters()
+  {
+    __flint_get_memory_functions(&flint_alloc, &flint_calloc, &flint_realloc, &flint_free);
+    __flint_set_memory_functions(
+      [](std::size_t n) -> void * {
+        count();
+        return flint_alloc(n);
+      },
+      [](std::size_t n, std::size_t size) -> void * {
+        count();
+        return flint_calloc(n, size);
+      },
+      [](void *p, std::size_t n) -> void * {
+        count();
+        return flint_realloc(p, n);
+      },
+      [](void *p) { flint_free(p); });
+    mp_get_memory_functions(&gmp_alloc, &gmp_realloc, &gmp_free);
+    mp_set_memory_functions(
+      [](std::size_t n) -> void * {
+        count();
+        return gmp_alloc(n);
+      },
+      [](void *p, std::size_t old_size, std::size_t n) -> void * {
+        count();
+        return gmp_realloc(p, old_size, n);
+      },
+      [](void *p, std::size_t n) { gmp_free(p, n); });
+  }
+
+}// namespace flint_detail
+
+// allocations by flint and gmp (limbs included) since the first call, process wide
+// the first call swaps in counting memory functions, which forward to the ones that were there,
+// so memory allocated before it is freed correctly; make it before other threads use flint
+inline std::uint64_t fmpz_allocations()
+{
+  static std::once_flag installed;
+  std::call_once(installed, flint_detail::install_counters);
+  return flint_detail::allocations.load(std::memory_order_relaxed);
+}
+
+// an integer borrowed from the calling thread's pool, holding whatever its last user left in it
+// it goes back (limbs and all) when the scratch is destroyed
+class FmpzScratch
+{
+private:
+  flint::fmpzxx m_value;
+
+public:
+  FmpzScratch()
+  {
+    auto &pool = flint_detail::scratch_pool();
+    if (!pool.empty()) {
+      fmpz_swap(m_value._fmpz(), pool.back()._fmpz());
+      pool.pop_back();
+    }
+  }
+  FmpzScratch(const FmpzScratch &) = delete;
+  FmpzScratch &operator=(const FmpzScratch &) = delete;
+  ~FmpzScratch()
+  {
+    auto &pool = flint_detail::scratch_pool();
+    if (pool.size() == flint_detail::scratch_pool_size) return;
+    pool.emplace_back();
+    fmpz_swap(pool.back()._fmpz(), m_value._fmpz());
+  }
+
+  flint::fmpzxx &get() { return m_value; }
+  fmpz *operator*() { return m_value._fmpz(); }
+};
+
+// a sum of terms built in place, starts at 0
+// flint allows the target to be an operand, the accumulator never is one of its own arguments anyway
+class FmpzAccumulator
+{
+private:
+  FmpzScratch m_scratch;
+  bool m_zero = true;// nothing written yet, the scratch still holds its previous value
+
+  // the first term is written instead of added, that's what keeps the pooled limbs
+  template<typename Set, typename Update> FmpzAccumulator &apply(Set &&set, Update &&update)
+  {
+    if (m_zero) {
+      set(*m_scratch);
+    } else {
+      update(*m_scratch);
+    }
+    m_zero = false;
+    return *this;
+  }
+
+public:
+  FmpzAccumulator &add(const flint::fmpzxx &a)
+  {
+    return apply([&](fmpz *v) { fmpz_set(v, a._fmpz()); }, [&](fmpz *v) { fmpz_add(v, v, a._fmpz()); });
+  }
+  FmpzAccumulator &add(std::uint64_t a)
+  {
+    return apply([&](fmpz *v) { fmpz_set_ui(v, a); }, [&](fmpz *v) { fmpz_add_ui(v, v, a); });
+  }
+  FmpzAccumulator &sub(const flint::fmpzxx &a)
+  {
+    return apply([&](fmpz *v) { fmpz_neg(v, a._fmpz()); }, [&](fmpz *v) { fmpz_sub(v, v, a._fmpz()); });
+  }
+  FmpzAccumulator &sub(std::uint64_t a)
+  {
+    return apply(
+      [&](fmpz *v) {
+        fmpz_set_ui(v, a);
+        fmpz_neg(v, v);
+      },
+      [&](fmpz *v) { fmpz_sub_ui(v, v, a); });
+  }
+
+  // += a * b, one fused call
+  FmpzAccumulator &addmul(const flint::fmpzxx &a, const flint::fmpzxx &b)
+  {
+    return apply(
+      [&](fmpz *v) { fmpz_mul(v, a._fmpz(), b._fmpz()); }, [&](fmpz *v) { fmpz_addmul(v, a._fmpz(), b._fmpz()); });
+  }
+  FmpzAccumulator &submul(const flint::fmpzxx &a, const flint::fmpzxx &b)
+  {
+    return apply(
+      [&](fmpz *v) {
+        fmpz_mul(v, a._fmpz(), b._fmpz());
+        fmpz_neg(v, v);
+      },
+      [&](fmpz *v) { fmpz_submul(v, a._fmpz(), b._fmpz()); });
+  }
+
+  // *= a, the whole sum so far
+  FmpzAccumulator &mul(const flint::fmpzxx &a)
+  {
+    if (!m_zero) fmpz_mul(*m_scratch, *m_scratch, a._fmpz());
+    return *this;
+  }
+  FmpzAccumulator &mul(std::uint64_t a)
+  {
+    if (!m_zero) fmpz_mul_ui(*m_scratch, *m_scratch, a);
+    return *this;
+  }
+
+  const flint::fmpzxx &value()
+  {
+    apply([](fmpz *v) { fmpz_zero(v); }, [](fmpz *) {});
+    return m_scratch.get();
+  }
+
+  // `out` takes the sum by a swap, its old value (limbs and all) ends up in the pool, the accumulator is 0 again
+  void store(flint::fmpzxx &out)
+  {
+    value();
+    fmpz_swap(out._fmpz(), *m_scratch);
+    m_zero = true;
+  }
+};
+
+template<> struct InPlaceArithmetic<flint::fmpzxx>
+{
+  static flint::fmpzxx pow(const flint::fmpzxx &n, std::uint64_t e)
+  {
+    flint::fmpzxx out;
+    fmpz_pow_ui(out._fmpz(), n._fmpz(), e);
+    return out;
+  }
+
+  // (n^(e+1) - 1) / (n - 1), one power and an exact division instead of e ever longer multiplications
+  static flint::fmpzxx powsum(const flint::fmpzxx &n, std::uint64_t e)
+  {
+    flint::fmpzxx out;
+    if (fmpz_is_one(n._fmpz())) {
+      fmpz_set_ui(out._fmpz(), e + 1);
+      return out;
+    }
+    FmpzScratch d;
+    fmpz_sub_ui(*d, n._fmpz(), 1);
+    fmpz_pow_ui(out._fmpz(), n._fmpz(), e + 1);
+    fmpz_sub_ui(out._fmpz(), out._fmpz(), 1);
+    fmpz_divexact(out._fmpz(), out._fmpz(), *d);
+    return out;
+  }
+
+  // out *= p^e
+  static void mul_pow(flint::fmpzxx &out, const flint::fmpzxx &p, std::uint64_t e)
+  {
+    FmpzScratch power;
+    fmpz_pow_ui(*power, p._fmpz(), e);
+    fmpz_mul(out._fmpz(), out._fmpz(), *power);
+  }
+};
+
+}// namespace ivl::nt
@@ -0,0 +1,331 @@
+#pragma once
+
+// factorization of flint bignums as a chain of stages, cheapest first
+// each stage works on the composite cofactors the previous ones left over, within its own effort limit:
+// * `TrialDivision`: divides out the primes up to `bound`
+// * `PerfectPower`: n = r^k becomes r, k times as often
+// * `PollardBrent`: flint's brent variant, `tries` starting points of `iterations` steps each
+// * `Ecm`: flint's elliptic curve method, `curves` curves with stage bounds `b1` and `b2`
+// * `FlintFactor`: `fmpz_factor`, never gives up (and can take forever)
+// cofactors that fit in 64 bits skip whatever is left of the chain and go to the native pollard-rho
+// anything still composite after the last stage is an `IncompleteFactorizationException`
+// the sign is dropped, like the builtin integer overloads do
+//
+// factorize(n, default_flint_chain), or a chain of your own, e.g. for inputs known to have no large factors
+// factorize(n, FlintStrategyChain{ flint_strategy::TrialDivision{ 1 << 20 }, flint_strategy::Ecm{ 50 } })
+
+#include <ivl/factorize.hpp>
+#include <ivl/instrument.hpp>
+#include <ivl/lazy.hpp>
+#include <ivl/pollard-rho.hpp>
+#include <ivl/primes.hpp>
+
+#include <flint/fmpz.h>
+#include <flint/fmpz_factor.h>
+#include <flint/fmpzxx.h>
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace ivl::nt {
+
+class IncompleteFactorizationException : public std::exception
+{
+public:
+  virtual const char *what() const noexcept override
+  {
+    return "every stage of the factorization chain gave up with a composite cofactor left";
+  }
+};
+
+namespace flint_detail {
+
+  // the largest trial division bound, its primes get sieved once
+  inline constexpr std::uint32_t max_trial_bound = 1 << 20;
+
+  inline const std::vector<std::uint32_t> &trial_primes()
+  {
+    static const std::vector<std::uint32_t> primes = [] {
+      std::vector<std::uint32_t> out{ 2, 3, 5 };
+      const auto rest = sieving_primes(std::uint64_t{ max_trial_bound } * max_trial_bound);
+      out.insert(out.end(), rest.begin(), rest.end());
+      return out;
+    }();
+    return primes;
+  }
+
+  inline flint::fmpzxx from_ui(std::uint64_t n)
+  {
+    flint::fmpzxx out;
+    fmpz_set_ui(out._fmpz(), n);
+    return out;
+  }
+
+  // 1 < d < n
+  inline bool nontrivial(const flint::fmpzxx &d, const flint::fmpzxx &n)
+  {
+    return fmpz_cmp_ui(d._fmpz(), 1) > 0 && fmpz_cmp(d._fmpz(), n._fmpz()) < 0;
+  }
+
+  class Random
+  {
+  private:
+    flint_rand_t m_state;
+
+  public:
+    Random() { flint_randinit(m_state); }
+    Random(const Random &) = delete;
+    Random &operator=(const Random &) = delete;
+    ~Random() { flint_randclear(m_state); }
+
+    flint_rand_t &state() { return m_state; }
+  };
+
+  // a composite that divides the input `multiplicity` times (at least)
+  struct Cofactor
+  {
+    flint::fmpzxx value;
+    std::uint64_t multiplicity;
+  };
+
+  // what a chain works on: the primes found so far (unsorted, possibly repeated) and the composites left
+  class Work
+  {
+  private:
+    std::vector<std::pair<flint::fmpzxx, std::uint64_t>> m_primes;
+    std::vector<Cofactor> m_composites;
+    Random m_random;
+
+  public:
+    void add_prime(flint::fmpzxx p, std::uint64_t multiplicity) { m_primes.emplace_back(std::move(p), multiplicity); }
+
+    // a composite that a stage couldn't do anything with
+    void keep(Cofactor c) { m_composites.push_back(std::move(c)); }
+
+    // sorts `n` into the primes or the composites, 64bit ones are factorized right away
+    void add(flint::fmpzxx n, std::uint64_t multiplicity)
+    {
+      if (fmpz_is_one(n._fmpz())) return;
+      if (fmpz_abs_fits_ui(n._fmpz())) {
+        for (auto [p, e] : factorize(std::uint64_t{ fmpz_get_ui(n._fmpz()) }, pollard_rho_strategy)) {
+          add_prime(from_ui(p), e * multiplicity);
+        }
+        return;
+      }
+      if (fmpz_is_probabprime(n._fmpz())) {
+        add_prime(std::move(n), multiplicity);
+      } else {
+        m_composites.push_back({ std::move(n), multiplicity });
+      }
+    }
+
+    bool done() const { return m_composites.empty(); }
+    std::vector<Cofactor> take_composites() { return std::exchange(m_composites, {}); }
+    flint_rand_t &random() { return m_random.state(); }
+
+    // `find(n)` is a nontrivial divisor of the composite `n`, or nothing once it runs out of effort,
+    // the two parts of a split go through `find` again until it fails on all of them
+    template<typename Find> void split(Find &&find)
+    {
+      auto todo = take_composites();
+      while (!todo.empty()) {
+        Cofactor c = std::move(todo.back());
+        todo.pop_back();
+        std::optional<flint::fmpzxx> d = find(c.value);
+        if (!d || !nontrivial(*d, c.value)) {
+          keep(std::move(c));
+          continue;
+        }
+        flint::fmpzxx rest;
+        fmpz_divexact(rest._fmpz(), c.value._fmpz(), d->_fmpz());
+        const std::size_t kept = m_composites.size();
+        add(std::move(*d), c.multiplicity);
+        add(std::move(rest), c.multiplicity);
+        for (std::size_t i = kept; i < m_composites.size(); ++i) todo.push_back(std::move(m_composites[i]));
+        m_composites.resize(kept);
+      }
+    }
+
+    // equal primes (from different cofactors) merged, increasing
+    template<typename T, typename ET, typename F> F result()
+    {
+      std::sort(m_primes.begin(), m_primes.end(),
+        [](const auto &a, const auto &b) { return fmpz_cmp(a.first._fmpz(), b.first._fmpz()) < 0; });
+      F out;
+      for (std::size_t i = 0, j = 0; i < m_primes.size(); i = j) {
+        std::uint64_t e = 0;
+        for (; j < m_primes.size() && fmpz_equal(m_primes[j].first._fmpz(), m_primes[i].first._fmpz()); ++j) {
+          e += m_primes[j].second;
+        }
+        append_factor(out, T{ m_primes[i].first }, static_cast<ET>(e));
+      }
+      return out;
+    }
+  };
+
+}// namespace flint_detail
+
+namespace flint_strategy {
+
+  // primes up to `bound` (at most 2^20)
+  struct TrialDivision
+  {
+    std::uint32_t bound = 1 << 16;
+
+    void apply(flint_detail::Work &work) const
+    {
+      std::uint64_t trials = 0;
+      for (auto &c : work.take_composites()) {
+        fmpz *n = c.value._fmpz();
+        for (std::uint32_t p : flint_detail::trial_primes()) {
+          // what's left is 1, a prime or small enough for the native engine
+          if (p > bound || fmpz_abs_fits_ui(n) || fmpz_cmp_ui(n, std::uint64_t{ p } * p) < 0) break;
+          ++trials;
+          if (fmpz_tdiv_ui(n, p) != 0) continue;
+          std::uint64_t e = 0;
+          do {
+            fmpz_divexact_ui(n, n, p);
+            ++e;
+          } while (fmpz_tdiv_ui(n, p) == 0);
+          work.add_prime(flint_detail::from_ui(p), e * c.multiplicity);
+        }
+        work.add(std::move(c.value), c.multiplicity);
+      }
+      instrument::add(instrument::Counter::trial_divisions, trials);
+    }
+  };
+
+  struct PerfectPower
+  {
+    void apply(flint_detail::Work &work) const
+    {
+      for (auto &c : work.take_composites()) {
+        flint::fmpzxx root;
+        int k = 0;
+        bool changed = false;
+        while ((k = fmpz_is_perfect_power(root._fmpz(), c.value._fmpz())) > 1) {
+          fmpz_swap(c.value._fmpz(), root._fmpz());
+          c.multiplicity *= static_cast<std::uint64_t>(k);
+          changed = true;
+        }
+        if (changed) {
+          work.add(std::move(c.value), c.multiplicity);
+        } else {
+          work.keep(std::move(c));
+        }
+      }
+    }
+  };
+
+  struct PollardBrent
+  {
+    std::uint64_t tries = 4;
+    std::uint64_t iterations = 1 << 16;
+
+    void apply(flint_detail::Work &work) const
+    {
+      work.split([&](const flint::fmpzxx &n) -> std::optional<flint::fmpzxx> {
+        if (fmpz_tdiv_ui(n._fmpz(), 2) == 0) return flint_detail::from_ui(2);
+        flint::fmpzxx d;
+        // flint only reads `n`, its signature just isn't const
+        if (!fmpz_factor_pollard_brent(d._fmpz(), work.random(), const_cast<fmpz *>(n._fmpz()), tries, iterations)) {
+          return std::nullopt;
+        }
+        return d;
+      });
+    }
+  };
+
+  // the defaults find most factors up to ~15 digits, (25, 2000, 200000) is the usual first ecm step
+  struct Ecm
+  {
+    std::uint64_t curves = 25;
+    std::uint64_t b1 = 2000;
+    std::uint64_t b2 = 200000;
+
+    void apply(flint_detail::Work &work) const
+    {
+      work.split([&](const flint::fmpzxx &n) -> std::optional<flint::fmpzxx> {
+        if (fmpz_tdiv_ui(n._fmpz(), 2) == 0) return flint_detail::from_ui(2);
+        flint::fmpzxx d;
+        if (!fmpz_factor_ecm(d._fmpz(), curves, b1, b2, work.random(), n._fmpz())) return std::nullopt;
+        return d;
+      });
+    }
+  };
+
+  struct FlintFactor
+  {
+    void apply(flint_detail::Work &work) const
+    {
+      for (auto &c : work.take_composites()) {
+        fmpz_factor_t factors;
+        fmpz_factor_init(factors);
+        fmpz_factor(factors, c.value._fmpz());
+        for (slong i = 0; i < factors->num; ++i) {
+          flint::fmpzxx p;
+          fmpz_set(p._fmpz(), factors->p + i);
+          work.add_prime(std::move(p), factors->exp[i] * c.multiplicity);
+        }
+        fmpz_factor_clear(factors);
+      }
+    }
+  };
+
+}// namespace flint_strategy
+
+template<typename S> concept FlintStrategyStage = requires(const S &stage, flint_detail::Work &work) {
+  stage.apply(work);
+};
+
+// the stages run in order, each only if the ones before it left something composite
+template<FlintStrategyStage... Stages> struct FlintStrategyChain
+{
+  std::tuple<Stages...> stages;
+
+  constexpr FlintStrategyChain(Stages... s) : stages(std::move(s)...) {}
+};
+
+// small factors plus one large cofactor is the common case, flint only sees what the rest couldn't do
+inline constexpr FlintStrategyChain default_flint_chain{ flint_strategy::TrialDivision{},
+  flint_strategy::PerfectPower{},
+  flint_strategy::PollardBrent{},
+  flint_strategy::Ecm{},
+  flint_strategy::FlintFactor{} };
+
+namespace flint_detail {
+
+  // the chain on whatever `work` was seeded with, parts of one input that are known already included
+  template<typename T, typename ET, typename F, typename... Stages>
+  F run_chain(Work &work, const FlintStrategyChain<Stages...> &chain)
+  {
+    std::apply([&](const auto &...stage) { (..., (work.done() ? void() : stage.apply(work))); }, chain.stages);
+    if (!work.done()) throw IncompleteFactorizationException{};
+    instrument::add(instrument::Counter::factorizations);
+    return work.result<T, ET, F>();
+  }
+
+}// namespace flint_detail
+
+template<typename T, typename ET = ExponentType, typename F = Factorization<T, ET>, typename... Stages>
+  requires std::same_as<T, flint::fmpzxx>
+F factorize(const T &n, const FlintStrategyChain<Stages...> &chain)
+{
+  if (fmpz_is_zero(n._fmpz())) throw ZeroFactorizationException{};
+  flint::fmpzxx m;
+  fmpz_abs(m._fmpz(), n._fmpz());
+  flint_detail::Work work;
+  work.add(std::move(m), 1);
+  return flint_detail::run_chain<T, ET, F>(work, chain);
+}
+
+// `Lazy<LazyFlintTraits>` factorizes through `default_flint_chain`
+using LazyFlintTraits = LazyStrategyTraits<flint::fmpzxx, default_flint_chain>;
+
+}// namespace ivl::nt
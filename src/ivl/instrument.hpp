@@ -0,0 +1,233 @@
+#pragma once
+
+// hot path counters, off unless IVL_NT_INSTRUMENT is defined (the same way in every translation unit)
+// disabled, every hook is an empty constexpr function and compiles to nothing
+// enabled, each thread bumps its own counters (relaxed atomics that only their thread writes, no contention),
+// `snapshot()` adds up every thread that ever counted, finished ones included
+// hooks never run during constant evaluation, so the static_assert tests stay untouched
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace ivl::nt::instrument {
+
+#ifdef IVL_NT_INSTRUMENT
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+enum class Counter : std::uint8_t {
+  factorizations,// `factorize` calls that did the work (any strategy)
+  trial_divisions,// candidates tried by trial division
+  rho_iterations,// steps of the pollard-rho walk
+  merges,// `merge_factorizations` calls
+  divisors_generated,// by `generate_all_divisors` and `DivisorIterable`
+  lazy_hits,// `Lazy::get_factorization` that found it ready
+  lazy_misses,// ... that had to factorize
+  cache_hits,// `FactorizationCache` lookups
+  cache_misses,
+  dirichlet_terms,// products summed by the dirichlet convolutions (divisor pairs, or prime powers when multiplicative)
+  count_
+};
+
+// largest value seen
+enum class Max : std::uint8_t {
+  cofactor,// what trial division left over, 1 if it finished the job
+  count_
+};
+
+// power of two buckets, bucket k counts values with bit width k
+enum class Histogram : std::uint8_t {
+  cofactor_bits,// bit width of what trial division left over
+  rho_iterations,// per pollard-rho factor search
+  count_
+};
+
+inline constexpr std::array<std::string_view, static_cast<std::size_t>(Counter::count_)> counter_names{
+  "factorizations",
+  "trial_divisions",
+  "rho_iterations",
+  "merges",
+  "divisors_generated",
+  "lazy_hits",
+  "lazy_misses",
+  "cache_hits",
+  "cache_misses",
+  "dirichlet_terms",
+};
+inline constexpr std::array<std::string_view, static_cast<std::size_t>(Max::count_)> max_names{ "cofactor" };
+inline constexpr std::array<std::string_view, static_cast<std::size_t>(Histogram::count_)> histogram_names{
+  "cofactor_bits",
+  "rho_iterations",
+};
+
+inline constexpr std::size_t histogram_buckets = 65;
+
+// plain numbers, what `snapshot()` returns
+struct Snapshot
+{
+  std::array<std::uint64_t, static_cast<std::size_t>(Counter::count_)> counters{};
+  std::array<std::uint64_t, static_cast<std::size_t>(Max::count_)> maxima{};
+  std::array<std::array<std::uint64_t, histogram_buckets>, static_cast<std::size_t>(Histogram::count_)> histograms{};
+
+  std::uint64_t operator[](Counter c) const { return counters[static_cast<std::size_t>(c)]; }
+  std::uint64_t operator[](Max m) const { return maxima[static_cast<std::size_t>(m)]; }
+  const std::array<std::uint64_t, histogram_buckets> &operator[](Histogram h) const
+  {
+    return histograms[static_cast<std::size_t>(h)];
+  }
+};
+
+namespace detail {
+
+  using Cell = std::atomic<std::uint64_t>;
+
+  // one per thread, written only by its thread
+  struct ThreadCounters
+  {
+    std::array<Cell, static_cast<std::size_t>(Counter::count_)> counters{};
+    std::array<Cell, static_cast<std::size_t>(Max::count_)> maxima{};
+    std::array<std::array<Cell, histogram_buckets>, static_cast<std::size_t>(Histogram::count_)> histograms{};
+  };
+
+  // owns the counters of every thread, they outlive their threads so nothing gets lost
+  struct Registry
+  {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadCounters>> threads;
+  };
+
+  inline Registry &registry()
+  {
+    static Registry r;
+    return r;
+  }
+
+  inline ThreadCounters &local()
+  {
+    thread_local ThreadCounters *counters = [] {
+      auto &r = registry();
+      std::lock_guard lock{ r.mutex };
+      return r.threads.emplace_back(std::make_unique<ThreadCounters>()).get();
+    }();
+    return *counters;
+  }
+
+  // only the owning thread writes, so a load and a store are enough, no locked instruction
+  inline void bump(Cell &cell, std::uint64_t n)
+  {
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+}// namespace detail
+
+constexpr void add(Counter c, std::uint64_t n = 1)
+{
+  if constexpr (enabled) {
+    if (!std::is_constant_evaluated()) detail::bump(detail::local().counters[static_cast<std::size_t>(c)], n);
+  }
+}
+
+constexpr void record_max(Max m, std::uint64_t value)
+{
+  if constexpr (enabled) {
+    if (!std::is_constant_evaluated()) {
+      auto &cell = detail::local().maxima[static_cast<std::size_t>(m)];
+      if (value > cell.load(std::memory_order_relaxed)) cell.store(value, std::memory_order_relaxed);
+    }
+  }
+}
+
+constexpr void observe(Histogram h, std::uint64_t value)
+{
+  if constexpr (enabled) {
+    if (!std::is_constant_evaluated()) {
+      detail::bump(detail::local().histograms[static_cast<std::size_t>(h)][std::bit_width(value)], 1);
+    }
+  }
+}
+
+// all threads added up, all zero when disabled
+inline Snapshot snapshot()
+{
+  Snapshot out;
+  if constexpr (enabled) {
+    auto &r = detail::registry();
+    std::lock_guard lock{ r.mutex };
+    for (const auto &t : r.threads) {
+      for (std::size_t i = 0; i < out.counters.size(); ++i) {
+        out.counters[i] += t->counters[i].load(std::memory_order_relaxed);
+      }
+      for (std::size_t i = 0; i < out.maxima.size(); ++i) {
+        out.maxima[i] = std::max(out.maxima[i], t->maxima[i].load(std::memory_order_relaxed));
+      }
+      for (std::size_t h = 0; h < out.histograms.size(); ++h) {
+        for (std::size_t b = 0; b < histogram_buckets; ++b) {
+          out.histograms[h][b] += t->histograms[h][b].load(std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+  return out;
+}
+
+// zeroes every thread's counters, racy against threads that are counting right now
+inline void reset()
+{
+  if constexpr (enabled) {
+    auto &r = detail::registry();
+    std::lock_guard lock{ r.mutex };
+    for (const auto &t : r.threads) {
+      for (auto &c : t->counters) c.store(0, std::memory_order_relaxed);
+      for (auto &c : t->maxima) c.store(0, std::memory_order_relaxed);
+      for (auto &h : t->histograms) {
+        for (auto &c : h) c.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+// one `name value` per line, histograms as `name[bits] count` for the nonempty buckets
+inline void dump_text(std::ostream &out, const Snapshot &s = snapshot())
+{
+  for (std::size_t i = 0; i < counter_names.size(); ++i) out << counter_names[i] << " " << s.counters[i] << "\n";
+  for (std::size_t i = 0; i < max_names.size(); ++i) out << "max_" << max_names[i] << " " << s.maxima[i] << "\n";
+  for (std::size_t h = 0; h < histogram_names.size(); ++h) {
+    for (std::size_t b = 0; b < histogram_buckets; ++b) {
+      if (s.histograms[h][b] != 0) out << histogram_names[h] << "[" << b << "] " << s.histograms[h][b] << "\n";
+    }
+  }
+}
+
+// {"counters": {...}, "max": {...}, "histograms": {"name": [65 buckets], ...}}
+inline void dump_json(std::ostream &out, const Snapshot &s = snapshot())
+{
+  out << "{\"enabled\": " << (enabled ? "true" : "false") << ", \"counters\": {";
+  for (std::size_t i = 0; i < counter_names.size(); ++i) {
+    out << (i ? ", " : "") << "\"" << counter_names[i] << "\": " << s.counters[i];
+  }
+  out << "}, \"max\": {";
+  for (std::size_t i = 0; i < max_names.size(); ++i) {
+    out << (i ? ", " : "") << "\"" << max_names[i] << "\": " << s.maxima[i];
+  }
+  out << "}, \"histograms\": {";
+  for (std::size_t h = 0; h < histogram_names.size(); ++h) {
+    out << (h ? ", " : "") << "\"" << histogram_names[h] << "\": [";
+    for (std::size_t b = 0; b < histogram_buckets; ++b) out << (b ? ", " : "") << s.histograms[h][b];
+    out << "]";
+  }
+  out << "}}";
+}
+
+}// namespace ivl::nt::instrument
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace ivl::nt {
+
+// `__extension__` keeps -pedantic quiet about the non-standard type
+__extension__ using int128_t = __int128;
+__extension__ using uint128_t = unsigned __int128;
+
+}// namespace ivl::nt
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <ivl/factorize.hpp>
+#include <ivl/primes.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ivl::nt {
+
+namespace interval_detail {
+
+  // elements per segment, the cofactors (8 bytes each) stay in L2
+  inline constexpr std::uint64_t segment_length = 1 << 15;
+
+  // every prime <= sqrt(hi), 2, 3 and 5 included
+  inline std::vector<std::uint32_t> trial_primes(std::uint64_t hi)
+  {
+    std::vector<std::uint32_t> out;
+    for (std::uint32_t p : { 2, 3, 5 }) {
+      if (std::uint64_t{ p } * p <= hi) out.push_back(p);
+    }
+    const auto rest = sieving_primes(hi);
+    out.insert(out.end(), rest.begin(), rest.end());
+    return out;
+  }
+
+  // walks consecutive segments of one block, keeping the next multiple of every p and p^2
+  // instead of recomputing them with divisions for every segment
+  //
+  // instead of dividing the cofactors, the found prime powers are multiplied together
+  // and the single prime > sqrt(hi) that can be left over is found with one division at the end
+  template<typename T, typename ET> class SegmentFactorizer
+  {
+  private:
+    struct Entry
+    {
+      std::uint32_t index;
+      ET exponent;
+      T prime;
+    };
+
+    std::uint64_t m_hi;
+    std::span<const std::uint32_t> m_primes;
+    std::vector<std::uint64_t> m_next;// next multiple of primes[j]
+    std::vector<std::uint64_t> m_next_square;// next multiple of primes[j]^2
+
+    std::vector<std::uint64_t> m_products;
+    std::vector<std::uint32_t> m_last_entry;
+    std::vector<Entry> m_entries;
+    std::vector<std::uint32_t> m_counts;
+
+    static std::uint64_t first_multiple(std::uint64_t lo, std::uint64_t d) { return lo + (d - lo % d) % d; }
+
+  public:
+    SegmentFactorizer(std::uint64_t lo, std::uint64_t hi, std::span<const std::uint32_t> primes) : m_hi(hi)
+    {
+      for (std::uint64_t p : primes) {
+        if (p * p > hi) break;
+        m_next.push_back(first_multiple(lo, p));
+        m_next_square.push_back(first_multiple(lo, p * p));
+      }
+      m_primes = primes.first(m_next.size());
+    }
+
+    // appends the factorizations of [lo, hi] to `pairs`, `offsets` gets one entry per number, where it ends
+    // segments have to be consecutive, at most `segment_length` long
+    void next_segment(std::uint64_t lo,
+      std::uint64_t hi,
+      std::vector<std::pair<T, ET>> &pairs,
+      std::vector<std::size_t> &offsets)
+    {
+      if (lo == 0) throw ZeroFactorizationException{};
+      const auto length = static_cast<std::size_t>(hi - lo + 1);
+      m_products.assign(length, 1);
+      m_last_entry.resize(length);
+      m_entries.clear();
+
+      // primes come in increasing order, so does every number's list of entries
+      for (std::size_t j = 0; j < m_primes.size(); ++j) {
+        const std::uint64_t p = m_primes[j];
+        std::uint64_t x = m_next[j];
+        for (; x <= hi; x += p) {
+          const auto i = static_cast<std::size_t>(x - lo);
+          m_last_entry[i] = static_cast<std::uint32_t>(m_entries.size());
+          m_entries.push_back({ static_cast<std::uint32_t>(i), 1, static_cast<T>(p) });
+          m_products[i] *= p;
+        }
+        m_next[j] = x;
+
+        std::uint64_t pk = p * p;
+        x = m_next_square[j];
+        for (; x <= hi; x += pk) {
+          const auto i = static_cast<std::size_t>(x - lo);
+          ++m_entries[m_last_entry[i]].exponent;
+          m_products[i] *= p;
+        }
+        m_next_square[j] = x;
+
+        // p^3 and up are rare enough to just divide
+        while (pk <= m_hi / p) {
+          pk *= p;
+          for (x = first_multiple(lo, pk); x <= hi; x += pk) {
+            const auto i = static_cast<std::size_t>(x - lo);
+            ++m_entries[m_last_entry[i]].exponent;
+            m_products[i] *= p;
+          }
+        }
+      }
+      // at most one prime > sqrt(hi) is left over
+      for (std::size_t i = 0; i < length; ++i) {
+        const std::uint64_t cofactor = (lo + i) / m_products[i];
+        if (cofactor != 1) m_entries.push_back({ static_cast<std::uint32_t>(i), 1, static_cast<T>(cofactor) });
+      }
+
+      // stable counting sort by index
+      m_counts.assign(length + 1, 0);
+      for (const auto &entry : m_entries) ++m_counts[entry.index + 1];
+      const std::size_t base = pairs.size();
+      for (std::size_t i = 0; i < length; ++i) {
+        m_counts[i + 1] += m_counts[i];
+        offsets.push_back(base + m_counts[i + 1]);
+      }
+      pairs.resize(base + m_entries.size());
+      for (const auto &entry : m_entries) pairs[base + m_counts[entry.index]++] = { entry.prime, entry.exponent };
+    }
+  };
+
+  // [lo, hi] split into `threads` contiguous blocks, `per_block(block, lo, hi)` runs on its own thread
+  template<typename F> void parallel_blocks(std::uint64_t lo, std::uint64_t hi, std::uint32_t threads, F &&per_block)
+  {
+    const std::uint64_t block = (hi - lo) / threads + 1;
+    std::vector<std::jthread> pool;
+    for (std::uint32_t t = 1; t < threads; ++t) {
+      const std::uint64_t block_lo = lo + t * block;
+      if (block_lo > hi || block_lo < lo) break;
+      pool.emplace_back(per_block, t, block_lo, std::min(hi, block_lo + block - 1));
+    }
+    per_block(0, lo, std::min(hi, lo + block - 1));
+  }
+
+}// namespace interval_detail
+
+// factorizations of every n in [lo, hi], flattened into a single buffer
+// `(*this)[i]` is the factorization of lo + i
+template<typename T = std::uint64_t, typename ET = ExponentType> class IntervalFactorization
+{
+private:
+  std::uint64_t m_lo;
+  std::uint64_t m_hi;
+  std::vector<std::pair<T, ET>> m_pairs;
+  // factorization of lo + i is [m_offsets[i], m_offsets[i + 1])
+  std::vector<std::size_t> m_offsets;
+
+public:
+  IntervalFactorization(std::uint64_t lo,
+    std::uint64_t hi,
+    std::vector<std::pair<T, ET>> pairs,
+    std::vector<std::size_t> offsets)
+    : m_lo(lo), m_hi(hi), m_pairs(std::move(pairs)), m_offsets(std::move(offsets))
+  {}
+
+  std::uint64_t lo() const { return m_lo; }
+  std::uint64_t hi() const { return m_hi; }
+  std::size_t size() const { return m_offsets.size() - 1; }
+
+  FactorizationView<T, ET> operator[](std::size_t i) const
+  {
+    return { m_pairs.data() + m_offsets[i], m_pairs.data() + m_offsets[i + 1] };
+  }
+
+  // the whole buffer, e.g. for writing it out
+  std::span<const std::pair<T, ET>> pairs() const { return m_pairs; }
+  std::span<const std::size_t> offsets() const { return m_offsets; }
+};
+
+// factorizes every n in [lo, hi] by sieving with the primes up to sqrt(hi)
+// `lo` can't be 0, the whole range has to fit in memory (see `for_each_factorization` otherwise)
+template<typename T = std::uint64_t, typename ET = ExponentType>
+IntervalFactorization<T, ET> factorize_interval(std::uint64_t lo, std::uint64_t hi, std::uint32_t threads = 1)
+{
+  if (lo == 0) throw ZeroFactorizationException{};
+  std::vector<std::pair<T, ET>> pairs;
+  std::vector<std::size_t> offsets{ 0 };
+  if (lo > hi) return { lo, hi, std::move(pairs), std::move(offsets) };
+  const auto primes = interval_detail::trial_primes(hi);
+
+  struct Block
+  {
+    std::vector<std::pair<T, ET>> pairs;
+    std::vector<std::size_t> offsets;
+  };
+  const std::uint32_t block_count = std::max<std::uint32_t>(threads, 1);
+  std::vector<Block> blocks(block_count);
+  interval_detail::parallel_blocks(
+    lo, hi, block_count, [&](std::uint32_t b, std::uint64_t block_lo, std::uint64_t block_hi) {
+      interval_detail::SegmentFactorizer<T, ET> factorizer{ block_lo, hi, primes };
+      for (std::uint64_t seg_lo = block_lo; seg_lo <= block_hi; seg_lo += interval_detail::segment_length) {
+        const std::uint64_t seg_hi = std::min(block_hi, seg_lo + interval_detail::segment_length - 1);
+        factorizer.next_segment(seg_lo, seg_hi, blocks[b].pairs, blocks[b].offsets);
+        if (seg_hi == block_hi) break;
+      }
+    });
+
+  std::size_t total = 0;
+  for (const auto &block : blocks) total += block.pairs.size();
+  pairs.reserve(total);
+  offsets.reserve(hi - lo + 2);
+  for (auto &block : blocks) {
+    const std::size_t base = pairs.size();
+    pairs.insert(pairs.end(), block.pairs.begin(), block.pairs.end());
+    for (auto offset : block.offsets) offsets.push_back(base + offset);
+    block = {};
+  }
+  return { lo, hi, std::move(pairs), std::move(offsets) };
+}
+
+// calls `f(n, factorization)` for every n in [lo, hi], with a `FactorizationView<T, ET>`
+// that is only valid during the call, memory stays bounded by a segment per thread
+// with `threads > 1` the calls come from several threads at once,
+// each thread sees increasing n, but there is no global order
+template<typename T = std::uint64_t, typename ET = ExponentType, typename F>
+void for_each_factorization(std::uint64_t lo, std::uint64_t hi, F &&f, std::uint32_t threads = 1)
+{
+  if (lo == 0) throw ZeroFactorizationException{};
+  if (lo > hi) return;
+  const auto primes = interval_detail::trial_primes(hi);
+  interval_detail::parallel_blocks(
+    lo, hi, std::max<std::uint32_t>(threads, 1), [&](std::uint32_t, std::uint64_t block_lo, std::uint64_t block_hi) {
+      interval_detail::SegmentFactorizer<T, ET> factorizer{ block_lo, hi, primes };
+      std::vector<std::pair<T, ET>> pairs;
+      std::vector<std::size_t> offsets;
+      for (std::uint64_t seg_lo = block_lo; seg_lo <= block_hi; seg_lo += interval_detail::segment_length) {
+        const std::uint64_t seg_hi = std::min(block_hi, seg_lo + interval_detail::segment_length - 1);
+        pairs.clear();
+        offsets.clear();
+        factorizer.next_segment(seg_lo, seg_hi, pairs, offsets);
+        std::size_t begin = 0;
+        for (std::size_t i = 0; i < offsets.size(); ++i) {
+          f(seg_lo + i, FactorizationView<T, ET>{ pairs.data() + begin, pairs.data() + offsets[i] });
+          begin = offsets[i];
+        }
+        if (seg_hi == block_hi) break;
+      }
+    });
+}
+
+}// namespace ivl::nt
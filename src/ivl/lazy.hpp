@@ -1,91 +1,287 @@
 #pragma once
 
+#include <ivl/factorization-algebra.hpp>
+#include <ivl/factorization-cache.hpp>
 #include <ivl/factorize.hpp>
+#include <ivl/instrument.hpp>
 
+#include <atomic>
+#include <cstdint>
+#include <numeric>
 #include <optional>
+#include <ranges>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 namespace ivl::nt {
 
-// TODO: custom factorize strategy
 template<typename VT = std::int64_t> struct LazyDefaultTraits
 {
   using ValueType = VT;
   using ExponentType = std::uint32_t;
+  // inline for builtin integers, so copying a `Lazy` never allocates
+  using FactorizationType = DefaultFactorization<VT, ExponentType>;
 };
 
+// factorizes with `factorize(value, Strategy)` instead of the default trial division,
+// e.g. `LazyStrategyTraits<std::uint64_t, pollard_rho_strategy>`, or a chain from flint-factorize.hpp
+template<typename VT, const auto &Strategy> struct LazyStrategyTraits : LazyDefaultTraits<VT>
+{
+  static constexpr const auto &strategy = Strategy;
+};
+
+template<typename Traits> concept LazyHasStrategy = requires { Traits::strategy; };
+
+// same, but factorizations go through `shared_factorization_cache` first,
+// so equal values in different `Lazy`s (and threads) are factorized once
+template<typename VT = std::int64_t> struct LazySharedCacheTraits : LazyDefaultTraits<VT>
+{
+  static constexpr bool use_shared_cache = true;
+};
+
+template<typename Traits> concept LazyUsesSharedCache = requires { requires Traits::use_shared_cache; };
+
 // lazily factorizes and preserves the factorization
+// `get_factorization` can be called from several threads at once, one of them factorizes,
+// the others wait for it, everything that modifies the value is as thread safe as an `int`
+// `*`, `/`, `pow`, `gcd`, `lcm` and `product` of known factorizations compute the result's factorization
+// from theirs (factorization-algebra.hpp), `+` and `-` forget it
 template<typename Traits = LazyDefaultTraits<>> class Lazy
 {
 private:
   using ValueType = typename Traits::ValueType;
   using ExponentType = typename Traits::ExponentType;
-  using FactorizationType = Factorization<ValueType, ExponentType>;// std::vector<std::pair<ValueType,
-                                                                   // ExponentType>>;
+  using FactorizationType = typename Traits::FactorizationType;
+  static_assert(BuildableFactorization<FactorizationType>, "the arithmetic builds the factorizations of its results");
+
+  enum class State : std::uint8_t { empty, computing, ready };
 
   ValueType m_value;
   mutable std::optional<FactorizationType> m_factorization;
+  // `m_factorization` is only touched by whoever moved this from empty to computing
+  mutable std::atomic<State> m_state;
+
+  bool ready() const { return m_state.load(std::memory_order_acquire) == State::ready; }
+
+  // so that a `std::vector<Lazy>` moves on reallocation
+  static constexpr bool nothrow_move =
+    std::is_nothrow_move_constructible_v<ValueType> && std::is_nothrow_move_assignable_v<ValueType>
+    && std::is_nothrow_move_constructible_v<FactorizationType> && std::is_nothrow_move_assignable_v<FactorizationType>;
+
+  void reset()
+  {
+    m_factorization = std::nullopt;
+    m_state.store(State::empty, std::memory_order_relaxed);
+  }
+
+  FactorizationType compute() const
+  {
+    if constexpr (LazyUsesSharedCache<Traits>) {
+      return factorize(m_value, shared_factorization_cache<ValueType, FactorizationType>());
+    } else if constexpr (LazyHasStrategy<Traits>) {
+      using ::ivl::nt::factorize;
+      return factorize<ValueType, ExponentType, FactorizationType>(m_value, Traits::strategy);
+    } else {
+      // not needed atm, might be needed if i do some crazy refactoring
+      using ::ivl::nt::factorize;
+      return factorize<ValueType, ExponentType, FactorizationType>(m_value);
+    }
+  }
+
+  // a value whose factorization is known already
+  Lazy(ValueType value, FactorizationType factorization)
+      : m_value(std::move(value)), m_factorization(std::move(factorization)), m_state(State::ready)
+  {}
 
 public:
-  explicit constexpr Lazy(ValueType value) : m_value(value), m_factorization(std::nullopt) {}
+  explicit constexpr Lazy(ValueType value) : m_value(value), m_factorization(std::nullopt), m_state(State::empty) {}
+
+  Lazy(const Lazy &other) : m_value(other.m_value), m_factorization(std::nullopt), m_state(State::empty)
+  {
+    if (other.ready()) {
+      m_factorization = other.m_factorization;
+      m_state.store(State::ready, std::memory_order_relaxed);
+    }
+  }
+
+  Lazy &operator=(const Lazy &other)
+  {
+    if (this == &other) return *this;
+    m_value = other.m_value;
+    reset();
+    if (other.ready()) {
+      m_factorization = other.m_factorization;
+      m_state.store(State::ready, std::memory_order_relaxed);
+    }
+    return *this;
+  }
+
+  // takes the factorization along, `other` is left to factorize its (moved from) value again
+  Lazy(Lazy &&other) noexcept(nothrow_move)
+    : m_value(std::move(other.m_value)), m_factorization(std::nullopt), m_state(State::empty)
+  {
+    if (other.ready()) {
+      m_factorization = std::move(other.m_factorization);
+      m_state.store(State::ready, std::memory_order_relaxed);
+      other.reset();
+    }
+  }
+
+  Lazy &operator=(Lazy &&other) noexcept(nothrow_move)
+  {
+    if (this == &other) return *this;
+    m_value = std::move(other.m_value);
+    reset();
+    if (other.ready()) {
+      m_factorization = std::move(other.m_factorization);
+      m_state.store(State::ready, std::memory_order_relaxed);
+      other.reset();
+    }
+    return *this;
+  }
 
   const FactorizationType &get_factorization() const
   {
-    if (m_factorization) return *m_factorization;
-    // not needed atm, might be needed if i do some crazy refactoring
-    using ::ivl::nt::factorize;
-    m_factorization.emplace(factorize(m_value));
+    auto state = m_state.load(std::memory_order_acquire);
+    bool computed = false;
+    while (state != State::ready) {
+      if (state == State::computing) {
+        m_state.wait(State::computing, std::memory_order_acquire);
+        state = m_state.load(std::memory_order_acquire);
+        continue;
+      }
+      if (!m_state.compare_exchange_weak(state, State::computing, std::memory_order_acquire)) continue;
+      try {
+        m_factorization.emplace(compute());
+      } catch (...) {
+        // e.g. `ZeroFactorizationException`, the next caller tries again
+        m_state.store(State::empty, std::memory_order_release);
+        m_state.notify_all();
+        throw;
+      }
+      m_state.store(State::ready, std::memory_order_release);
+      m_state.notify_all();
+      computed = true;
+      break;
+    }
+    // waiting for another thread to finish counts as a hit
+    instrument::add(computed ? instrument::Counter::lazy_misses : instrument::Counter::lazy_hits);
     return *m_factorization;
   }
 
   Lazy &operator*=(const Lazy &arg)
   {
-    if (this->m_factorization && arg.m_factorization) {
-      this->m_factorization = merge_factorizations(this->m_factorization, arg.m_factorization);
+    if (this->ready() && arg.ready()) {
+      this->m_factorization = merge_factorizations(*this->m_factorization, *arg.m_factorization);
     } else {
-      this->m_factorization = std::nullopt;
+      this->reset();
     }
     this->m_value *= arg.m_value;
     return *this;
   }
 
-  // TODO: this copies a vector for potentially no reason
-  friend Lazy operator*(const Lazy &left, const Lazy &right)
+  // `left` by value, a temporary on the left (a * b * c) is reused instead of copied
+  friend Lazy operator*(Lazy left, const Lazy &right)
   {
-    Lazy out{ left };
-    out *= right;
-    return out;
+    left *= right;
+    return left;
   }
 
-  // no operator/ for now
+  // exact division, `FactorizationDivisionException` if `arg` doesn't divide this
+  // (seen on the factorizations when both are known, on the values otherwise),
+  // `ZeroFactorizationException` for a 0 divisor, like factorizing it would
+  Lazy &operator/=(const Lazy &arg)
+  {
+    if (arg.m_value == ValueType{ 0 }) throw ZeroFactorizationException{};
+    if (this->ready() && arg.ready()) {
+      if (!divides_factorization(*arg.m_factorization, *this->m_factorization)) throw FactorizationDivisionException{};
+      this->m_factorization = divide_factorizations(std::move(*this->m_factorization), *arg.m_factorization);
+    } else {
+      if (this->m_value % arg.m_value != ValueType{ 0 }) throw FactorizationDivisionException{};
+      this->reset();
+    }
+    this->m_value /= arg.m_value;
+    return *this;
+  }
+
+  friend Lazy operator/(Lazy left, const Lazy &right)
+  {
+    left /= right;
+    return left;
+  }
 
   Lazy &operator+=(const Lazy &arg)
   {
-    this->m_factorization = std::nullopt;
+    this->reset();
     this->m_value += arg.m_value;
     return *this;
   }
 
-  friend Lazy operator+(const Lazy &left, const Lazy &right)
+  friend Lazy operator+(Lazy left, const Lazy &right)
   {
-    Lazy out{ left };
-    out += right;
-    return out;
+    left += right;
+    return left;
   }
 
   Lazy &operator-=(const Lazy &arg)
   {
-    this->m_factorization = std::nullopt;
+    this->reset();
     this->m_value -= arg.m_value;
     return *this;
   }
 
-  friend Lazy operator-(const Lazy &left, const Lazy &right)
+  friend Lazy operator-(Lazy left, const Lazy &right)
+  {
+    left -= right;
+    return left;
+  }
+
+  // a member, `ivl::nt::pow` (multi-fns.hpp) is taken by a lambda
+  Lazy pow(std::uint64_t e) const
+  {
+    ValueType value{ 1 };
+    ValueType square = m_value;
+    for (auto k = e; k != 0; k /= 2) {
+      if (k % 2 == 1) value *= square;
+      if (k > 1) square *= square;
+    }
+    if (!ready()) return Lazy{ std::move(value) };
+    return Lazy{ std::move(value), pow_factorization(*m_factorization, e) };
+  }
+
+  // found by adl, the values go through `gcd` / `lcm` found the same way (`std::` ones for builtin integers)
+  friend Lazy gcd(const Lazy &left, const Lazy &right)
   {
-    Lazy out{ left };
-    out -= right;
-    return out;
+    using std::gcd;
+    ValueType value = gcd(left.m_value, right.m_value);
+    if (!left.ready() || !right.ready()) return Lazy{ std::move(value) };
+    return Lazy{ std::move(value), gcd_factorizations(*left.m_factorization, *right.m_factorization) };
+  }
+
+  friend Lazy lcm(const Lazy &left, const Lazy &right)
+  {
+    using std::lcm;
+    ValueType value = lcm(left.m_value, right.m_value);
+    if (!left.ready() || !right.ready()) return Lazy{ std::move(value) };
+    return Lazy{ std::move(value), lcm_factorizations(*left.m_factorization, *right.m_factorization) };
+  }
+
+  // the product of a whole range, when every factorization is known, one k-way merge instead of a chain of them
+  template<std::ranges::forward_range R>
+    requires std::same_as<std::ranges::range_value_t<R>, Lazy>
+  static Lazy product(const R &factors)
+  {
+    ValueType value{ 1 };
+    bool known = true;
+    for (const Lazy &f : factors) {
+      value *= f.m_value;
+      known = known && f.ready();
+    }
+    if (!known) return Lazy{ std::move(value) };
+    const auto factorizations = std::views::transform(
+      factors, [](const Lazy &f) -> const FactorizationType & { return *f.m_factorization; });
+    return Lazy{ std::move(value), multiply_factorizations(factorizations) };
   }
 
   ValueType get_value() const { return m_value; }
@@ -0,0 +1,72 @@
+#pragma once
+
+// read only mappings of whole files, defines IVL_NT_MMAP where there is mmap
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define IVL_NT_MMAP
+#endif
+
+#ifdef IVL_NT_MMAP
+
+namespace ivl::nt {
+
+// how the pages are going to be read, passed on to the kernel (read ahead or not)
+enum class MappedAccess { sequential, random };
+
+// read only private mapping of a whole file, `view()` is empty for empty files
+// clean pages of a private read only mapping come straight from the page cache,
+// every process mapping the same file shares them
+class MappedFile
+{
+private:
+  void *m_data = nullptr;
+  std::size_t m_size = 0;
+
+public:
+  // throws `std::system_error` when the file can't be opened or mapped (pipes and such)
+  explicit MappedFile(const std::string &path, MappedAccess access = MappedAccess::sequential)
+  {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::system_error{ errno, std::generic_category(), path };
+    struct stat info = {};
+    if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+      const int error = errno ? errno : EINVAL;
+      ::close(fd);
+      throw std::system_error{ error, std::generic_category(), path };
+    }
+    m_size = static_cast<std::size_t>(info.st_size);
+    if (m_size != 0) {
+      m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m_data == MAP_FAILED) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error{ error, std::generic_category(), path };
+      }
+      ::madvise(m_data, m_size, access == MappedAccess::sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+    ::close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile()
+  {
+    if (m_size != 0) ::munmap(m_data, m_size);
+  }
+
+  std::string_view view() const { return { static_cast<const char *>(m_data), m_size }; }
+};
+
+}// namespace ivl::nt
+
+#endif
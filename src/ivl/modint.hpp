@@ -0,0 +1,411 @@
+#pragma once
+
+// integers modulo n
+// a reducer does the arithmetic for one modulus, its values live in [0, n) in whatever form it likes:
+// * `Montgomery32` / `Montgomery64` for odd moduli, values in montgomery form
+// * `Barrett32` for any modulus below 2^32
+// * `Division64` for everything else (even moduli above 2^32), a hardware `%` on a 128bit product
+// `Modint<Modulus>` wraps a value and gets its reducer from `Modulus`,
+// `StaticModint<n>` picks the reducer at compile time, `DynamicModint<Tag>` takes the modulus at startup
+
+#include <ivl/int128.hpp>
+#include <ivl/simd.hpp>
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iosfwd>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace ivl::nt {
+
+class InvalidModulusException : public std::exception
+{
+  const char *what() const noexcept override { return "the reducer doesn't support this modulus"; }
+};
+
+class NotInvertibleException : public std::exception
+{
+  const char *what() const noexcept override { return "value is not coprime to the modulus"; }
+};
+
+namespace modint_detail {
+
+  // addition and subtraction are the same for every reducer
+  template<typename T> struct Modulus
+  {
+    T n;
+
+    constexpr T modulus() const { return n; }
+    constexpr T add(T a, T b) const { return a >= n - b ? a - (n - b) : a + b; }
+    constexpr T sub(T a, T b) const { return a >= b ? a - b : a + (n - b); }
+  };
+
+}// namespace modint_detail
+
+// montgomery arithmetic modulo an odd `n`, values live in [0, n)
+// everything is done in montgomery form, `to` and `from` convert
+// the `lazy_` functions skip the final correction and work on [0, 2n), they need n < 2^30,
+// `shrink` brings such a value back to [0, n)
+struct Montgomery32 : modint_detail::Modulus<std::uint32_t>
+{
+  using value_type = std::uint32_t;
+
+  std::uint32_t n_inv;// n * n_inv == 1 (mod 2^32)
+  std::uint32_t r2;// 2^64 mod n
+
+  static constexpr bool supports(std::uint64_t m) { return m % 2 == 1 && m < (std::uint64_t{ 1 } << 32); }
+
+  explicit constexpr Montgomery32(std::uint32_t _n) : Modulus{ _n }, n_inv(_n), r2(0)
+  {
+    // newton iteration, each step doubles the number of correct bits (3 -> 48)
+    for (std::uint32_t i = 0; i < 4; ++i) n_inv *= 2 - n * n_inv;
+    const std::uint32_t r = (0 - n) % n;
+    r2 = static_cast<std::uint32_t>(static_cast<std::uint64_t>(r) * r % n);
+  }
+
+  // t * 2^-32 mod n in [0, 2n), requires t < n * 2^32
+  constexpr std::uint32_t lazy_reduce(std::uint64_t t) const
+  {
+    const std::uint32_t m = static_cast<std::uint32_t>(t) * n_inv;
+    const auto mn = static_cast<std::uint32_t>((static_cast<std::uint64_t>(m) * n) >> 32);
+    // low halves of t and m * n are equal by construction
+    return static_cast<std::uint32_t>(t >> 32) + n - mn;
+  }
+
+  constexpr std::uint32_t reduce(std::uint64_t t) const
+  {
+    const std::uint32_t m = static_cast<std::uint32_t>(t) * n_inv;
+    const auto hi = static_cast<std::uint32_t>(t >> 32);
+    const auto mn = static_cast<std::uint32_t>((static_cast<std::uint64_t>(m) * n) >> 32);
+    return hi >= mn ? hi - mn : hi - mn + n;
+  }
+
+  constexpr std::uint32_t mul(std::uint32_t a, std::uint32_t b) const
+  {
+    return reduce(static_cast<std::uint64_t>(a) * b);
+  }
+  constexpr std::uint32_t lazy_mul(std::uint32_t a, std::uint32_t b) const
+  {
+    return lazy_reduce(static_cast<std::uint64_t>(a) * b);
+  }
+  constexpr std::uint32_t lazy_add(std::uint32_t a, std::uint32_t b) const
+  {
+    return a + b >= 2 * n ? a + b - 2 * n : a + b;
+  }
+  constexpr std::uint32_t shrink(std::uint32_t a) const { return a >= n ? a - n : a; }
+
+  constexpr std::uint32_t to(std::uint64_t a) const { return mul(static_cast<std::uint32_t>(a % n), r2); }
+  constexpr std::uint64_t from(std::uint32_t a) const { return reduce(a); }
+  constexpr std::uint32_t one() const { return to(1); }
+};
+
+// same for 64bit moduli, the `lazy_` functions need n < 2^62
+struct Montgomery64 : modint_detail::Modulus<std::uint64_t>
+{
+  using value_type = std::uint64_t;
+
+  std::uint64_t n_inv;// n * n_inv == 1 (mod 2^64)
+  std::uint64_t r2;// 2^128 mod n
+
+  static constexpr bool supports(std::uint64_t m) { return m % 2 == 1; }
+
+  explicit constexpr Montgomery64(std::uint64_t _n) : Modulus{ _n }, n_inv(_n), r2(0)
+  {
+    // newton iteration, each step doubles the number of correct bits (3 -> 96)
+    for (std::uint32_t i = 0; i < 5; ++i) n_inv *= 2 - n * n_inv;
+    const std::uint64_t r = (0 - n) % n;
+    r2 = static_cast<std::uint64_t>(static_cast<uint128_t>(r) * r % n);
+  }
+
+  // t * 2^-64 mod n in [0, 2n), requires t < n * 2^64
+  constexpr std::uint64_t lazy_reduce(uint128_t t) const
+  {
+    const std::uint64_t m = static_cast<std::uint64_t>(t) * n_inv;
+    const auto mn = static_cast<std::uint64_t>((static_cast<uint128_t>(m) * n) >> 64);
+    return static_cast<std::uint64_t>(t >> 64) + n - mn;
+  }
+
+  constexpr std::uint64_t reduce(uint128_t t) const
+  {
+    const std::uint64_t m = static_cast<std::uint64_t>(t) * n_inv;
+    const auto hi = static_cast<std::uint64_t>(t >> 64);
+    const auto mn = static_cast<std::uint64_t>((static_cast<uint128_t>(m) * n) >> 64);
+    // low halves of t and m * n are equal by construction
+    return hi >= mn ? hi - mn : hi - mn + n;
+  }
+
+  constexpr std::uint64_t mul(std::uint64_t a, std::uint64_t b) const
+  {
+    return reduce(static_cast<uint128_t>(a) * b);
+  }
+  constexpr std::uint64_t lazy_mul(std::uint64_t a, std::uint64_t b) const
+  {
+    return lazy_reduce(static_cast<uint128_t>(a) * b);
+  }
+  constexpr std::uint64_t lazy_add(std::uint64_t a, std::uint64_t b) const
+  {
+    return a + b >= 2 * n ? a + b - 2 * n : a + b;
+  }
+  constexpr std::uint64_t shrink(std::uint64_t a) const { return a >= n ? a - n : a; }
+
+  constexpr std::uint64_t to(std::uint64_t a) const { return mul(a % n, r2); }
+  constexpr std::uint64_t from(std::uint64_t a) const { return reduce(a); }
+  constexpr std::uint64_t one() const { return to(1); }
+
+  constexpr std::uint64_t pow(std::uint64_t a, std::uint64_t e) const
+  {
+    std::uint64_t out = one();
+    while (e) {
+      if (e % 2 == 1) out = mul(out, a);
+      e /= 2;
+      a = mul(a, a);
+    }
+    return out;
+  }
+};
+
+// barrett reduction for any modulus in [1, 2^32), values are plain residues
+struct Barrett32 : modint_detail::Modulus<std::uint32_t>
+{
+  using value_type = std::uint32_t;
+
+  std::uint64_t im;// ceil(2^64 / n), 0 for n == 1
+
+  static constexpr bool supports(std::uint64_t m) { return m >= 1 && m < (std::uint64_t{ 1 } << 32); }
+
+  explicit constexpr Barrett32(std::uint32_t _n) : Modulus{ _n }, im(~std::uint64_t{ 0 } / _n + 1) {}
+
+  // z mod n for z < n^2, the estimated quotient is off by at most one
+  constexpr std::uint32_t reduce(std::uint64_t z) const
+  {
+    const auto x = static_cast<std::uint64_t>((static_cast<uint128_t>(z) * im) >> 64);
+    const std::uint64_t y = x * n;
+    return static_cast<std::uint32_t>(z - y + (z < y ? n : 0));
+  }
+
+  constexpr std::uint32_t mul(std::uint32_t a, std::uint32_t b) const
+  {
+    return reduce(static_cast<std::uint64_t>(a) * b);
+  }
+
+  constexpr std::uint32_t to(std::uint64_t a) const { return static_cast<std::uint32_t>(a % n); }
+  constexpr std::uint64_t from(std::uint32_t a) const { return a; }
+  constexpr std::uint32_t one() const { return to(1); }
+};
+
+// the fallback, a 128bit `%` per multiplication
+struct Division64 : modint_detail::Modulus<std::uint64_t>
+{
+  using value_type = std::uint64_t;
+
+  static constexpr bool supports(std::uint64_t m) { return m >= 1; }
+
+  explicit constexpr Division64(std::uint64_t _n) : Modulus{ _n } {}
+
+  constexpr std::uint64_t mul(std::uint64_t a, std::uint64_t b) const
+  {
+    return static_cast<std::uint64_t>(static_cast<uint128_t>(a) * b % n);
+  }
+
+  constexpr std::uint64_t to(std::uint64_t a) const { return a % n; }
+  constexpr std::uint64_t from(std::uint64_t a) const { return a; }
+  constexpr std::uint64_t one() const { return to(1); }
+};
+
+// the fastest reducer for a modulus known at compile time
+template<std::uint64_t Mod> struct StaticModulus
+{
+  static_assert(Mod >= 1);
+  using Reducer = std::conditional_t<
+    Montgomery32::supports(Mod),
+    Montgomery32,
+    std::conditional_t<Montgomery64::supports(Mod),
+      Montgomery64,
+      std::conditional_t<Barrett32::supports(Mod), Barrett32, Division64>>>;
+
+  static constexpr Reducer value{ static_cast<typename Reducer::value_type>(Mod) };
+  static constexpr const Reducer &reducer() { return value; }
+};
+
+// a modulus chosen at runtime, one per `Tag`, set it before making any values
+// and don't change it while other threads compute with it
+template<typename Tag, typename R = Barrett32> struct DynamicModulus
+{
+  using Reducer = R;
+
+  static inline R value{ 1 };
+  static const R &reducer() { return value; }
+
+  static void set(std::uint64_t n)
+  {
+    if (!R::supports(n)) throw InvalidModulusException{};
+    value = R{ static_cast<typename R::value_type>(n) };
+  }
+};
+
+template<typename M> class Modint
+{
+public:
+  using Reducer = typename M::Reducer;
+  using value_type = typename Reducer::value_type;
+
+private:
+  value_type m_data;// in the reducer's form
+
+  static constexpr const Reducer &reducer() { return M::reducer(); }
+
+public:
+  constexpr Modint() : m_data{} {}
+
+  // TODO-think: implicit casts could be nasty here, but `pow` and friends construct from 1
+  template<typename I>
+    requires std::is_integral_v<I>
+  constexpr Modint(I value)
+  {
+    const auto n = reducer().modulus();
+    if constexpr (sizeof(I) > sizeof(std::uint64_t)) {
+      // a negative value becomes its residue, -1 -> n - 1
+      auto r = static_cast<int128_t>(value % static_cast<I>(n));
+      if (r < 0) r += n;
+      m_data = reducer().to(static_cast<std::uint64_t>(r));
+    } else if constexpr (std::is_signed_v<I>) {
+      m_data = value >= 0 ? reducer().to(static_cast<std::uint64_t>(value))
+                          : reducer().sub(0, reducer().to(0 - static_cast<std::uint64_t>(value)));
+    } else {
+      m_data = reducer().to(value);
+    }
+  }
+
+  // wraps a value that is already in the reducer's form
+  static constexpr Modint raw(value_type data)
+  {
+    Modint out;
+    out.m_data = data;
+    return out;
+  }
+  constexpr value_type raw() const { return m_data; }
+
+  static constexpr std::uint64_t modulus() { return reducer().modulus(); }
+
+  // the residue in [0, n)
+  constexpr std::uint64_t value() const { return reducer().from(m_data); }
+
+  constexpr Modint &operator+=(Modint arg)
+  {
+    m_data = reducer().add(m_data, arg.m_data);
+    return *this;
+  }
+  constexpr Modint &operator-=(Modint arg)
+  {
+    m_data = reducer().sub(m_data, arg.m_data);
+    return *this;
+  }
+  constexpr Modint &operator*=(Modint arg)
+  {
+    m_data = reducer().mul(m_data, arg.m_data);
+    return *this;
+  }
+  constexpr Modint &operator/=(Modint arg) { return *this *= arg.inverse(); }
+
+  friend constexpr Modint operator+(Modint a, Modint b) { return a += b; }
+  friend constexpr Modint operator-(Modint a, Modint b) { return a -= b; }
+  friend constexpr Modint operator*(Modint a, Modint b) { return a *= b; }
+  friend constexpr Modint operator/(Modint a, Modint b) { return a /= b; }
+
+  constexpr Modint operator-() const { return Modint{} - *this; }
+
+  // equal residues have equal forms, for every reducer
+  friend constexpr bool operator==(Modint a, Modint b) { return a.m_data == b.m_data; }
+
+  // `ivl::nt::pow` works too, this one takes a 64bit exponent
+  constexpr Modint pow(std::uint64_t e) const
+  {
+    Modint out{ 1 };
+    Modint a = *this;
+    while (e) {
+      if (e % 2 == 1) out *= a;
+      e /= 2;
+      a *= a;
+    }
+    return out;
+  }
+
+  // extended euclid, so the modulus doesn't have to be prime
+  constexpr Modint inverse() const
+  {
+    int128_t a = value(), b = modulus(), x = 1, y = 0;
+    while (b != 0) {
+      const int128_t q = a / b;
+      a -= q * b;
+      x -= q * y;
+      std::swap(a, b);
+      std::swap(x, y);
+    }
+    if (a != 1) throw NotInvertibleException{};
+    return Modint{ x };
+  }
+
+  friend std::ostream &operator<<(std::ostream &out, Modint m) { return out << m.value(); }
+};
+
+template<std::uint64_t Mod> using StaticModint = Modint<StaticModulus<Mod>>;
+template<typename Tag, typename R = Barrett32> using DynamicModint = Modint<DynamicModulus<Tag, R>>;
+
+static_assert(std::is_same_v<StaticModint<998244353>::Reducer, Montgomery32>);
+static_assert(std::is_same_v<StaticModint<(1ULL << 61) - 1>::Reducer, Montgomery64>);
+static_assert(std::is_same_v<StaticModint<1000000006>::Reducer, Barrett32>);
+static_assert(std::is_same_v<StaticModint<1ULL << 40>::Reducer, Division64>);
+static_assert((StaticModint<998244353>{ 3 }.pow(998244352)).value() == 1);
+static_assert((StaticModint<998244353>{ -1 } * -1).value() == 1);
+static_assert((StaticModint<1000000006>{ 1000000005 } * 1000000005).value() == 1);
+static_assert((StaticModint<(1ULL << 61) - 1>{ 1ULL << 60 } * 4).value() == 2);
+static_assert((StaticModint<1ULL << 40>{ 1ULL << 39 } * 3 + 7).value() == (1ULL << 39) + 7);
+static_assert((StaticModint<10>{ 3 } / 7).value() == 9);
+static_assert(sizeof(StaticModint<998244353>) == 4 && sizeof(StaticModint<(1ULL << 61) - 1>) == 8);
+
+// out[i] = left[i] * right[i] (or +), over whole arrays
+// branch free loops the compiler vectorizes, montgomery32 turns into 32x32->64 vector multiplies;
+// barrett32 and the 64bit reducers need the high half of a 64x64 product, which no vector unit has,
+// so their `batch_mul` stays scalar
+// the inputs are at least as long as `out`, which may alias them
+// one kernel per `SimdLevel` (simd.hpp)
+namespace modint_detail {
+  template<typename M>
+  IVL_NT_SIMD_BODY void batch_mul(const Modint<M> *left, const Modint<M> *right, Modint<M> *out, std::size_t n)
+  {
+    // a local copy, otherwise the stores to `out` might alias a dynamic reducer
+    const auto reducer = M::reducer();
+    for (std::size_t i = 0; i < n; ++i) out[i] = Modint<M>::raw(reducer.mul(left[i].raw(), right[i].raw()));
+  }
+
+  template<typename M>
+  IVL_NT_SIMD_BODY void batch_add(const Modint<M> *left, const Modint<M> *right, Modint<M> *out, std::size_t n)
+  {
+    const auto reducer = M::reducer();
+    for (std::size_t i = 0; i < n; ++i) out[i] = Modint<M>::raw(reducer.add(left[i].raw(), right[i].raw()));
+  }
+}// namespace modint_detail
+
+template<typename M>
+void batch_mul(std::span<const Modint<M>> left,
+  std::span<const Modint<M>> right,
+  std::span<Modint<M>> out,
+  SimdLevel level = simd_level)
+{
+  simd_dispatch<modint_detail::batch_mul<M>>(level, left.data(), right.data(), out.data(), out.size());
+}
+
+template<typename M>
+void batch_add(std::span<const Modint<M>> left,
+  std::span<const Modint<M>> right,
+  std::span<Modint<M>> out,
+  SimdLevel level = simd_level)
+{
+  simd_dispatch<modint_detail::batch_add<M>>(level, left.data(), right.data(), out.data(), out.size());
+}
+
+}// namespace ivl::nt
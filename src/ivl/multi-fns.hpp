@@ -1,12 +1,24 @@
 #pragma once
 
 // multiplicative functions
+// the ones known to be multiplicative are `Multiplicative`s, which also carry f(p^e), and a dirichlet convolution
+// of two of those is evaluated one prime power at a time, O(sum of e^2) products instead of one per divisor pair
 
 #include <ivl/divisors.hpp>
 #include <ivl/factorize.hpp>
+#include <ivl/instrument.hpp>
+#include <ivl/small-tables.hpp>
 
 #include <ivl/tester.hpp>
 
+#if __has_include(<flint/fmpzxx.h>)
+#include <ivl/flint-accumulate.hpp>
+#endif
+
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <type_traits>
 #include <utility>
 
 namespace ivl::nt {
@@ -14,77 +26,229 @@ namespace ivl::nt {
 // multiplicative functions with argument of type T
 // return this type
 // probably not perfect for every case but should be okay in general
-template<typename T> using ReturnType = std::remove_cvref_t<decltype(factorize(std::declval<T>()).front().first)>;
+template<typename T> using ReturnType = std::remove_cvref_t<decltype(prime_at(factorize(std::declval<T>()), 0))>;
+
+// f(mn) = f(m) f(n) for coprime m and n, so f is its values at the prime powers, `prime_power(p, e)`
+// (1 for e = 0), calling it calls `function`, which is usually faster than going through `prime_power`
+// `dirichlet_convolution` takes the per prime power path when both sides are one of these
+template<typename PrimePower, typename Function> struct Multiplicative
+{
+  PrimePower prime_power;
+  Function function;
+
+  template<typename T> constexpr decltype(auto) operator()(T &&arg) const { return function(std::forward<T>(arg)); }
+};
+
+namespace multi_fns_detail {
+  template<typename F> struct IsMultiplicative : std::false_type
+  {};
+  template<typename PrimePower, typename Function>
+  struct IsMultiplicative<Multiplicative<PrimePower, Function>> : std::true_type
+  {};
+
+  // `function` with the prime powers of `of` if it has them, for wrappers that only make `of` faster
+  template<typename Of, typename Function> constexpr auto keep_multiplicative(const Of &of, Function function)
+  {
+    if constexpr (IsMultiplicative<Of>::value) {
+      return Multiplicative{ of.prime_power, std::move(function) };
+    } else {
+      return function;
+    }
+  }
+}// namespace multi_fns_detail
+
+template<typename F> concept MultiplicativeFunction = multi_fns_detail::IsMultiplicative<std::remove_cvref_t<F>>::value;
 
 namespace compiletime {
   template<auto callable>
-  constexpr auto multiplicative_completion = []<typename T>(T &&arg) -> ReturnType<T> {
+  constexpr Multiplicative multiplicative_completion{ callable, []<typename T>(T &&arg) -> ReturnType<T> {
     // TODO: check if correct
     decltype(auto) factorization = factorize(arg);
     ReturnType<T> out{ 1 };
     for (auto [p, e] : factorization) { out *= callable(p, e); }
     return out;
-  };
+  } };
+
+  // positive builtin arguments below `small_table_bound` are a load from `small_tables.*table`,
+  // everything else (factorizations included) goes to `fallback`
+  template<auto table, auto fallback>
+  constexpr auto with_small_table =
+    multi_fns_detail::keep_multiplicative(fallback, []<typename T>(T &&arg) -> ReturnType<T> {
+    using V = std::remove_cvref_t<T>;
+    if constexpr (factorization_detail::small_tabled<V>) {
+      if (arg > V{ 0 } && static_cast<std::uint64_t>(arg) < small_table_bound) {
+        return static_cast<ReturnType<T>>((small_tables.*table)[static_cast<std::size_t>(arg)]);
+      }
+    }
+    return fallback(std::forward<T>(arg));
+  });
 }// namespace compiletime
 
-constexpr auto tau_compiletime = compiletime::multiplicative_completion<[](auto, auto e) { return e + 1; }>;
+constexpr auto tau_compiletime = compiletime::with_small_table<&SmallTables::tau,
+  compiletime::multiplicative_completion<[](auto, auto e) { return e + 1; }>>;
 
 namespace runtime {
-  constexpr auto multiplicative_completion(auto &&callable)
+  template<typename Callable> constexpr auto multiplicative_completion(Callable callable)
   {
-    return [callable = std::forward<decltype(callable)>(callable)]<typename T>(T &&arg) -> ReturnType<T> {
+    auto function = [callable]<typename T>(T &&arg) -> ReturnType<T> {
       decltype(auto) factorization = factorize(arg);
       ReturnType<T> out{ 1 };
       for (auto [p, e] : factorization) { out *= callable(p, e); }
       return out;
     };
+    return Multiplicative{ std::move(callable), std::move(function) };
+  }
+}// namespace runtime
+
+namespace runtime {
+  // `values[n]` for builtin n in [1, values.size()), `fallback(arg)` for everything else,
+  // `values` is e.g. a `multiplicative_table` or a section of a `TableFile`, and has to outlive the result
+  // (multiplicative if `fallback` is)
+  template<typename R, typename Fallback> constexpr auto with_table(std::span<const R> values, Fallback fallback)
+  {
+    return multi_fns_detail::keep_multiplicative(fallback, [values, fallback]<typename T>(T &&arg) -> ReturnType<T> {
+      using V = std::remove_cvref_t<T>;
+      if constexpr (std::is_integral_v<V>) {
+        if (arg > V{ 0 } && static_cast<std::uint64_t>(arg) < values.size()) {
+          return static_cast<ReturnType<T>>(values[static_cast<std::size_t>(arg)]);
+        }
+      }
+      return fallback(std::forward<T>(arg));
+    });
   }
 }// namespace runtime
 
 constexpr auto tau_runtime = runtime::multiplicative_completion([](auto, auto e) { return e + 1; });
 static_assert(test_equality(tau_compiletime, tau_runtime, 100));
 
-namespace compiletime {
-  template<auto left, auto right>
-  constexpr auto dirichlet_convolution = []<typename T>(T &&arg) -> ReturnType<T> {
+namespace multi_fns_detail {
+  // sum of left(d) right(n / d) over every divisor d of n, both sides get factorizations with zero exponents
+  template<typename Left, typename Right, typename T>
+  constexpr ReturnType<T> divisor_pair_convolution(const Left &left, const Right &right, T &&arg)
+  {
     decltype(auto) factorization = factorize(arg);
+    const std::size_t size = factorization_size(factorization);
     auto left_div = factorization;
     auto right_div = factorization;
-    for (auto &[p, e] : left_div) { e = 0; }
+    for (std::size_t i = 0; i < size; ++i) { exponent_at(left_div, i) = 0; }
     ReturnType<T> out{ 0 };
+    std::uint64_t terms = 0;
     while (true) {
       out += left(left_div) * right(right_div);
+      ++terms;
       std::size_t i = 0;
       // TODO: this feels like it can be improved
-      for (; i < factorization.size(); ++i) {
-        if (right_div[i].second == 0) {
-          left_div[i].second = 0;
-          right_div[i].second = factorization[i].second;
+      for (; i < size; ++i) {
+        if (exponent_at(right_div, i) == 0) {
+          exponent_at(left_div, i) = 0;
+          exponent_at(right_div, i) = exponent_at(factorization, i);
         } else {
-          ++left_div[i].second;
-          --right_div[i].second;
+          ++exponent_at(left_div, i);
+          --exponent_at(right_div, i);
           break;
         }
       }
-      if (i == factorization.size()) { break; }
+      if (i == size) { break; }
+    }
+    instrument::add(instrument::Counter::dirichlet_terms, terms);
+    return out;
+  }
+
+  // (left * right)(p^e), sum of left(p^a) right(p^(e - a)) over 0 <= a <= e
+  template<typename R, typename Left, typename Right, typename P>
+  constexpr R convolve_prime_power(const Left &left, const Right &right, const P &p, std::uint32_t e)
+  {
+    R out{ 0 };
+    for (std::uint32_t a = 0; a <= e; ++a) {
+      R term = static_cast<R>(left.prime_power(p, a));
+      term *= static_cast<R>(right.prime_power(p, e - a));
+      out += term;
     }
+    instrument::add(instrument::Counter::dirichlet_terms, e + 1);
     return out;
+  }
+
+  // the convolution of two multiplicative functions is multiplicative, and so a `Multiplicative` again
+  template<typename Left, typename Right> constexpr auto multiplicative_convolution(Left left, Right right)
+  {
+    auto prime_power = [left, right]<typename P>(P p, std::uint32_t e) -> P {
+      return convolve_prime_power<P>(left, right, p, e);
+    };
+    auto function = [left, right]<typename T>(T &&arg) -> ReturnType<T> {
+      decltype(auto) factorization = factorize(arg);
+      ReturnType<T> out{ 1 };
+      for (const auto &[p, e] : factorization) out *= convolve_prime_power<ReturnType<T>>(left, right, p, e);
+      return out;
+    };
+    return Multiplicative{ std::move(prime_power), std::move(function) };
+  }
+}// namespace multi_fns_detail
+
+namespace compiletime {
+  // one product per divisor pair, whatever left and right are
+  template<auto left, auto right>
+  constexpr auto generic_dirichlet_convolution = []<typename T>(T &&arg) -> ReturnType<T> {
+    return multi_fns_detail::divisor_pair_convolution(left, right, std::forward<T>(arg));
   };
+
+  template<auto left, auto right>
+  constexpr auto dirichlet_convolution = [] {
+    if constexpr (MultiplicativeFunction<decltype(left)> && MultiplicativeFunction<decltype(right)>) {
+      return multi_fns_detail::multiplicative_convolution(left, right);
+    } else {
+      return generic_dirichlet_convolution<left, right>;
+    }
+  }();
 }// namespace compiletime
 
+namespace runtime {
+  template<typename Left, typename Right> constexpr auto generic_dirichlet_convolution(Left left, Right right)
+  {
+    return [left, right]<typename T>(T &&arg) -> ReturnType<T> {
+      return multi_fns_detail::divisor_pair_convolution(left, right, std::forward<T>(arg));
+    };
+  }
+
+  template<typename Left, typename Right> constexpr auto dirichlet_convolution(Left left, Right right)
+  {
+    if constexpr (MultiplicativeFunction<Left> && MultiplicativeFunction<Right>) {
+      return multi_fns_detail::multiplicative_convolution(std::move(left), std::move(right));
+    } else {
+      return generic_dirichlet_convolution(std::move(left), std::move(right));
+    }
+  }
+}// namespace runtime
+
+// types that do `pow`, `powsum` and `id` better than the generic loops below (without temporaries, say)
+// specialize this with static `pow(n, e)`, `powsum(n, e)` and `mul_pow(out, p, e)` (out *= p^e),
+// see flint-accumulate.hpp
+// a specialization has to be visible wherever the primary is, so its header is included at the top of this one
+template<typename T> struct InPlaceArithmetic
+{};
+
+template<typename T> concept HasInPlaceArithmetic = requires(T &out, const T &n) {
+  { InPlaceArithmetic<T>::pow(n, 1u) } -> std::same_as<T>;
+  { InPlaceArithmetic<T>::powsum(n, 1u) } -> std::same_as<T>;
+  InPlaceArithmetic<T>::mul_pow(out, n, 1u);
+};
+
 // implemented as a lambda so i can manipulate the object
 // `pow.operator()` is probably equivalent to
 // function template implementation
 // TODO: this might be improveable?
 // not trying anything without perf tests
 constexpr auto pow = []<typename T>(T n, std::uint32_t e) -> T {
-  T out{ 1 };
-  while (e) {
-    if (e % 2 == 1) { out *= n; }
-    e /= 2;
-    n *= n;
+  if constexpr (HasInPlaceArithmetic<T>) {
+    return InPlaceArithmetic<T>::pow(n, e);
+  } else {
+    T out{ 1 };
+    while (e) {
+      if (e % 2 == 1) { out *= n; }
+      e /= 2;
+      n *= n;
+    }
+    return out;
   }
-  return out;
 };
 
 // this is 1 + n + n^2 + ... + n^e
@@ -92,34 +256,48 @@ constexpr auto pow = []<typename T>(T n, std::uint32_t e) -> T {
 // but not implemented directly via that
 // bc i am afraid of overflow
 // for example: powsum(1000001, 1)
+// horner's scheme, every intermediate value is a partial sum so it
+// overflows only if the result does, and there is no division
+// (which used to dominate `multiplicative_table`), e is small in practice
 // implemented as a lambda so i can manipulate the object
 // `powsum.operator()` is probably equivalent to
 // function template implementation
 constexpr auto powsum = []<typename T>(T n, std::uint32_t e) -> T {
-  if (n == 1) return e + 1;
-  T tmp = ::ivl::nt::pow(n, e);
-  // TODO: the -1 in the numerator is kinda not needed?
-  // should i remove it?
-  return (tmp - 1) / (n - 1) + tmp;
+  if constexpr (HasInPlaceArithmetic<T>) {
+    return InPlaceArithmetic<T>::powsum(n, e);
+  } else {
+    T out{ 1 };
+    for (std::uint32_t i = 0; i < e; ++i) { out = out * n + T{ 1 }; }
+    return out;
+  }
 };
 
-constexpr auto sigma_compiletime = compiletime::multiplicative_completion<powsum>;
+constexpr auto sigma_compiletime =
+  compiletime::with_small_table<&SmallTables::sigma, compiletime::multiplicative_completion<powsum>>;
 
 // TODO-think: should it be T&& ?
 // the compiler is ~probably~ smart enough to not copy
-constexpr auto one = []<typename T>(T) -> ReturnType<T> { return 1; };
-constexpr auto id = []<typename T>(T &&arg) -> ReturnType<T> {
+constexpr Multiplicative one{ []<typename T>(T, std::uint32_t) -> T { return 1; },
+  []<typename T>(T) -> ReturnType<T> { return 1; } };
+constexpr Multiplicative id{ pow, []<typename T>(T &&arg) -> ReturnType<T> {
   if constexpr (std::is_same_v<ReturnType<T>, std::remove_cvref_t<T>>) {
     return arg;
   } else {
     ReturnType<T> out{ 1 };
-    for (auto [p, e] : arg) { out *= ::ivl::nt::pow(p, e); }
+    for (const auto &[p, e] : arg) {
+      if constexpr (HasInPlaceArithmetic<ReturnType<T>>) {
+        InPlaceArithmetic<ReturnType<T>>::mul_pow(out, p, e);
+      } else {
+        out *= ::ivl::nt::pow(p, e);
+      }
+    }
     return out;
   }
-};
+} };
 
 // this is the neutral element with respect to the dirichlet convolution
-constexpr auto epsilon = []<typename T>(T &&arg) -> ReturnType<T> { return id(arg) == 1 ? 1 : 0; };
+constexpr Multiplicative epsilon{ []<typename T>(T, std::uint32_t e) -> T { return e == 0 ? 1 : 0; },
+  []<typename T>(T &&arg) -> ReturnType<T> { return id(arg) == 1 ? 1 : 0; } };
 static_assert(test_equality(sigma_compiletime, compiletime::dirichlet_convolution<sigma_compiletime, epsilon>, 100));
 
 constexpr auto tau_dirichlet = compiletime::dirichlet_convolution<one, one>;
@@ -131,4 +309,52 @@ static_assert(test_equality(sigma_compiletime, sigma_dirichlet, 100));
 constexpr auto id_compiletime = compiletime::multiplicative_completion<pow>;
 static_assert(test_equality(id_compiletime, id, 100));
 
+// same functions on the inline representation, no allocations anywhere
+static_assert(sigma_dirichlet(factorize<std::uint32_t, ExponentType, InlineFactorization<std::uint32_t>>(720))
+              == sigma_compiletime(720u));
+
+// phi(p^e) = p^(e-1) * (p - 1)
+// like every other per prime power callable here, e == 0 has to give 1,
+// `dirichlet_convolution` passes factorizations with zero exponents
+constexpr auto phi_prime_power = []<typename T>(T p, std::uint32_t e) -> T {
+  if (e == 0) return 1;
+  return ::ivl::nt::pow(p, e - 1) * (p - 1);
+};
+
+constexpr auto phi_compiletime =
+  compiletime::with_small_table<&SmallTables::phi, compiletime::multiplicative_completion<phi_prime_power>>;
+// sum of phi(d) over d | n is n
+static_assert(test_equality(id, compiletime::dirichlet_convolution<phi_compiletime, one>, 100));
+
+// mu(p) = -1, mu(p^e) = 0 for e > 1
+// for unsigned types -1 wraps around, which is still correct modulo 2^bits
+constexpr auto mu_prime_power = []<typename T>(T, std::uint32_t e) -> T {
+  if (e == 0) return 1;
+  return e == 1 ? T{ 0 } - T{ 1 } : T{ 0 };
+};
+
+constexpr auto mu_compiletime =
+  compiletime::with_small_table<&SmallTables::mu, compiletime::multiplicative_completion<mu_prime_power>>;
+// mu is the dirichlet inverse of one
+static_assert(test_equality<std::int64_t>(epsilon, compiletime::dirichlet_convolution<mu_compiletime, one>, 100));
+
+// the per prime power path against the divisor pairs, and a convolution of convolutions (tau * mu = one * one * mu)
+static_assert(MultiplicativeFunction<decltype(sigma_dirichlet)> && MultiplicativeFunction<decltype(mu_compiletime)>);
+static_assert(test_equality(sigma_dirichlet, compiletime::generic_dirichlet_convolution<one, id>, 100)
+              && test_equality(tau_dirichlet, compiletime::generic_dirichlet_convolution<one, one>, 100));
+static_assert(test_equality<std::int64_t>(
+  one, compiletime::dirichlet_convolution<compiletime::dirichlet_convolution<one, one>, mu_compiletime>, 100));
+
+// anything else takes the divisor pairs, omega isn't multiplicative
+constexpr auto omega = []<typename T>(T &&arg) -> ReturnType<T> {
+  ReturnType<T> out{ 0 };
+  for (const auto &[p, e] : factorize(arg)) out += e != 0;
+  return out;
+};
+static_assert(!MultiplicativeFunction<decltype(compiletime::dirichlet_convolution<omega, one>)>);
+static_assert(test_equality(compiletime::dirichlet_convolution<omega, one>,
+  compiletime::generic_dirichlet_convolution<omega, one>,
+  100));
+static_assert(compiletime::dirichlet_convolution<omega, one>(12u) == 7);
+
 }// namespace ivl::nt
@@ -0,0 +1,209 @@
+#pragma once
+
+// tables of multiplicative functions, f(1..N) all at once
+// takes the same per prime power callables as `multiplicative_completion`
+// (`powsum`, `phi_prime_power`, `mu_prime_power`, ...), called as `callable(p, e)`
+// with `std::uint64_t` p and `ExponentType` e, the result is cast to the table type
+
+#include <ivl/factorize.hpp>
+#include <ivl/primes.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ivl::nt {
+
+inline constexpr std::size_t cache_line_size = 64;
+
+// heap array aligned to a cache line, so that blocks handed to different threads
+// never share a line (`multiplicative_table` rounds its blocks to whole lines)
+template<typename R> class AlignedTable
+{
+private:
+  struct Deleter
+  {
+    void operator()(R *ptr) const { ::operator delete(ptr, std::align_val_t{ cache_line_size }); }
+  };
+
+  std::unique_ptr<R, Deleter> m_data;
+  std::size_t m_size;
+
+public:
+  explicit AlignedTable(std::size_t size)
+    : m_data(static_cast<R *>(::operator new(size * sizeof(R), std::align_val_t{ cache_line_size }))), m_size(size)
+  {
+    static_assert(std::is_trivially_default_constructible_v<R> && std::is_trivially_destructible_v<R>,
+      "only for plain number types");
+  }
+
+  std::span<R> span() { return { m_data.get(), m_size }; }
+  std::span<const R> span() const { return { m_data.get(), m_size }; }
+
+  R &operator[](std::size_t i) { return m_data.get()[i]; }
+  const R &operator[](std::size_t i) const { return m_data.get()[i]; }
+  std::size_t size() const { return m_size; }
+};
+
+// out[n] = f(n) for n in [1, out.size() - 1], out[0] is left alone
+// linear sieve, every n is written exactly once, O(N) time
+// needs N + 1 extra 32bit words of memory (so N < 2^32), `multiplicative_table` doesn't
+template<typename R, typename Callable> void linear_sieve_table(Callable &&callable, std::span<R> out)
+{
+  if (out.size() < 2) return;
+  const std::uint64_t n = out.size() - 1;
+  const auto g = [&](std::uint64_t p, ExponentType e) { return static_cast<R>(callable(p, e)); };
+  // largest power of the smallest prime factor that divides i, 0 for not visited yet
+  std::vector<std::uint32_t> lowest_power(n + 1, 0);
+  std::vector<std::uint32_t> primes;
+  out[1] = R{ 1 };
+  for (std::uint64_t i = 2; i <= n; ++i) {
+    if (lowest_power[i] == 0) {
+      lowest_power[i] = static_cast<std::uint32_t>(i);
+      out[i] = g(i, 1);
+      primes.push_back(static_cast<std::uint32_t>(i));
+    }
+    for (std::uint64_t p : primes) {
+      if (p > n / i) break;
+      if (i % p != 0) {
+        lowest_power[i * p] = static_cast<std::uint32_t>(p);
+        out[i * p] = out[i] * out[p];
+        continue;
+      }
+      // p is the smallest prime factor of i, i * p = rest * (lowest_power * p)
+      const std::uint64_t power = std::uint64_t{ lowest_power[i] } * p;
+      const std::uint64_t rest = i / lowest_power[i];
+      lowest_power[i * p] = static_cast<std::uint32_t>(power);
+      if (rest != 1) {
+        out[i * p] = out[rest] * out[power];
+      } else {
+        // i * p is a prime power, there are only O(sqrt(N)) of those
+        ExponentType e = 0;
+        for (std::uint64_t m = power; m > 1; m /= p) ++e;
+        out[i * p] = g(p, e);
+      }
+      break;
+    }
+  }
+}
+
+namespace table_detail {
+
+  // elements per segment of a block
+  inline constexpr std::uint64_t segment_length = 1 << 15;
+
+  // f(p^e) and p^e for every prime p <= sqrt(N) and every e with p^e <= N
+  template<typename R> struct PrimePowerValues
+  {
+    std::vector<std::uint32_t> primes;
+    std::vector<std::size_t> offsets;// values of primes[j] are at [offsets[j], offsets[j + 1]), e starting at 1
+    std::vector<R> values;
+    std::vector<std::uint64_t> powers;
+
+    PrimePowerValues(std::uint64_t n, auto &&g) : offsets{ 0 }
+    {
+      for (std::uint32_t p : { 2, 3, 5 }) {
+        if (std::uint64_t{ p } * p <= n) primes.push_back(p);
+      }
+      const auto rest = sieving_primes(n);
+      primes.insert(primes.end(), rest.begin(), rest.end());
+      for (std::uint64_t p : primes) {
+        std::uint64_t pk = p;
+        for (ExponentType e = 1;; ++e) {
+          values.push_back(g(p, e));
+          powers.push_back(pk);
+          if (pk > n / p) break;
+          pk *= p;
+        }
+        offsets.push_back(values.size());
+      }
+    }
+  };
+
+}// namespace table_detail
+
+// out[i] = f(first + i), a window of a table too large to hold all at once, f(0) is left alone
+// the sieve of `multiplicative_table` with the primes up to the square root of the window's end,
+// a window costs O(pi(sqrt(N))) on top of its length
+template<typename R, typename Callable>
+void multiplicative_table_window(Callable &&callable, std::span<R> out, std::uint64_t first, std::uint32_t threads = 1)
+{
+  if (out.empty()) return;
+  const std::uint64_t n = first + out.size() - 1;
+  const auto g = [&](std::uint64_t p, ExponentType e) { return static_cast<R>(callable(p, e)); };
+  const table_detail::PrimePowerValues<R> prime_powers{ n, g };
+  const auto first_multiple = [](std::uint64_t lo, std::uint64_t d) { return lo + (d - lo % d) % d; };
+
+  const auto fill_block = [&](std::uint64_t block_lo, std::uint64_t block_hi) {
+    std::vector<std::uint64_t> next(prime_powers.primes.size());
+    for (std::size_t j = 0; j < next.size(); ++j) next[j] = first_multiple(block_lo, prime_powers.primes[j]);
+    // product of the prime powers found so far, and exponent of the current prime minus one
+    std::vector<std::uint64_t> found(table_detail::segment_length);
+    std::vector<std::uint8_t> extra(table_detail::segment_length, 0);
+
+    for (std::uint64_t lo = block_lo; lo <= block_hi; lo += table_detail::segment_length) {
+      const std::uint64_t hi = std::min(block_hi, lo + table_detail::segment_length - 1);
+      const auto length = static_cast<std::size_t>(hi - lo + 1);
+      R *values = out.data() + (lo - first);
+      std::fill_n(values, length, R{ 1 });
+      std::fill_n(found.begin(), length, 1);
+
+      for (std::size_t j = 0; j < prime_powers.primes.size(); ++j) {
+        const std::uint64_t p = prime_powers.primes[j];
+        const auto begin = prime_powers.offsets[j];
+        const auto end = prime_powers.offsets[j + 1];
+        // p^2, p^3, ... first, they are sparse enough to divide
+        for (auto k = begin + 1; k < end; ++k) {
+          const std::uint64_t pk = prime_powers.powers[k];
+          for (std::uint64_t x = first_multiple(lo, pk); x <= hi; x += pk) ++extra[x - lo];
+        }
+        std::uint64_t x = next[j];
+        for (; x <= hi; x += p) {
+          const auto i = static_cast<std::size_t>(x - lo);
+          values[i] *= prime_powers.values[begin + extra[i]];
+          found[i] *= prime_powers.powers[begin + extra[i]];
+          extra[i] = 0;
+        }
+        next[j] = x;
+      }
+      // whatever is left is 1 or a single prime > sqrt(N)
+      for (std::size_t i = 0; i < length; ++i) {
+        if (found[i] != lo + i) values[i] *= g((lo + i) / found[i], 1);
+      }
+      if (hi == block_hi) break;
+    }
+  };
+
+  // f(1) has no prime factors, the sieve handles it the same way
+  const std::uint64_t start = std::max<std::uint64_t>(first, 1);
+  if (start > n) return;
+  const std::uint64_t per_line = std::max<std::uint64_t>(cache_line_size / sizeof(R), 1);
+  threads = std::max<std::uint32_t>(threads, 1);
+  // blocks count from `first`, so they start on lines of `out`
+  const std::uint64_t block = (((n - first) / threads) / per_line + 1) * per_line;
+  std::vector<std::jthread> pool;
+  for (std::uint32_t t = 1; t < threads; ++t) {
+    if (t * block > n - first) break;
+    pool.emplace_back(fill_block, first + t * block, std::min(n, first + (t + 1) * block - 1));
+  }
+  fill_block(start, std::min(n, first + block - 1));
+}
+
+// out[n] = f(n) for n in [1, out.size() - 1], out[0] is left alone
+// blocked sieve: [1, N] is split into one contiguous block per thread, cut into segments,
+// each segment is sieved with the primes up to sqrt(N), the leftover cofactor is a single prime
+// O(N log log N) time, but only O(sqrt(N)) extra memory per thread and every pass stays in cache
+// the blocks are rounded to whole cache lines, `AlignedTable` avoids false sharing at the edges
+template<typename R, typename Callable>
+void multiplicative_table(Callable &&callable, std::span<R> out, std::uint32_t threads = 1)
+{
+  multiplicative_table_window(std::forward<Callable>(callable), out, 0, threads);
+}
+
+}// namespace ivl::nt
@@ -0,0 +1,445 @@
+#pragma once
+
+// number theoretic transform and the power series built on it, over `Modint`
+// a prime modulus p is ntt friendly for size 2^k if 2^k divides p - 1 (998244353 = 119 * 2^23 + 1 is the usual one),
+// `convolution` falls back to three ntt primes and crt for any other modulus
+// transforms work in place:
+// * the forward one is decimation in frequency, natural order in, bit reversed order out
+// * the inverse one is decimation in time, bit reversed in, natural out
+// so nothing ever gets permuted, pointwise products don't care about the order
+// the layers that span more than `block` elements run one at a time over the whole array,
+// everything below runs block by block, so a block stays in cache for all of its layers;
+// blocks (and slices of the wide layers) are split between threads
+
+#include <ivl/modint.hpp>
+#include <ivl/pollard-rho.hpp>
+#include <ivl/simd.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ivl::nt {
+
+class NttSizeException : public std::exception
+{
+  const char *what() const noexcept override { return "modulus doesn't support a transform of this size"; }
+};
+
+class SeriesDomainException : public std::exception
+{
+  const char *what() const noexcept override { return "log needs a constant term of 1, exp a constant term of 0"; }
+};
+
+// coefficients, lowest degree first; power series are the same thing cut off at some x^n
+template<typename M> using Polynomial = std::vector<Modint<M>>;
+template<typename M> using PolynomialView = std::span<const Modint<M>>;
+
+namespace ntt_detail {
+
+  // elements of one cache block, 16KB of 32bit values
+  inline constexpr std::size_t block = 1 << 12;
+  // smaller transforms aren't worth waking threads for
+  inline constexpr std::size_t parallel_threshold = 1 << 16;
+  // below this the schoolbook product wins
+  inline constexpr std::size_t naive_threshold = 32;
+
+  struct RootInfo
+  {
+    std::uint32_t max_log = 0;// transforms of size up to 2^max_log, 0 if p isn't prime
+    std::uint64_t generator = 0;// a primitive root mod p
+  };
+
+  // the smallest primitive root, found through the prime factors of p - 1
+  inline RootInfo root_info(std::uint64_t p)
+  {
+    if (!pollard_rho::is_prime(p) || p == 2) return {};
+    const auto factors = factorize<std::uint64_t>(p - 1, pollard_rho_strategy);
+    const Montgomery64 mont{ p };
+    for (std::uint64_t g = 2;; ++g) {
+      const bool primitive = std::all_of(factors.begin(), factors.end(), [&](const auto &factor) {
+        return mont.pow(mont.to(g), (p - 1) / factor.first) != mont.one();
+      });
+      if (primitive) return { static_cast<std::uint32_t>(std::countr_zero(p - 1)), g };
+    }
+  }
+
+  // `root_info` of M's modulus, found once per modulus and thread instead of once per transform,
+  // a `DynamicModulus` that was `set` to something else since gets it redone
+  template<typename M> RootInfo cached_root_info()
+  {
+    const std::uint64_t p = Modint<M>::modulus();
+    thread_local std::pair<std::uint64_t, RootInfo> cache{ 0, {} };// no modulus is 0
+    if (cache.first != p) cache = { p, root_info(p) };
+    return cache.second;
+  }
+
+  // `job(i)` for i in [0, count), handed out one at a time
+  template<typename F> void parallel_for(std::size_t count, std::uint32_t threads, F &&job)
+  {
+    if (threads <= 1 || count <= 1) {
+      for (std::size_t i = 0; i < count; ++i) job(i);
+      return;
+    }
+    std::atomic<std::size_t> next{ 0 };
+    const auto worker = [&] {
+      for (std::size_t i; (i = next.fetch_add(1)) < count;) job(i);
+    };
+    std::vector<std::jthread> pool;
+    for (std::uint32_t t = 1; t < std::min<std::size_t>(threads, count); ++t) pool.emplace_back(worker);
+    worker();
+  }
+
+  // one dif butterfly run, a[j], a[j + h] -> a[j] + a[j + h], (a[j] - a[j + h]) w[j], for j in [begin, end)
+  // branch free over contiguous arrays, vectorizes for the 32bit montgomery reducer
+  template<typename M>
+  IVL_NT_SIMD_BODY void dif_butterflies(Modint<M> *a,
+    std::size_t h,
+    const Modint<M> *w,
+    std::size_t begin,
+    std::size_t end)
+  {
+    const auto r = M::reducer();
+    for (std::size_t j = begin; j < end; ++j) {
+      const auto u = a[j].raw();
+      const auto v = a[j + h].raw();
+      a[j] = Modint<M>::raw(r.add(u, v));
+      a[j + h] = Modint<M>::raw(r.mul(r.sub(u, v), w[j].raw()));
+    }
+  }
+
+  // the inverse, a[j], a[j + h] -> a[j] + a[j + h] w[j], a[j] - a[j + h] w[j]
+  template<typename M>
+  IVL_NT_SIMD_BODY void dit_butterflies(Modint<M> *a,
+    std::size_t h,
+    const Modint<M> *w,
+    std::size_t begin,
+    std::size_t end)
+  {
+    const auto r = M::reducer();
+    for (std::size_t j = begin; j < end; ++j) {
+      const auto u = a[j].raw();
+      const auto v = r.mul(a[j + h].raw(), w[j].raw());
+      a[j] = Modint<M>::raw(r.add(u, v));
+      a[j + h] = Modint<M>::raw(r.sub(u, v));
+    }
+  }
+
+  // the butterflies compiled for `simd_level` (simd.hpp)
+  template<typename M>
+  void dif_run(Modint<M> *a, std::size_t h, const Modint<M> *w, std::size_t begin, std::size_t end)
+  {
+    simd_dispatch<dif_butterflies<M>>(simd_level, a, h, w, begin, end);
+  }
+
+  template<typename M>
+  void dit_run(Modint<M> *a, std::size_t h, const Modint<M> *w, std::size_t begin, std::size_t end)
+  {
+    simd_dispatch<dit_butterflies<M>>(simd_level, a, h, w, begin, end);
+  }
+
+  // roots[h + j] = w^j for the primitive 2h-th root w, for every power of two h < n
+  template<typename M> std::vector<Modint<M>> twiddles(std::size_t n, bool inverse)
+  {
+    const std::uint64_t p = Modint<M>::modulus();
+    const RootInfo info = cached_root_info<M>();
+    if (n > 1 && (info.max_log == 0 || std::countr_zero(n) > static_cast<int>(info.max_log))) {
+      throw NttSizeException{};
+    }
+    std::vector<Modint<M>> roots(std::max<std::size_t>(n, 2));
+    for (std::size_t h = 1; h < n; h *= 2) {
+      Modint<M> w = Modint<M>{ info.generator }.pow((p - 1) / (2 * h));
+      if (inverse) w = w.inverse();
+      roots[h] = Modint<M>{ 1 };
+      for (std::size_t j = 1; j < h; ++j) roots[h + j] = roots[h + j - 1] * w;
+    }
+    return roots;
+  }
+
+  // all layers with half size <= top_h of one block of `size` elements, `dit_block` goes the other way
+  template<typename M> void dif_block(Modint<M> *a, std::size_t size, std::size_t top_h, const Modint<M> *roots)
+  {
+    for (std::size_t h = top_h; h >= 1; h /= 2) {
+      for (std::size_t i = 0; i < size; i += 2 * h) dif_run(a + i, h, roots + h, 0, h);
+    }
+  }
+
+  template<typename M> void dit_block(Modint<M> *a, std::size_t size, std::size_t top_h, const Modint<M> *roots)
+  {
+    for (std::size_t h = 1; h <= top_h; h *= 2) {
+      for (std::size_t i = 0; i < size; i += 2 * h) dit_run(a + i, h, roots + h, 0, h);
+    }
+  }
+
+  // a wide layer, each butterfly group is cut into slices of `block / 2` so threads can share it
+  template<typename M, typename Run>
+  void wide_layer(Modint<M> *a, std::size_t n, std::size_t h, const Modint<M> *roots, std::uint32_t threads, Run run)
+  {
+    const std::size_t slice = block / 2;
+    const std::size_t per_group = h / slice;
+    parallel_for(n / (2 * h) * per_group, threads, [&](std::size_t s) {
+      const std::size_t i = s / per_group * 2 * h;
+      const std::size_t j = s % per_group * slice;
+      run(a + i, h, roots + h, j, j + slice);
+    });
+  }
+
+}// namespace ntt_detail
+
+// forward transform in place, the size is a power of two, the output is in bit reversed order
+template<typename M> void ntt(std::span<Modint<M>> a, std::uint32_t threads = 1)
+{
+  const std::size_t n = a.size();
+  if (n <= 1) return;
+  const auto roots = ntt_detail::twiddles<M>(n, false);
+  if (n < ntt_detail::parallel_threshold) threads = 1;
+  std::size_t h = n / 2;
+  for (; h >= ntt_detail::block; h /= 2) {
+    ntt_detail::wide_layer(a.data(), n, h, roots.data(), threads, [](auto... args) { ntt_detail::dif_run(args...); });
+  }
+  const std::size_t size = 2 * h;
+  ntt_detail::parallel_for(n / size, threads, [&](std::size_t b) {
+    ntt_detail::dif_block(a.data() + b * size, size, h, roots.data());
+  });
+}
+
+// inverse of `ntt`, bit reversed order in, natural order out, divided by the size
+template<typename M> void inverse_ntt(std::span<Modint<M>> a, std::uint32_t threads = 1)
+{
+  const std::size_t n = a.size();
+  if (n <= 1) return;
+  const auto roots = ntt_detail::twiddles<M>(n, true);
+  if (n < ntt_detail::parallel_threshold) threads = 1;
+  const std::size_t size = std::min(n, ntt_detail::block);
+  ntt_detail::parallel_for(n / size, threads, [&](std::size_t b) {
+    ntt_detail::dit_block(a.data() + b * size, size, size / 2, roots.data());
+  });
+  for (std::size_t h = size; h < n; h *= 2) {
+    ntt_detail::wide_layer(a.data(), n, h, roots.data(), threads, [](auto... args) { ntt_detail::dit_run(args...); });
+  }
+  const Modint<M> n_inv = Modint<M>{ n }.inverse();
+  for (auto &x : a) x *= n_inv;
+}
+
+namespace ntt_detail {
+
+  template<typename M> Polynomial<M> naive_convolution(PolynomialView<M> a, PolynomialView<M> b)
+  {
+    Polynomial<M> out(a.size() + b.size() - 1);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      for (std::size_t j = 0; j < b.size(); ++j) out[i + j] += a[i] * b[j];
+    }
+    return out;
+  }
+
+  // the modulus itself is ntt friendly
+  template<typename M>
+  Polynomial<M> ntt_convolution(PolynomialView<M> a, PolynomialView<M> b, std::uint32_t threads)
+  {
+    const std::size_t size = a.size() + b.size() - 1;
+    const std::size_t n = std::bit_ceil(size);
+    Polynomial<M> fa(a.begin(), a.end()), fb(b.begin(), b.end());
+    fa.resize(n);
+    fb.resize(n);
+    ntt<M>(fa, threads);
+    ntt<M>(fb, threads);
+    for (std::size_t i = 0; i < n; ++i) fa[i] *= fb[i];
+    inverse_ntt<M>(fa, threads);
+    fa.resize(size);
+    return fa;
+  }
+
+  // three primes whose product is about 2^86, each supports transforms of size 2^24
+  inline constexpr std::uint64_t crt_p1 = 167772161;// 5 * 2^25 + 1
+  inline constexpr std::uint64_t crt_p2 = 469762049;// 7 * 2^26 + 1
+  inline constexpr std::uint64_t crt_p3 = 754974721;// 45 * 2^24 + 1
+
+  template<std::uint64_t P> std::vector<StaticModint<P>> residues(std::span<const std::uint64_t> a)
+  {
+    return std::vector<StaticModint<P>>(a.begin(), a.end());
+  }
+
+}// namespace ntt_detail
+
+// a * b mod `mod` for any modulus, through three ntt primes and garner's crt
+// exact while min(|a|, |b|) * (mod - 1)^2 < 167772161 * 469762049 * 754974721 (~ 2^85.7),
+// e.g. any 32bit modulus with |a|, |b| up to 2^21; throws `NttSizeException` past that
+inline std::vector<std::uint64_t> convolution_mod(std::span<const std::uint64_t> a, std::span<const std::uint64_t> b,
+  std::uint64_t mod, std::uint32_t threads = 1)
+{
+  using namespace ntt_detail;
+  if (a.empty() || b.empty()) return {};
+  const uint128_t bound = static_cast<uint128_t>(crt_p1 * crt_p2) * crt_p3;
+  const uint128_t worst = static_cast<uint128_t>(mod - 1) * (mod - 1);
+  if (mod - 1 != 0 && bound / worst < std::min(a.size(), b.size())) throw NttSizeException{};
+  const auto c1 = ntt_convolution<StaticModulus<crt_p1>>(residues<crt_p1>(a), residues<crt_p1>(b), threads);
+  const auto c2 = ntt_convolution<StaticModulus<crt_p2>>(residues<crt_p2>(a), residues<crt_p2>(b), threads);
+  const auto c3 = ntt_convolution<StaticModulus<crt_p3>>(residues<crt_p3>(a), residues<crt_p3>(b), threads);
+  const auto p1_inv = StaticModint<crt_p2>{ crt_p1 }.inverse();
+  const auto p12_inv = StaticModint<crt_p3>{ crt_p1 * crt_p2 }.inverse();
+  std::vector<std::uint64_t> out(c1.size());
+  for (std::size_t i = 0; i < out.size(); ++i) {
+    // x = r1 + p1 t2 + p1 p2 t3, each t below its prime
+    const std::uint64_t r1 = c1[i].value();
+    const std::uint64_t t2 = ((c2[i] - r1) * p1_inv).value();
+    const std::uint64_t x12 = r1 + crt_p1 * t2;
+    const std::uint64_t t3 = ((c3[i] - x12) * p12_inv).value();
+    out[i] = static_cast<std::uint64_t>((x12 + static_cast<uint128_t>(crt_p1 * crt_p2) * t3) % mod);
+  }
+  return out;
+}
+
+// a * b, through a direct ntt when the modulus allows it, `convolution_mod` otherwise
+template<typename M>
+Polynomial<M> convolution(PolynomialView<M> a, PolynomialView<M> b, std::uint32_t threads = 1)
+{
+  if (a.empty() || b.empty()) return {};
+  if (std::min(a.size(), b.size()) <= ntt_detail::naive_threshold) return ntt_detail::naive_convolution(a, b);
+  const std::size_t n = std::bit_ceil(a.size() + b.size() - 1);
+  if (static_cast<std::size_t>(std::countr_zero(n)) <= ntt_detail::cached_root_info<M>().max_log) {
+    return ntt_detail::ntt_convolution(a, b, threads);
+  }
+  std::vector<std::uint64_t> va, vb;
+  for (auto x : a) va.push_back(x.value());
+  for (auto x : b) vb.push_back(x.value());
+  const auto c = convolution_mod(va, vb, Modint<M>::modulus(), threads);
+  return Polynomial<M>(c.begin(), c.end());
+}
+
+template<typename M>
+Polynomial<M> convolution(const Polynomial<M> &a, const Polynomial<M> &b, std::uint32_t threads = 1)
+{
+  return convolution<M>(std::span{ a }, std::span{ b }, threads);
+}
+
+// power series are vectors of coefficients, `n` is how many terms of the result are wanted
+// the series functions divide by small integers, so the modulus should be a prime above n
+
+// 1 / a mod x^n, newton: b <- b (2 - a b), a[0] has to be invertible
+template<typename M> Polynomial<M> series_inverse(const Polynomial<M> &a, std::size_t n)
+{
+  if (a.empty()) throw NotInvertibleException{};
+  Polynomial<M> b{ a[0].inverse() };
+  for (std::size_t k = 1; k < n; k *= 2) {
+    const Polynomial<M> prefix(a.begin(), a.begin() + static_cast<std::ptrdiff_t>(std::min(a.size(), 2 * k)));
+    auto ab = convolution(prefix, b);
+    ab.resize(2 * k);
+    for (auto &x : ab) x = -x;
+    ab[0] += 2;
+    b = convolution(b, ab);
+    b.resize(2 * k);
+  }
+  b.resize(n);
+  return b;
+}
+
+namespace ntt_detail {
+
+  // 1 / i for i in [1, n), the linear recurrence only works mod a prime
+  template<typename M> Polynomial<M> inverses(std::size_t n)
+  {
+    const std::uint64_t p = Modint<M>::modulus();
+    Polynomial<M> inv(std::max<std::size_t>(n, 2));
+    inv[1] = 1;
+    for (std::size_t i = 2; i < n; ++i) inv[i] = -Modint<M>{ p / i } * inv[p % i];
+    return inv;
+  }
+
+}// namespace ntt_detail
+
+// log a mod x^n = integral of a' / a, a[0] has to be 1
+template<typename M> Polynomial<M> series_log(const Polynomial<M> &a, std::size_t n)
+{
+  if (a.empty() || a[0] != Modint<M>{ 1 }) throw SeriesDomainException{};
+  if (n == 0) return {};
+  Polynomial<M> derivative(std::max<std::size_t>(std::min(a.size(), n + 1), 2) - 1);
+  for (std::size_t i = 1; i < std::min(a.size(), n + 1); ++i) derivative[i - 1] = a[i] * i;
+  auto quotient = convolution(derivative, series_inverse(a, n));
+  const auto inv = ntt_detail::inverses<M>(n);
+  Polynomial<M> out(n);
+  for (std::size_t i = 1; i < n; ++i) out[i] = quotient[i - 1] * inv[i];
+  return out;
+}
+
+// exp a mod x^n, newton: g <- g (1 - log g + a), a[0] has to be 0
+template<typename M> Polynomial<M> series_exp(const Polynomial<M> &a, std::size_t n)
+{
+  if (!a.empty() && a[0] != Modint<M>{}) throw SeriesDomainException{};
+  Polynomial<M> g{ 1 };
+  for (std::size_t k = 1; k < n; k *= 2) {
+    auto step = series_log(g, 2 * k);
+    for (auto &x : step) x = -x;
+    for (std::size_t i = 0; i < std::min(a.size(), 2 * k); ++i) step[i] += a[i];
+    step[0] += 1;
+    g = convolution(g, step);
+    g.resize(2 * k);
+  }
+  g.resize(n);
+  return g;
+}
+
+// a mod b for polynomials, b's leading coefficient has to be invertible
+template<typename M> Polynomial<M> polynomial_mod(const Polynomial<M> &a, const Polynomial<M> &b)
+{
+  if (a.size() < b.size()) return a;
+  const std::size_t q_size = a.size() - b.size() + 1;
+  // reversed, the quotient is a power series division
+  Polynomial<M> ra(a.rbegin(), a.rend()), rb(b.rbegin(), b.rend());
+  ra.resize(q_size);
+  auto q = convolution(ra, series_inverse(rb, q_size));
+  q.resize(q_size);
+  std::reverse(q.begin(), q.end());
+  const auto qb = convolution(q, b);
+  Polynomial<M> out(b.size() - 1);
+  for (std::size_t i = 0; i < out.size(); ++i) out[i] = a[i] - qb[i];
+  return out;
+}
+
+// a(x) for every x in `points`, subproduct tree then remainder tree, O(n log^2 n)
+template<typename M>
+Polynomial<M> multipoint_evaluate(const Polynomial<M> &a, const Polynomial<M> &points)
+{
+  const std::size_t m = points.size();
+  Polynomial<M> out(m);
+  if (m == 0) return out;
+  const auto horner = [&](const Polynomial<M> &poly, Modint<M> x) {
+    Modint<M> value;
+    for (std::size_t i = poly.size(); i-- > 0;) value = value * x + poly[i];
+    return value;
+  };
+  // tree[v] = product of (x - p) over the points below node v, leaves in order
+  std::vector<Polynomial<M>> tree(2 * std::bit_ceil(m));
+  const auto build = [&](auto &self, std::size_t v, std::size_t lo, std::size_t hi) -> void {
+    if (hi - lo == 1) {
+      tree[v] = { -points[lo], Modint<M>{ 1 } };
+      return;
+    }
+    const std::size_t mid = (lo + hi) / 2;
+    self(self, 2 * v, lo, mid);
+    self(self, 2 * v + 1, mid, hi);
+    tree[v] = convolution(tree[2 * v], tree[2 * v + 1]);
+  };
+  build(build, 1, 0, m);
+  const auto descend = [&](auto &self, std::size_t v, std::size_t lo, std::size_t hi, Polynomial<M> r) -> void {
+    r = polynomial_mod(r, tree[v]);
+    // small nodes are cheaper by horner than by more divisions
+    if (hi - lo <= ntt_detail::naive_threshold) {
+      for (std::size_t i = lo; i < hi; ++i) out[i] = horner(r, points[i]);
+      return;
+    }
+    const std::size_t mid = (lo + hi) / 2;
+    self(self, 2 * v, lo, mid, r);
+    self(self, 2 * v + 1, mid, hi, std::move(r));
+  };
+  descend(descend, 1, 0, m, a);
+  return out;
+}
+
+}// namespace ivl::nt
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <ivl/factorize.hpp>
+#include <ivl/instrument.hpp>
+#include <ivl/modint.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace ivl::nt {
+
+namespace pollard_rho {
+
+  // lives in modint.hpp now
+  using ::ivl::nt::Montgomery64;
+
+  // deterministic for every 64bit `n`
+  // bases from https://miller-rabin.appspot.com/ (Jim Sinclair)
+  constexpr bool is_prime(std::uint64_t n)
+  {
+    if (n < 2) return false;
+    for (std::uint64_t p : { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 }) {
+      if (n % p == 0) return n == p;
+    }
+    if (n < 41 * 41) return true;
+    const Montgomery64 mont{ n };
+    const std::uint32_t s = static_cast<std::uint32_t>(std::countr_zero(n - 1));
+    const std::uint64_t d = (n - 1) >> s;
+    const std::uint64_t one = mont.one();
+    const std::uint64_t minus_one = mont.sub(0, one);
+    for (std::uint64_t a : { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 }) {
+      if (a % n == 0) continue;
+      std::uint64_t x = mont.pow(mont.to(a), d);
+      if (x == one || x == minus_one) continue;
+      bool composite = true;
+      for (std::uint32_t i = 1; i < s && composite; ++i) {
+        x = mont.mul(x, x);
+        if (x == minus_one) composite = false;
+      }
+      if (composite) return false;
+    }
+    return true;
+  }
+
+  static_assert(is_prime(2) && is_prime(998244353) && is_prime(18446744073709551557ULL));
+  static_assert(!is_prime(1) && !is_prime(561) && !is_prime(3215031751) && !is_prime(4294967297ULL));
+
+  // nontrivial factor of an odd composite `n`
+  // brent's cycle finding, gcds are batched over `batch` steps
+  // and redone one by one if the batch overshoots
+  constexpr std::uint64_t find_factor(std::uint64_t n)
+  {
+    if (n % 2 == 0) return 2;
+    const Montgomery64 mont{ n };
+    constexpr std::uint64_t batch = 128;
+    const auto distance = [](std::uint64_t a, std::uint64_t b) { return a > b ? a - b : b - a; };
+    std::uint64_t steps = 0;
+    for (std::uint64_t c = 1;; ++c) {
+      const std::uint64_t c_mont = mont.to(c);
+      const auto f = [&](std::uint64_t v) {
+        ++steps;
+        return mont.add(mont.mul(v, v), c_mont);
+      };
+      std::uint64_t x = 0;
+      std::uint64_t y = mont.to(2);
+      std::uint64_t ys = y;
+      std::uint64_t q = mont.one();
+      std::uint64_t g = 1;
+      for (std::uint64_t r = 1; g == 1; r *= 2) {
+        x = y;
+        for (std::uint64_t i = 0; i < r; ++i) y = f(y);
+        for (std::uint64_t k = 0; k < r && g == 1; k += batch) {
+          ys = y;
+          for (std::uint64_t i = 0; i < std::min(batch, r - k); ++i) {
+            y = f(y);
+            q = mont.mul(q, distance(x, y));
+          }
+          // montgomery form doesn't change the gcd, 2^64 is coprime to `n`
+          g = std::gcd(q, n);
+        }
+      }
+      if (g == n) {
+        do {
+          ys = f(ys);
+          g = std::gcd(distance(x, ys), n);
+        } while (g == 1);
+      }
+      if (g != n) {
+        instrument::add(instrument::Counter::rho_iterations, steps);
+        instrument::observe(instrument::Histogram::rho_iterations, steps);
+        return g;
+      }
+    }
+  }
+
+  // a 64bit number has at most 63 prime factors counted with multiplicity,
+  // so they fit in place, no allocation
+  struct PrimeFactors
+  {
+    std::array<std::uint64_t, 64> values{};
+    std::size_t size = 0;
+
+    constexpr void push_back(std::uint64_t p) { values[size++] = p; }
+  };
+
+  // `out` is a `PrimeFactors` or a `std::vector<std::uint64_t>`
+  template<typename Out> constexpr void collect_prime_factors(std::uint64_t n, Out &out)
+  {
+    if (n == 1) return;
+    if (is_prime(n)) {
+      out.push_back(n);
+      return;
+    }
+    const std::uint64_t d = find_factor(n);
+    collect_prime_factors(d, out);
+    collect_prime_factors(n / d, out);
+  }
+
+}// namespace pollard_rho
+
+struct PollardRhoStrategy
+{
+};
+
+// factorize(n, pollard_rho_strategy)
+inline constexpr PollardRhoStrategy pollard_rho_strategy{};
+
+// trial division by tiny primes, then miller-rabin + pollard-rho on what remains
+template<typename T, typename ET = ExponentType, typename F = Factorization<T, ET>>
+  requires std::integral<T> && (sizeof(T) <= sizeof(std::uint64_t))
+constexpr F factorize(T n, PollardRhoStrategy)
+{
+  if (n == T{ 0 }) throw ZeroFactorizationException{};
+  // through uint64 so that the minimum of a signed type doesn't overflow
+  auto m = static_cast<std::uint64_t>(n);
+  if (n < T{ 0 }) m = 0 - m;
+  pollard_rho::PrimeFactors primes;
+  std::uint64_t p = 2;
+  for (; p < 64 && p * p <= m; ++p) {
+    while (m % p == 0) {
+      primes.push_back(p);
+      m /= p;
+    }
+  }
+  instrument::add(instrument::Counter::factorizations);
+  instrument::add(instrument::Counter::trial_divisions, p - 2);
+  pollard_rho::collect_prime_factors(m, primes);
+  std::sort(primes.values.begin(), primes.values.begin() + static_cast<std::ptrdiff_t>(primes.size));
+  F factorization;
+  for (std::size_t i = 0, j = 0; i < primes.size; i = j) {
+    while (j < primes.size && primes.values[j] == primes.values[i]) ++j;
+    append_factor(factorization, static_cast<T>(primes.values[i]), static_cast<ET>(j - i));
+  }
+  return factorization;
+}
+
+static_assert(factorize<int, std::uint32_t>(2100, pollard_rho_strategy)
+              == std::vector<std::pair<int, std::uint32_t>>{ { 2, 2 }, { 3, 1 }, { 5, 2 }, { 7, 1 } });
+static_assert(factorize<std::uint64_t, std::uint32_t>(4295098369ULL, pollard_rho_strategy)
+              == std::vector<std::pair<std::uint64_t, std::uint32_t>>{ { 65537, 2 } });
+
+}// namespace ivl::nt
@@ -0,0 +1,402 @@
+#pragma once
+
+// pi(x) and the sum of primes up to x, without listing the primes
+// small x goes through lucy's dp (`prime_power_sums`), O(x^(3/4) / log x) time and O(sqrt(x)) memory
+// large x uses meissel's formula with y = cbrt(x):
+//   pi(x) = phi(x, a) + a - 1 - P2(x, a),   a = pi(y)
+// phi(x, a) counts n <= x without prime factors <= y, P2 counts the products pq <= x with y < p <= q
+// both only ever ask for pi(v) with v <= x^(2/3), which comes from one sieved table
+
+#include <ivl/int128.hpp>
+#include <ivl/primes.hpp>
+#include <ivl/summatory.hpp>
+#include <ivl/wheel.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ivl::nt {
+
+class PrimeCountMemoryException : public std::exception
+{
+public:
+  virtual const char *what() const noexcept override { return "prime counting would need more memory than allowed"; }
+};
+
+namespace prime_count_detail {
+
+  // below this lucy is faster than building the x^(2/3) table
+  inline constexpr std::uint64_t lucy_limit = 3'000'000'000;
+
+  // first primes, the wheel of their product takes care of the top of the phi recursion
+  inline constexpr std::array<std::uint32_t, 6> wheel_primes{ 2, 3, 5, 7, 11, 13 };
+
+  constexpr std::uint64_t icbrt(std::uint64_t n)
+  {
+    std::uint64_t r = 0;
+    for (std::uint64_t bit = std::uint64_t{ 1 } << 21; bit; bit >>= 1) {
+      const std::uint64_t c = r | bit;
+      if (c * c <= n / c) r = c;
+    }
+    return r;
+  }
+
+  static_assert(icbrt(0) == 0 && icbrt(26) == 2 && icbrt(27) == 3 && icbrt(18446744073709551615ULL) == 2642245);
+
+  // what meissel works with for a given x
+  struct Plan
+  {
+    std::uint64_t y;// cbrt(x)
+    std::uint64_t table_limit;// every pi(v) asked for has v <= table_limit
+  };
+
+  inline Plan plan(std::uint64_t x)
+  {
+    const std::uint64_t y = icbrt(x);
+    // the phi leaves go up to (smallest prime > y)^2, which is below (2y)^2
+    return { y, std::max(x / y, std::min(x, 4 * y * y)) };
+  }
+
+  // sieve of [0, limit] as mod 30 bits (`SegmentedSieve` layout), with the number of primes
+  // (and their sum, if `Sums`) before every 64bit word, so pi(v) is a prefix plus a popcount
+  template<bool Sums> class PrimeTable
+  {
+  private:
+    // bits of a byte whose residues are <= r
+    static constexpr std::array<std::uint8_t, 30> up_to = [] {
+      std::array<std::uint8_t, 30> out{};
+      for (std::uint32_t r = 0; r < 30; ++r) {
+        for (std::uint32_t i = 0; i < 8; ++i) {
+          if (wheel30::residues[i] <= r) out[r] |= static_cast<std::uint8_t>(1U << i);
+        }
+      }
+      return out;
+    }();
+
+    std::uint64_t m_limit;
+    std::vector<std::uint64_t> m_words;
+    std::vector<std::uint64_t> m_counts;
+    std::vector<uint128_t> m_sums;
+
+    // bits of word `v / 240` that are <= v
+    static std::uint64_t mask(std::uint64_t v)
+    {
+      const auto shift = 8 * (v / 30 % 8);
+      return ((std::uint64_t{ 1 } << shift) - 1) | (std::uint64_t{ up_to[v % 30] } << shift);
+    }
+
+  public:
+    static constexpr std::size_t bytes_per_word = 8 + 8 + (Sums ? 16 : 0);
+
+    static std::size_t memory(std::uint64_t limit)
+    {
+      return static_cast<std::size_t>(limit / 240 + 1) * bytes_per_word;
+    }
+
+    PrimeTable(std::uint64_t limit, std::uint32_t threads) : m_limit(limit)
+    {
+      const auto words = static_cast<std::size_t>(limit / 240 + 1);
+      m_words.assign(words, 0);
+      const auto base = sieving_primes(limit);
+      const auto sieve_chunk = [&](std::uint64_t lo, std::uint64_t hi) {
+        // chunks start at multiples of 240, so they never share a word
+        SegmentedSieve sieve{ std::max<std::uint64_t>(lo, 7), hi, base };
+        while (sieve.next_segment()) {
+          const auto bytes = sieve.segment();
+          const auto first = static_cast<std::size_t>(sieve.segment_base());
+          std::memcpy(reinterpret_cast<std::uint8_t *>(m_words.data()) + first,
+            bytes.data(),
+            std::min(bytes.size(), words * 8 - first));
+        }
+      };
+      if (threads <= 1) {
+        sieve_chunk(0, limit);
+      } else {
+        sieve_detail::parallel_chunks(0, limit, threads, sieve_chunk);
+      }
+
+      m_counts.resize(words);
+      if constexpr (Sums) m_sums.resize(words);
+      std::uint64_t count = 3;
+      uint128_t sum = 10;
+      for (std::size_t w = 0; w < words; ++w) {
+        m_counts[w] = count;
+        count += static_cast<std::uint64_t>(std::popcount(m_words[w]));
+        if constexpr (Sums) {
+          m_sums[w] = sum;
+          for (std::uint64_t word = m_words[w]; word; word &= word - 1) {
+            const auto bit = static_cast<std::uint32_t>(std::countr_zero(word));
+            sum += 240 * w + 30 * (bit / 8) + wheel30::residues[bit % 8];
+          }
+        }
+      }
+    }
+
+    std::uint64_t limit() const { return m_limit; }
+
+    // number of primes <= v, v <= limit
+    std::uint64_t pi(std::uint64_t v) const
+    {
+      if (v < 7) return v < 2 ? 0 : v < 3 ? 1 : v < 5 ? 2 : 3;
+      return m_counts[v / 240] + static_cast<std::uint64_t>(std::popcount(m_words[v / 240] & mask(v)));
+    }
+
+    // sum of primes <= v, v <= limit
+    uint128_t sum(std::uint64_t v) const
+      requires Sums
+    {
+      if (v < 7) return v < 2 ? 0 : v < 3 ? 2 : v < 5 ? 5 : 10;
+      uint128_t out = m_sums[v / 240];
+      for (std::uint64_t word = m_words[v / 240] & mask(v); word; word &= word - 1) {
+        const auto bit = static_cast<std::uint32_t>(std::countr_zero(word));
+        out += v / 240 * 240 + 30 * (bit / 8) + wheel30::residues[bit % 8];
+      }
+      return out;
+    }
+  };
+
+  // phi(n, a): n' <= n without any of the first a primes as a factor, counted (or summed, if `Sums`)
+  template<bool Sums> class Phi
+  {
+  public:
+    using Value = std::conditional_t<Sums, int128_t, std::int64_t>;
+
+  private:
+    const PrimeTable<Sums> &m_table;
+    std::span<const std::uint32_t> m_primes;
+    // sum of the first k primes (or just k)
+    std::vector<Value> m_weights;
+
+    // for the wheel of the first a <= 6 primes with product M:
+    // numbers in [1, r] coprime to M, counted and summed, r in [0, M]
+    struct Wheel
+    {
+      std::uint64_t modulus;
+      std::vector<std::uint32_t> counts;
+      std::vector<std::uint64_t> sums;
+    };
+    std::vector<Wheel> m_wheels;
+
+    // phi(n, a) for small n and wheel_size < a <= cache_primes, as bits of the numbers that are left
+    // with the count (and sum) before every word, the recursion ends up here most of the time
+    static constexpr std::uint64_t cache_limit = 1 << 18;
+    static constexpr std::size_t cache_primes = 64;
+    struct CacheRow
+    {
+      std::vector<std::uint64_t> bits;
+      std::vector<std::uint32_t> counts;
+      std::vector<std::uint64_t> sums;
+    };
+    std::vector<CacheRow> m_cache;
+
+    Value cached(std::uint64_t n, std::size_t a) const
+    {
+      const auto &row = m_cache[a - wheel_size - 1];
+      const std::uint64_t word = row.bits[n / 64] & ((std::uint64_t{ 2 } << (n % 64)) - 1);
+      if constexpr (Sums) {
+        Value out = row.sums[n / 64];
+        for (std::uint64_t w = word; w; w &= w - 1) out += static_cast<Value>(n / 64 * 64 + std::countr_zero(w));
+        return out;
+      }
+      return row.counts[n / 64] + std::popcount(word);
+    }
+
+    Value weight(std::uint64_t p) const
+    {
+      if constexpr (Sums) return static_cast<Value>(p);
+      return 1;
+    }
+
+    Value wheel(std::uint64_t n, std::size_t a) const
+    {
+      const auto &w = m_wheels[a];
+      const std::uint64_t q = n / w.modulus;
+      const auto r = static_cast<std::size_t>(n % w.modulus);
+      if constexpr (Sums) {
+        // block k contributes k M phi(M) + (sum of coprimes in [1, M])
+        const Value m = static_cast<Value>(w.modulus);
+        const Value vq = static_cast<Value>(q);
+        return m * w.counts.back() * (vq * (vq - 1) / 2) + vq * w.sums.back() + vq * m * w.counts[r] + w.sums[r];
+      }
+      return static_cast<Value>(q * w.counts.back() + w.counts[r]);
+    }
+
+  public:
+    Phi(const PrimeTable<Sums> &table, std::span<const std::uint32_t> primes) : m_table(table), m_primes(primes)
+    {
+      m_weights.push_back(0);
+      for (std::uint64_t p : primes) m_weights.push_back(m_weights.back() + weight(p));
+      std::uint64_t modulus = 1;
+      for (std::size_t a = 0; a <= wheel_primes.size(); ++a) {
+        if (a > 0) modulus *= wheel_primes[a - 1];
+        Wheel w{ modulus, { 0 }, { 0 } };
+        for (std::uint64_t r = 1; r <= modulus; ++r) {
+          bool coprime = true;
+          for (std::size_t i = 0; i < a; ++i) coprime = coprime && r % wheel_primes[i] != 0;
+          w.counts.push_back(w.counts.back() + coprime);
+          w.sums.push_back(w.sums.back() + (coprime ? r : 0));
+        }
+        m_wheels.push_back(std::move(w));
+      }
+
+      std::vector<std::uint64_t> bits(cache_limit / 64, 0);
+      for (std::uint64_t v = 1; v < cache_limit; ++v) {
+        if (std::gcd(v, modulus) == 1) bits[v / 64] |= std::uint64_t{ 1 } << (v % 64);
+      }
+      for (std::size_t a = wheel_size + 1; a <= std::min(cache_primes, primes.size()); ++a) {
+        const std::uint64_t p = primes[a - 1];
+        for (std::uint64_t v = p; v < cache_limit; v += p) bits[v / 64] &= ~(std::uint64_t{ 1 } << (v % 64));
+        CacheRow row{ bits, {}, {} };
+        std::uint32_t count = 0;
+        std::uint64_t sum = 0;
+        for (std::size_t w = 0; w < bits.size(); ++w) {
+          row.counts.push_back(count);
+          count += static_cast<std::uint32_t>(std::popcount(bits[w]));
+          if constexpr (Sums) {
+            row.sums.push_back(sum);
+            for (std::uint64_t word = bits[w]; word; word &= word - 1) {
+              sum += 64 * w + std::uint64_t(std::countr_zero(word));
+            }
+          }
+        }
+        m_cache.push_back(std::move(row));
+      }
+    }
+
+    static constexpr std::size_t wheel_size = wheel_primes.size();
+
+    // a < primes.size(), past the wheel it reads primes[a]
+    Value operator()(std::uint64_t n, std::size_t a) const
+    {
+      if (a <= wheel_size) return wheel(n, a);
+      if (n < cache_limit && a <= wheel_size + m_cache.size()) return cached(n, a);
+      // only 1 is left
+      if (n < m_primes[a]) return n >= 1 ? 1 : 0;
+      // 1 and the primes in (primes[a - 1], n]
+      if (n / m_primes[a] < m_primes[a]) {
+        if constexpr (Sums) return 1 + static_cast<Value>(m_table.sum(n)) - m_weights[a];
+        return 1 + static_cast<Value>(m_table.pi(n)) - static_cast<Value>(a);
+      }
+      // phi(n, a) = phi(n, i) - sum over i < a of w(p_i) phi(n / p_i, i)
+      Value out = wheel(n, wheel_size);
+      for (std::size_t i = wheel_size; i < a; ++i) {
+        const std::uint64_t m = n / m_primes[i];
+        if (m < m_primes[i]) {
+          // phi(m, i) = 1 from here on
+          out -= m_weights[a] - m_weights[i];
+          break;
+        }
+        out -= weight(m_primes[i]) * (*this)(m, i);
+      }
+      return out;
+    }
+
+    // w(p_i) phi(n / p_i, i), the terms the top level subtracts for i >= wheel_size
+    Value top(std::uint64_t n, std::size_t i) const { return weight(m_primes[i]) * (*this)(n / m_primes[i], i); }
+    Value prefix_weight(std::size_t k) const { return m_weights[k]; }
+  };
+
+  // `job(i)` for i in [begin, end), handed out one at a time, results summed up
+  template<typename Value, typename F>
+  Value parallel_sum(std::size_t begin, std::size_t end, std::uint32_t threads, F &&job)
+  {
+    std::atomic<std::size_t> next{ begin };
+    std::vector<Value> partial(std::max<std::uint32_t>(threads, 1), Value{ 0 });
+    const auto worker = [&](std::uint32_t t) {
+      for (std::size_t i; (i = next.fetch_add(1)) < end;) partial[t] += job(i);
+    };
+    {
+      std::vector<std::jthread> pool;
+      for (std::uint32_t t = 1; t < partial.size(); ++t) pool.emplace_back(worker, t);
+      worker(0);
+    }
+    Value out{ 0 };
+    for (auto v : partial) out += v;
+    return out;
+  }
+
+  // meissel, see the top of the file
+  template<bool Sums> auto meissel(std::uint64_t x, std::uint32_t threads)
+  {
+    using Value = typename Phi<Sums>::Value;
+    const auto [y, table_limit] = plan(x);
+    const PrimeTable<Sums> table{ table_limit, threads };
+
+    // every prime <= sqrt(x), and one past y for phi to read (bertrand puts one in (y, 2y]),
+    // for large x that is the same list
+    std::vector<std::uint32_t> primes{ 2, 3, 5 };
+    const auto rest = sieving_primes(std::max(x, (2 * y + 1) * (2 * y + 1)));
+    primes.insert(primes.end(), rest.begin(), rest.end());
+    const Phi<Sums> phi{ table, primes };
+    const std::size_t a = table.pi(y);
+    const auto b = static_cast<std::size_t>(std::upper_bound(primes.begin(), primes.end(), isqrt(x)) - primes.begin());
+
+    // phi(x, a) = phi(x, 6) - sum of w(p_i) phi(x / p_i, i) over 6 <= i < a, one term per job
+    const auto top = [&](std::size_t i) { return phi.top(x, i); };
+    const Value phi_x = phi(x, Phi<Sums>::wheel_size) - parallel_sum<Value>(Phi<Sums>::wheel_size, a, threads, top);
+
+    // P2: p_k q with p_k, the k-th prime, in (y, sqrt(x)] and q in [p_k, x / p_k]
+    const Value p2 = parallel_sum<Value>(a, b, threads, [&](std::size_t k) -> Value {
+      const std::uint64_t v = x / primes[k];
+      if constexpr (Sums) {
+        return static_cast<Value>(primes[k]) * (static_cast<Value>(table.sum(v)) - phi.prefix_weight(k));
+      }
+      return static_cast<Value>(table.pi(v)) - static_cast<Value>(k);
+    });
+    return phi_x - 1 + phi.prefix_weight(a) - p2;
+  }
+
+}// namespace prime_count_detail
+
+// bytes `pi(x)` (or `prime_sum(x)`, with `sums = true`) is going to allocate, roughly
+// the big part is lucy's table of O(sqrt(x)) values, or meissel's x^(2/3) prime table
+inline std::size_t prime_count_memory(std::uint64_t x, bool sums = false)
+{
+  if (x <= prime_count_detail::lucy_limit) {
+    // ~2 sqrt(x) values, each stored with its floor(x / i)
+    return static_cast<std::size_t>(2 * isqrt(x) + 2) * (8 + (sums ? 16 : 8));
+  }
+  const auto plan = prime_count_detail::plan(x);
+  const std::size_t table = sums ? prime_count_detail::PrimeTable<true>::memory(plan.table_limit)
+                                 : prime_count_detail::PrimeTable<false>::memory(plan.table_limit);
+  // primes up to sqrt(x), 4 bytes each, and about as many prefix weights
+  const std::size_t primes = static_cast<std::size_t>(isqrt(x) / 4 + 64) * (4 + (sums ? 16 : 8));
+  return table + primes;
+}
+
+// number of primes <= x
+// throws `PrimeCountMemoryException` if `prime_count_memory(x)` is over `memory_limit` bytes,
+// before allocating anything
+inline std::uint64_t
+  pi(std::uint64_t x, std::uint32_t threads = 1, std::size_t memory_limit = std::numeric_limits<std::size_t>::max())
+{
+  if (prime_count_memory(x) > memory_limit) throw PrimeCountMemoryException{};
+  if (x == 0) return 0;
+  if (x <= prime_count_detail::lucy_limit) {
+    return static_cast<std::uint64_t>(prime_power_sums<std::int64_t>(x, 0, threads).at(x));
+  }
+  return static_cast<std::uint64_t>(prime_count_detail::meissel<false>(x, threads));
+}
+
+// sum of primes <= x, up to ~x^2 / (2 log x)
+inline uint128_t prime_sum(std::uint64_t x,
+  std::uint32_t threads = 1,
+  std::size_t memory_limit = std::numeric_limits<std::size_t>::max())
+{
+  if (prime_count_memory(x, true) > memory_limit) throw PrimeCountMemoryException{};
+  if (x == 0) return 0;
+  if (x <= prime_count_detail::lucy_limit) return prime_power_sums<uint128_t>(x, 1, threads).at(x);
+  return static_cast<uint128_t>(prime_count_detail::meissel<true>(x, threads));
+}
+
+}// namespace ivl::nt
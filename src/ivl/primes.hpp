@@ -0,0 +1,363 @@
+#pragma once
+
+#include <ivl/wheel.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace ivl::nt {
+
+// floor(sqrt(n)), exact for every 64bit `n`
+constexpr std::uint64_t isqrt(std::uint64_t n)
+{
+  // std::sqrt isn't constexpr, a rough start is fine at compile time
+  std::uint64_t r = std::is_constant_evaluated() ? std::uint64_t{ 1 } << (std::bit_width(n) / 2)
+                                                 : static_cast<std::uint64_t>(std::sqrt(static_cast<double>(n)));
+  // either way it can be off in both directions
+  while (r > 0 && (r > n / r)) --r;
+  while ((r + 1) <= n / (r + 1)) ++r;
+  return r;
+}
+
+static_assert(isqrt(0) == 0 && isqrt(15) == 3 && isqrt(16) == 4 && isqrt(18446744073709551615ULL) == 4294967295ULL);
+
+namespace sieve_detail {
+
+  // a prime p == r (mod 30) crosses off p * m for m coprime to 30
+  // with m == residues[i] (mod 30), that multiple sits at bit `mask` of its byte
+  // and the next multiple is `p / 30 * gaps[i] + byte_step` bytes further
+  struct WheelStep
+  {
+    std::uint8_t mask;
+    std::uint8_t byte_step;
+  };
+
+  inline constexpr std::array<std::array<WheelStep, 8>, 30> steps = [] {
+    std::array<std::array<WheelStep, 8>, 30> out{};
+    for (std::uint32_t r : wheel30::residues) {
+      for (std::uint32_t i = 0; i < 8; ++i) {
+        const std::uint32_t m = wheel30::residues[i];
+        const std::uint32_t next_m = m + wheel30::gaps[i];
+        out[r][i].mask = static_cast<std::uint8_t>(1U << wheel30::index[r * m % 30]);
+        out[r][i].byte_step = static_cast<std::uint8_t>(r * next_m / 30 - r * m / 30);
+      }
+    }
+    return out;
+  }();
+
+}// namespace sieve_detail
+
+// sieve of eratosthenes over [lo, hi], one segment at a time
+// a byte covers 30 numbers, bit i of byte k is 30k + wheel30::residues[i]
+// so 2, 3 and 5 are never part of a segment, users handle them separately
+//
+// `base_primes` has to hold every prime in [7, sqrt(hi)] (see `sieving_primes`)
+// and has to outlive the sieve
+class SegmentedSieve
+{
+public:
+  // fits in L1 on everything reasonable, covers ~1e6 numbers
+  static constexpr std::size_t default_segment_bytes = 32 * 1024;
+
+private:
+  struct BasePrime
+  {
+    std::uint64_t next_byte;
+    std::uint32_t quotient;// p / 30
+    std::uint8_t residue;// p % 30
+    std::uint8_t wheel_index;
+  };
+
+  std::uint64_t m_lo;
+  std::uint64_t m_hi;
+  std::uint64_t m_next_byte;
+  std::uint64_t m_last_byte;
+  std::vector<BasePrime> m_base;
+  std::vector<std::uint8_t> m_segment;
+  std::size_t m_segment_size;
+  std::uint64_t m_segment_base;
+
+public:
+  SegmentedSieve(std::uint64_t lo,
+    std::uint64_t hi,
+    std::span<const std::uint32_t> base_primes,
+    std::size_t segment_bytes = default_segment_bytes)
+    : m_lo(lo), m_hi(hi), m_next_byte(lo / 30), m_last_byte(hi / 30),
+      // rounded up to whole words, the padding stays zero
+      m_segment((std::max<std::size_t>(segment_bytes, 8) + 7) / 8 * 8, 0), m_segment_size(0), m_segment_base(0)
+  {
+    if (lo > hi) m_next_byte = m_last_byte + 1;
+    m_base.reserve(base_primes.size());
+    for (std::uint64_t p : base_primes) {
+      if (p * p > hi) break;
+      // first multiple worth crossing off is p * m, m >= p, m coprime to 30
+      std::uint64_t m = std::max(p, (lo + p - 1) / p);
+      std::uint8_t i = 0;
+      while (wheel30::residues[i] < m % 30) ++i;
+      m = m / 30 * 30 + wheel30::residues[i];
+      m_base.push_back({ p * m / 30, static_cast<std::uint32_t>(p / 30), static_cast<std::uint8_t>(p % 30), i });
+    }
+  }
+
+  // false once [lo, hi] is exhausted
+  bool next_segment()
+  {
+    if (m_next_byte > m_last_byte) return false;
+    m_segment_base = m_next_byte;
+    m_segment_size = static_cast<std::size_t>(std::min<std::uint64_t>(m_segment.size(), m_last_byte - m_next_byte + 1));
+    m_next_byte += m_segment_size;
+    const std::uint64_t end_byte = m_next_byte;
+
+    std::uint8_t *segment = m_segment.data();
+    std::memset(segment, 0xFF, m_segment_size);
+    std::memset(segment + m_segment_size, 0, m_segment.size() - m_segment_size);
+    for (auto &base : m_base) {
+      const auto &steps = sieve_detail::steps[base.residue];
+      std::uint64_t byte = base.next_byte;
+      std::uint8_t i = base.wheel_index;
+      while (byte < end_byte) {
+        segment[byte - m_segment_base] &= static_cast<std::uint8_t>(~steps[i].mask);
+        byte += std::uint64_t{ base.quotient } * wheel30::gaps[i] + steps[i].byte_step;
+        i = (i + 1) % 8;
+      }
+      base.next_byte = byte;
+      base.wheel_index = i;
+    }
+
+    // trim whatever sticks out of [lo, hi], and 1
+    const auto trim = [&](std::uint64_t byte, auto &&keep) {
+      if (byte < m_segment_base || byte >= end_byte) return;
+      for (std::uint32_t i = 0; i < 8; ++i) {
+        if (!keep(30 * byte + wheel30::residues[i])) {
+          segment[byte - m_segment_base] &= static_cast<std::uint8_t>(~(1U << i));
+        }
+      }
+    };
+    trim(m_lo / 30, [&](std::uint64_t v) { return v >= m_lo && v != 1; });
+    trim(m_last_byte, [&](std::uint64_t v) { return v <= m_hi; });
+    return true;
+  }
+
+  // padded with zeros to a whole number of 64bit words
+  std::span<const std::uint8_t> segment() const { return { m_segment.data(), (m_segment_size + 7) / 8 * 8 }; }
+
+  // byte index of `segment()[0]`, it covers [30 * segment_base(), 30 * segment_base() + 30)
+  std::uint64_t segment_base() const { return m_segment_base; }
+
+  // calls `f(p)` for every prime in the current segment, in increasing order
+  template<typename F> void for_each_in_segment(F &&f) const
+  {
+    const auto bytes = segment();
+    for (std::size_t w = 0; w < bytes.size(); w += 8) {
+      std::uint64_t word;
+      std::memcpy(&word, bytes.data() + w, 8);
+      while (word) {
+        const auto bit = static_cast<std::uint32_t>(std::countr_zero(word));
+        word &= word - 1;
+        f(30 * (m_segment_base + w + bit / 8) + wheel30::residues[bit % 8]);
+      }
+    }
+  }
+
+  std::uint64_t count_in_segment() const
+  {
+    const auto bytes = segment();
+    std::uint64_t out = 0;
+    for (std::size_t w = 0; w < bytes.size(); w += 8) {
+      std::uint64_t word;
+      std::memcpy(&word, bytes.data() + w, 8);
+      out += static_cast<std::uint64_t>(std::popcount(word));
+    }
+    return out;
+  }
+};
+
+// every prime in [7, sqrt(hi)], which is what `SegmentedSieve` needs for [lo, hi]
+// sieved with the segmented sieve itself, recursing on sqrt(sqrt(hi))
+inline std::vector<std::uint32_t> sieving_primes(std::uint64_t hi)
+{
+  const std::uint64_t root = isqrt(hi);
+  std::vector<std::uint32_t> out;
+  if (root < 7) return out;
+  const auto base = sieving_primes(root);
+  SegmentedSieve sieve{ 7, root, base };
+  while (sieve.next_segment()) {
+    sieve.for_each_in_segment([&](std::uint64_t p) { out.push_back(static_cast<std::uint32_t>(p)); });
+  }
+  return out;
+}
+
+// primes in [lo, hi], streamed in bounded memory:
+// the sieving primes up to sqrt(hi) plus one segment
+// single pass, like `std::ranges::istream_view`
+class PrimeRange
+{
+private:
+  std::uint64_t m_lo;
+  std::uint64_t m_hi;
+  std::vector<std::uint32_t> m_base_primes;
+  SegmentedSieve m_sieve;
+
+  // primes of the current segment, refilled one word at a time
+  std::uint64_t m_current;
+  std::uint32_t m_small_index;
+  std::size_t m_word_index;
+  std::uint64_t m_word;
+  bool m_done;
+
+  void advance()
+  {
+    static constexpr std::array<std::uint64_t, 3> small{ 2, 3, 5 };
+    while (m_small_index < small.size()) {
+      const auto p = small[m_small_index++];
+      if (m_lo <= p && p <= m_hi) {
+        m_current = p;
+        return;
+      }
+    }
+    while (m_word == 0) {
+      const auto bytes = m_sieve.segment();
+      if (m_word_index < bytes.size()) {
+        std::memcpy(&m_word, bytes.data() + m_word_index, 8);
+        m_word_index += 8;
+      } else if (m_sieve.next_segment()) {
+        m_word_index = 0;
+      } else {
+        m_done = true;
+        return;
+      }
+    }
+    const auto bit = static_cast<std::uint32_t>(std::countr_zero(m_word));
+    m_word &= m_word - 1;
+    m_current = 30 * (m_sieve.segment_base() + m_word_index - 8 + bit / 8) + wheel30::residues[bit % 8];
+  }
+
+public:
+  PrimeRange(std::uint64_t lo, std::uint64_t hi)
+    : m_lo(lo), m_hi(hi), m_base_primes(sieving_primes(hi)), m_sieve(std::max<std::uint64_t>(lo, 7), hi, m_base_primes),
+      m_current(0), m_small_index(0), m_word_index(0), m_word(0), m_done(false)
+  {}
+
+  // the sieve points into `m_base_primes`
+  PrimeRange(const PrimeRange &) = delete;
+  PrimeRange &operator=(const PrimeRange &) = delete;
+
+  class Iterator
+  {
+  private:
+    PrimeRange *m_parent;
+
+    bool at_end() const { return m_parent->m_done; }
+
+  public:
+    using iterator_concept = std::input_iterator_tag;
+    using value_type = std::uint64_t;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() : m_parent(nullptr) {}
+    explicit Iterator(PrimeRange &parent) : m_parent(&parent) {}
+
+    std::uint64_t operator*() const { return m_parent->m_current; }
+
+    Iterator &operator++()
+    {
+      m_parent->advance();
+      return *this;
+    }
+
+    void operator++(int) { ++*this; }
+
+    friend bool operator==(const Iterator &it, std::default_sentinel_t) { return it.at_end(); }
+  };
+
+  Iterator begin()
+  {
+    advance();
+    return Iterator{ *this };
+  }
+
+  std::default_sentinel_t end() const { return {}; }
+};
+
+// for (auto p : primes(lo, hi)) ...
+inline PrimeRange primes(std::uint64_t lo, std::uint64_t hi) { return PrimeRange{ lo, hi }; }
+
+namespace sieve_detail {
+
+  // [lo, hi] is cut into chunks of `chunk_segments` segments, handed out to threads dynamically
+  template<typename F>
+  void parallel_chunks(std::uint64_t lo, std::uint64_t hi, std::uint32_t threads, F &&per_chunk)
+  {
+    constexpr std::uint64_t chunk_segments = 64;
+    constexpr std::uint64_t chunk = chunk_segments * SegmentedSieve::default_segment_bytes * 30;
+    const std::uint64_t chunks = (hi - lo) / chunk + 1;
+    std::atomic<std::uint64_t> next{ 0 };
+    const auto worker = [&] {
+      for (std::uint64_t c; (c = next.fetch_add(1)) < chunks;) {
+        const std::uint64_t chunk_lo = lo + c * chunk;
+        const std::uint64_t chunk_hi = c + 1 == chunks ? hi : chunk_lo + chunk - 1;
+        per_chunk(chunk_lo, chunk_hi);
+      }
+    };
+    std::vector<std::jthread> pool;
+    for (std::uint32_t t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+  }
+
+}// namespace sieve_detail
+
+// calls `f(p)` for every prime p in [lo, hi]
+// with `threads > 1` the calls come from several threads at once,
+// each thread sees increasing primes, but there is no global order
+template<typename F> void for_each_prime(std::uint64_t lo, std::uint64_t hi, F &&f, std::uint32_t threads = 1)
+{
+  if (lo > hi) return;
+  for (std::uint64_t p : { 2, 3, 5 }) {
+    if (lo <= p && p <= hi) f(p);
+  }
+  const auto base = sieving_primes(hi);
+  const auto sieve_chunk = [&](std::uint64_t chunk_lo, std::uint64_t chunk_hi) {
+    SegmentedSieve sieve{ std::max<std::uint64_t>(chunk_lo, 7), chunk_hi, base };
+    while (sieve.next_segment()) sieve.for_each_in_segment(f);
+  };
+  if (threads <= 1) {
+    sieve_chunk(lo, hi);
+  } else {
+    sieve_detail::parallel_chunks(lo, hi, threads, sieve_chunk);
+  }
+}
+
+// number of primes in [lo, hi]
+inline std::uint64_t count_primes(std::uint64_t lo, std::uint64_t hi, std::uint32_t threads = 1)
+{
+  if (lo > hi) return 0;
+  std::uint64_t small = 0;
+  for (std::uint64_t p : { 2, 3, 5 }) small += lo <= p && p <= hi;
+  const auto base = sieving_primes(hi);
+  std::atomic<std::uint64_t> total{ small };
+  const auto sieve_chunk = [&](std::uint64_t chunk_lo, std::uint64_t chunk_hi) {
+    SegmentedSieve sieve{ std::max<std::uint64_t>(chunk_lo, 7), chunk_hi, base };
+    std::uint64_t count = 0;
+    while (sieve.next_segment()) count += sieve.count_in_segment();
+    total += count;
+  };
+  if (threads <= 1) {
+    sieve_chunk(lo, hi);
+  } else {
+    sieve_detail::parallel_chunks(lo, hi, threads, sieve_chunk);
+  }
+  return total;
+}
+
+static_assert(std::ranges::input_range<PrimeRange>);
+
+}// namespace ivl::nt
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <ivl/int128.hpp>
+
+#include <cstdint>
+#include <exception>
 #include <iosfwd>
+#include <span>
 #include <type_traits>
 
 namespace ivl::nt {
@@ -28,12 +33,92 @@ class DivInvalidException : public std::exception
   }
 };
 
-template<typename T> class Safe
+class StickyOverflowException : public std::exception
 {
-  static_assert(std::is_integral_v<T>, "for now only supporting builtin integral types");
+  const char *what() const noexcept override { return "some step in the computation of this value overflowed"; }
+};
+
+// what `Safe` does when an operation overflows (or a division isn't exact)
+namespace safe_policy {
+
+  // throws one of the exceptions above right away
+  struct Throw
+  {
+  };
+
+  // never throws, the result carries an overflow flag that sticks to everything computed from it,
+  // check `overflowed()` (or `checked_get()`) once at the end of the batch
+  struct Sticky
+  {
+  };
+
+  // clamps to the range of T, divisions that aren't exact still throw
+  struct Saturate
+  {
+  };
+
+  // `Throw` while assertions are on, plain wrapping arithmetic with NDEBUG
+  struct DebugOnly
+  {
+  };
+
+}// namespace safe_policy
+
+namespace safe_detail {
+
+  // builtin integers, the 128bit ones included (`std::is_integral` only knows them in gnu++ modes)
+  template<typename T>
+  concept Integer = std::is_integral_v<T> || std::is_same_v<T, int128_t> || std::is_same_v<T, uint128_t>;
+
+  template<typename T> inline constexpr bool is_signed = T(-1) < T(0);
+
+  template<typename T>
+  inline constexpr T max_value = is_signed<T> ? T((uint128_t{ 1 } << (8 * sizeof(T) - 1)) - 1) : T(~T(0));
+
+  template<typename T> inline constexpr T min_value = is_signed<T> ? T(-max_value<T> - 1) : T(0);
+
+  static_assert(max_value<std::int8_t> == 127 && min_value<std::int8_t> == -128 && max_value<std::uint16_t> == 65535);
+  static_assert(max_value<int128_t> > 0 && min_value<int128_t> < 0 && max_value<uint128_t> == ~uint128_t{ 0 });
+
+  // takes no space unless the policy is sticky
+  struct NoFlag
+  {
+  };
+
+}// namespace safe_detail
+
+template<typename T, typename Policy = safe_policy::Throw> class Safe
+{
+  static_assert(safe_detail::Integer<T>, "for now only supporting builtin integral types");
 
 private:
+  static constexpr bool sticky = std::is_same_v<Policy, safe_policy::Sticky>;
+  static constexpr bool saturate = std::is_same_v<Policy, safe_policy::Saturate>;
+#ifdef NDEBUG
+  static constexpr bool checked = !std::is_same_v<Policy, safe_policy::DebugOnly>;
+#else
+  static constexpr bool checked = true;
+#endif
+
   T m_data;
+  [[no_unique_address]] std::conditional_t<sticky, bool, safe_detail::NoFlag> m_overflow{};
+
+  // result of an operation on *this and arg, `overflow` says whether it overflowed
+  template<typename Exception>
+  constexpr Safe result(Safe arg, T wrapped, bool overflow, T saturated) const
+  {
+    Safe out{ wrapped };
+    if constexpr (sticky) {
+      out.m_overflow = this->m_overflow || arg.m_overflow || overflow;
+    } else if (overflow) {
+      if constexpr (saturate) {
+        out.m_data = saturated;
+      } else {
+        throw Exception{};
+      }
+    }
+    return out;
+  }
 
 public:
   // TODO-think: implicit casts could be nasty here
@@ -42,37 +127,66 @@ public:
 
   constexpr T get() const { return m_data; }
 
+  // only ever true for `safe_policy::Sticky`
+  constexpr bool overflowed() const
+  {
+    if constexpr (sticky) return m_overflow;
+    return false;
+  }
+
+  constexpr T checked_get() const
+  {
+    if (overflowed()) throw StickyOverflowException{};
+    return m_data;
+  }
+
   constexpr Safe operator+(Safe arg) const
   {
-    Safe out;
-    if (__builtin_add_overflow(this->m_data, arg.m_data, &out.m_data)) throw AddOverflowException{};
-    return out;
+    T out;
+    const bool overflow = __builtin_add_overflow(this->m_data, arg.m_data, &out);
+    if constexpr (!checked) return Safe{ out };
+    const T saturated = arg.m_data > T{ 0 } ? safe_detail::max_value<T> : safe_detail::min_value<T>;
+    return result<AddOverflowException>(arg, out, overflow, saturated);
   }
 
   constexpr Safe operator-(Safe arg) const
   {
-    Safe out;
-    if (__builtin_sub_overflow(this->m_data, arg.m_data, &out.m_data)) throw SubOverflowException{};
-    return out;
+    T out;
+    const bool overflow = __builtin_sub_overflow(this->m_data, arg.m_data, &out);
+    if constexpr (!checked) return Safe{ out };
+    const T saturated = arg.m_data < T{ 0 } ? safe_detail::max_value<T> : safe_detail::min_value<T>;
+    return result<SubOverflowException>(arg, out, overflow, saturated);
   }
 
   constexpr Safe operator*(Safe arg) const
   {
-    Safe out;
-    if (__builtin_mul_overflow(this->m_data, arg.m_data, &out.m_data)) throw MulOverflowException{};
-    return out;
+    T out;
+    const bool overflow = __builtin_mul_overflow(this->m_data, arg.m_data, &out);
+    if constexpr (!checked) return Safe{ out };
+    const bool negative = (this->m_data < T{ 0 }) != (arg.m_data < T{ 0 });
+    const T saturated = negative ? safe_detail::min_value<T> : safe_detail::max_value<T>;
+    return result<MulOverflowException>(arg, out, overflow, saturated);
   }
 
-  constexpr Safe operator%(Safe arg) const { return Safe{ this->m_data % arg.m_data }; }
+  constexpr Safe operator%(Safe arg) const
+  {
+    return result<DivInvalidException>(arg, this->m_data % arg.m_data, false, T{});
+  }
 
   constexpr Safe operator/(Safe arg) const
   {
-    Safe out{ this->m_data / arg.m_data };
-    if (out.m_data * arg.m_data != this->m_data) throw DivInvalidException{};
-    return out;
+    const T out = this->m_data / arg.m_data;
+    if constexpr (!checked) return Safe{ out };
+    // saturating doesn't make an inexact division any better
+    if constexpr (saturate) {
+      if (out * arg.m_data != this->m_data) throw DivInvalidException{};
+    }
+    return result<DivInvalidException>(arg, out, out * arg.m_data != this->m_data, out);
   }
 
-  friend constexpr auto operator<=>(Safe a, Safe b) = default;
+  // the values only, a sticky overflow is what `overflowed()` is for
+  friend constexpr bool operator==(Safe a, Safe b) { return a.m_data == b.m_data; }
+  friend constexpr auto operator<=>(Safe a, Safe b) { return a.m_data <=> b.m_data; }
 
   constexpr Safe &operator+=(Safe arg) { return *this = *this + arg; }
   constexpr Safe &operator-=(Safe arg) { return *this = *this - arg; }
@@ -80,13 +194,110 @@ public:
   constexpr Safe &operator%=(Safe arg) { return *this = *this % arg; }
   constexpr Safe &operator/=(Safe arg) { return *this = *this / arg; }
 
-  Safe operator-() const { return Safe{ 0 } - *this; }
-
-  Safe &operator++() { return *this += Safe{ 1 }; }
+  constexpr Safe operator-() const { return Safe{ 0 } - *this; }
 
-  // TODO: ++, --, --
+  constexpr Safe &operator++() { return *this += Safe{ 1 }; }
+  constexpr Safe &operator--() { return *this -= Safe{ 1 }; }
 
   friend std::ostream &operator<<(std::ostream &out, Safe s) { return out << s.m_data; }
 };
 
+static_assert(Safe<std::uint8_t, safe_policy::Saturate>{ 200 } + 100 == 255);
+static_assert(Safe<std::int8_t, safe_policy::Saturate>{ -100 } - 100 == -128);
+static_assert(Safe<std::int8_t, safe_policy::Saturate>{ -100 } * 2 == -128);
+static_assert((Safe<std::uint8_t, safe_policy::Sticky>{ 200 } * 2 + 1 - 100).overflowed());
+static_assert(!(Safe<std::uint8_t, safe_policy::Sticky>{ 20 } * 2 + 1).overflowed());
+static_assert((Safe<int128_t, safe_policy::Sticky>{ int128_t{ 1 } << 100 } * (int128_t{ 1 } << 27)).overflowed());
+static_assert(sizeof(Safe<std::uint64_t>) == sizeof(std::uint64_t));
+
+// batch versions over plain spans, for hot loops
+// branch free and without exceptions, so the compiler vectorizes them;
+// each returns whether anything overflowed, overflowed entries hold the wrapped result
+// the inputs are at least as long as `out`, which may alias them
+namespace safe_detail {
+
+  // overflow flags get or-ed into an integer as wide as T, a bool accumulator keeps gcc from vectorizing
+  template<typename T> struct FlagsOf
+  {
+    using type = std::make_unsigned_t<T>;
+  };
+  template<> struct FlagsOf<int128_t>
+  {
+    using type = uint128_t;
+  };
+  template<> struct FlagsOf<uint128_t>
+  {
+    using type = uint128_t;
+  };
+  template<typename T> using Flags = typename FlagsOf<T>::type;
+
+  // a + b, or-ing 1 into `flags` on overflow instead of branching
+  template<typename T> constexpr T add(T a, T b, Flags<T> &flags)
+  {
+    const T r = static_cast<T>(static_cast<Flags<T>>(a) + static_cast<Flags<T>>(b));
+    if constexpr (is_signed<T>) {
+      // the sign changed in a way the operands can't explain
+      flags |= static_cast<Flags<T>>(((a ^ r) & (b ^ r)) < T{ 0 });
+    } else {
+      flags |= static_cast<Flags<T>>(r < a);
+    }
+    return r;
+  }
+
+  template<typename T> constexpr T mul(T a, T b, Flags<T> &flags)
+  {
+    if constexpr (sizeof(T) <= 4) {
+      // the double width product is exact, vectorizes as a widening multiply
+      using W = std::conditional_t<is_signed<T>, std::int64_t, std::uint64_t>;
+      const W w = static_cast<W>(a) * static_cast<W>(b);
+      const T r = static_cast<T>(w);
+      flags |= static_cast<Flags<T>>(static_cast<W>(r) != w);
+      return r;
+    } else {
+      // no vector instruction gives the high half, this is still branch free
+      T r;
+      flags |= static_cast<Flags<T>>(__builtin_mul_overflow(a, b, &r));
+      return r;
+    }
+  }
+
+}// namespace safe_detail
+
+template<safe_detail::Integer T>
+constexpr bool batch_add(std::span<const T> left, std::span<const T> right, std::span<T> out)
+{
+  safe_detail::Flags<T> flags = 0;
+  for (std::size_t i = 0; i < out.size(); ++i) out[i] = safe_detail::add(left[i], right[i], flags);
+  return flags != 0;
+}
+
+template<safe_detail::Integer T>
+constexpr bool batch_mul(std::span<const T> left, std::span<const T> right, std::span<T> out)
+{
+  safe_detail::Flags<T> flags = 0;
+  for (std::size_t i = 0; i < out.size(); ++i) out[i] = safe_detail::mul(left[i], right[i], flags);
+  return flags != 0;
+}
+
+// out[i] = 1 + n[i] + n[i]^2 + ... + n[i]^e, the same horner scheme as `powsum`
+template<safe_detail::Integer T> constexpr bool batch_powsum(std::span<const T> n, std::uint32_t e, std::span<T> out)
+{
+  safe_detail::Flags<T> flags = 0;
+  for (std::size_t i = 0; i < out.size(); ++i) out[i] = T{ 1 };
+  for (std::uint32_t k = 0; k < e; ++k) {
+    for (std::size_t i = 0; i < out.size(); ++i) {
+      out[i] = safe_detail::add(safe_detail::mul(out[i], n[i], flags), T{ 1 }, flags);
+    }
+  }
+  return flags != 0;
+}
+
+static_assert([] {
+  std::uint32_t n[3]{ 2, 10, 65536 };
+  std::uint32_t out[3]{};
+  const bool overflow = batch_powsum<std::uint32_t>(n, 2, out);
+  const bool small_overflow = batch_powsum<std::uint32_t>(std::span{ n, 2 }, 2, std::span{ out, 2 });
+  return overflow && !small_overflow && out[0] == 7 && out[1] == 111;
+}());
+
 }// namespace ivl::nt
@@ -0,0 +1,182 @@
+#pragma once
+
+// divisibility of 64bit integers by the odd primes of the small tables, several primes (or integers) per instruction
+// n is a multiple of p iff n p^-1 <= (2^64 - 1) / p modulo 2^64 (see `DivisibilityPrime`), a multiplication
+// and a compare with nothing carried from one prime to the next, so avx2 tests 4 at once and avx-512 8
+// one kernel per `SimdLevel` (simd.hpp), a plain loop where there is nothing better
+// primes are indices into `small_divisibility_primes`, n and the values are never 0 (0 is a multiple of everything)
+
+#include <ivl/simd.hpp>
+#include <ivl/small-tables.hpp>
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace ivl::nt {
+
+// the table again, split into one array per field so that consecutive primes are one vector load
+struct DivisibilityLanes
+{
+  alignas(64) std::uint64_t inverse[DivisibilityPrimes::size()];
+  alignas(64) std::uint64_t limit[DivisibilityPrimes::size()];
+};
+
+inline constexpr DivisibilityLanes divisibility_lanes = [] {
+  DivisibilityLanes out{};
+  for (std::size_t i = 0; i < DivisibilityPrimes::size(); ++i) {
+    out.inverse[i] = small_divisibility_primes.primes[i].inverse;
+    out.limit[i] = small_divisibility_primes.primes[i].limit;
+  }
+  return out;
+}();
+
+namespace simd_detail {
+
+  constexpr std::size_t first_divisor_scalar(std::uint64_t n, std::size_t from, std::size_t to)
+  {
+    for (; from < to; ++from) {
+      if (n * divisibility_lanes.inverse[from] <= divisibility_lanes.limit[from]) break;
+    }
+    return from;
+  }
+
+  constexpr std::uint64_t divisible_mask_scalar(const std::uint64_t *values, std::size_t count, std::size_t prime)
+  {
+    std::uint64_t mask = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+      const bool hit = values[i] * divisibility_lanes.inverse[prime] <= divisibility_lanes.limit[prime];
+      mask |= std::uint64_t{ hit } << i;
+    }
+    return mask;
+  }
+
+#ifdef IVL_NT_X86_SIMD
+
+  // avx2 has no 64bit multiplication, a b mod 2^64 is lo(a) lo(b) + (hi(a) lo(b) + lo(a) hi(b)) 2^32
+  IVL_NT_TARGET_AVX2 inline __m256i mul_low(__m256i a, __m256i b)
+  {
+    const __m256i cross = _mm256_add_epi64(
+      _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+  }
+
+  IVL_NT_TARGET_AVX2 inline __m256i lanes(const std::uint64_t *p)
+  {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  }
+
+  // bit i set iff lane i of a <= lane i of b, unsigned (the signed compare with both sign bits flipped)
+  IVL_NT_TARGET_AVX2 inline std::uint32_t less_equal(__m256i a, __m256i b)
+  {
+    const __m256i sign = _mm256_set1_epi64x(std::int64_t{ 1 } << 63);
+    const __m256i greater = _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+    return ~static_cast<std::uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(greater))) & 0xf;
+  }
+
+  IVL_NT_TARGET_AVX2 inline std::size_t first_divisor_avx2(std::uint64_t n,
+    std::size_t from,
+    std::size_t to)
+  {
+    const __m256i vn = _mm256_set1_epi64x(static_cast<std::int64_t>(n));
+    // 8 primes a round, two independent multiplications in flight
+    for (; from + 8 <= to; from += 8) {
+      const std::uint32_t hit = less_equal(mul_low(vn, lanes(divisibility_lanes.inverse + from)),
+                                  lanes(divisibility_lanes.limit + from))
+                                | less_equal(mul_low(vn, lanes(divisibility_lanes.inverse + from + 4)),
+                                    lanes(divisibility_lanes.limit + from + 4))
+                                    << 4;
+      if (hit != 0) return from + static_cast<std::size_t>(std::countr_zero(hit));
+    }
+    return first_divisor_scalar(n, from, to);
+  }
+
+  IVL_NT_TARGET_AVX2 inline std::uint64_t divisible_mask_avx2(const std::uint64_t *values,
+    std::size_t count,
+    std::size_t prime)
+  {
+    const __m256i inverse = _mm256_set1_epi64x(static_cast<std::int64_t>(divisibility_lanes.inverse[prime]));
+    const __m256i limit = _mm256_set1_epi64x(static_cast<std::int64_t>(divisibility_lanes.limit[prime]));
+    std::uint64_t mask = 0;
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      mask |= std::uint64_t{ less_equal(mul_low(lanes(values + i), inverse), limit) } << i;
+    }
+    return i == count ? mask : mask | divisible_mask_scalar(values + i, count - i, prime) << i;
+  }
+
+  IVL_NT_TARGET_AVX512 inline std::size_t first_divisor_avx512(std::uint64_t n,
+    std::size_t from,
+    std::size_t to)
+  {
+    const __m512i vn = _mm512_set1_epi64(static_cast<std::int64_t>(n));
+    // 16 primes a round
+    for (; from + 16 <= to; from += 16) {
+      const __m512i a = _mm512_mullo_epi64(vn, _mm512_loadu_si512(divisibility_lanes.inverse + from));
+      const __m512i b = _mm512_mullo_epi64(vn, _mm512_loadu_si512(divisibility_lanes.inverse + from + 8));
+      const std::uint32_t hit = _mm512_cmple_epu64_mask(a, _mm512_loadu_si512(divisibility_lanes.limit + from))
+                                | std::uint32_t{ _mm512_cmple_epu64_mask(
+                                    b, _mm512_loadu_si512(divisibility_lanes.limit + from + 8)) }
+                                    << 8;
+      if (hit != 0) return from + static_cast<std::size_t>(std::countr_zero(hit));
+    }
+    return first_divisor_scalar(n, from, to);
+  }
+
+  IVL_NT_TARGET_AVX512 inline std::uint64_t divisible_mask_avx512(const std::uint64_t *values,
+    std::size_t count,
+    std::size_t prime)
+  {
+    const __m512i inverse = _mm512_set1_epi64(static_cast<std::int64_t>(divisibility_lanes.inverse[prime]));
+    const __m512i limit = _mm512_set1_epi64(static_cast<std::int64_t>(divisibility_lanes.limit[prime]));
+    std::uint64_t mask = 0;
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+      const __m512i product = _mm512_mullo_epi64(_mm512_loadu_si512(values + i), inverse);
+      mask |= std::uint64_t{ _mm512_cmple_epu64_mask(product, limit) } << i;
+    }
+    return i == count ? mask : mask | divisible_mask_scalar(values + i, count - i, prime) << i;
+  }
+
+#endif
+
+}// namespace simd_detail
+
+// the first prime in [from, to) that divides n, `to` if none does
+// `level` is for comparing kernels, anything above `simd_level` doesn't run on this cpu
+constexpr std::size_t first_divisor(std::uint64_t n, std::size_t from, std::size_t to, SimdLevel level)
+{
+  if (!std::is_constant_evaluated()) {
+#ifdef IVL_NT_X86_SIMD
+    if (level == SimdLevel::avx512) return simd_detail::first_divisor_avx512(n, from, to);
+    if (level == SimdLevel::avx2) return simd_detail::first_divisor_avx2(n, from, to);
+#endif
+  }
+  (void)level;
+  return simd_detail::first_divisor_scalar(n, from, to);
+}
+
+constexpr std::size_t first_divisor(std::uint64_t n, std::size_t from, std::size_t to)
+{
+  return first_divisor(n, from, to, std::is_constant_evaluated() ? SimdLevel::scalar : simd_level);
+}
+
+// bit i set iff values[i] is a multiple of the prime, count <= 64
+inline std::uint64_t divisible_mask(const std::uint64_t *values,
+  std::size_t count,
+  std::size_t prime,
+  SimdLevel level = simd_level)
+{
+#ifdef IVL_NT_X86_SIMD
+  if (level == SimdLevel::avx512) return simd_detail::divisible_mask_avx512(values, count, prime);
+  if (level == SimdLevel::avx2) return simd_detail::divisible_mask_avx2(values, count, prime);
+#endif
+  (void)level;
+  return simd_detail::divisible_mask_scalar(values, count, prime);
+}
+
+static_assert(first_divisor(7 * 1000003, 0, DivisibilityPrimes::size()) == 2);
+static_assert(first_divisor(1000003, 0, DivisibilityPrimes::size()) == DivisibilityPrimes::size());
+
+}// namespace ivl::nt
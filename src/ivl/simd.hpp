@@ -0,0 +1,63 @@
+#pragma once
+
+// which vector instructions the kernels get, picked at runtime
+// a kernel is compiled once per level, the vector ones through target attributes (so whatever the flags of the
+// translation unit), and takes a `SimdLevel` that defaults to `simd_level`, the best one the cpu supports,
+// passing a lower one is how the tests and the benchmarks reach the others
+// hand written kernels use intrinsics under `IVL_NT_TARGET_AVX2` / `IVL_NT_TARGET_AVX512`,
+// loops the compiler vectorizes are written once, as an `IVL_NT_SIMD_BODY`, and run through `simd_dispatch`
+// defines IVL_NT_X86_SIMD where the vector levels exist, everything else only ever runs the scalar one
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && __has_include(<immintrin.h>)
+#include <immintrin.h>
+#define IVL_NT_X86_SIMD
+#define IVL_NT_TARGET_AVX2 __attribute__((target("avx2")))
+#define IVL_NT_TARGET_AVX512 __attribute__((target("avx512f,avx512dq")))
+#define IVL_NT_SIMD_BODY [[gnu::always_inline]] inline
+#else
+#define IVL_NT_SIMD_BODY inline
+#endif
+
+namespace ivl::nt {
+
+enum class SimdLevel { scalar, avx2, avx512 };
+
+namespace simd_detail {
+
+  inline SimdLevel detect()
+  {
+#ifdef IVL_NT_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) return SimdLevel::avx512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::avx2;
+#endif
+    return SimdLevel::scalar;
+  }
+
+}// namespace simd_detail
+
+// what this cpu can run, decided once at startup (scalar until then, it's zero initialized)
+inline const SimdLevel simd_level = simd_detail::detect();
+
+#ifdef IVL_NT_X86_SIMD
+namespace simd_detail {
+
+  // `body` is inlined, so it is compiled (and vectorized) for the wrapper's instruction set
+  template<auto body, typename... Args> IVL_NT_TARGET_AVX2 void run_avx2(Args... args) { body(args...); }
+  template<auto body, typename... Args> IVL_NT_TARGET_AVX512 void run_avx512(Args... args) { body(args...); }
+
+}// namespace simd_detail
+#endif
+
+// `body(args...)` compiled for `level`
+template<auto body, typename... Args> void simd_dispatch(SimdLevel level, Args... args)
+{
+#ifdef IVL_NT_X86_SIMD
+  if (level == SimdLevel::avx512) return simd_detail::run_avx512<body>(args...);
+  if (level == SimdLevel::avx2) return simd_detail::run_avx2<body>(args...);
+#endif
+  (void)level;
+  body(args...);
+}
+
+}// namespace ivl::nt
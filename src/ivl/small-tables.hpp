@@ -0,0 +1,142 @@
+#pragma once
+
+// lookup tables for every n below `small_table_bound`, generated by the compiler and baked into rodata:
+// smallest prime factor, tau, sigma, phi and mu of each n, and the odd primes below the bound
+// with their inverses modulo 2^64, for divisibility tests by a multiplication instead of a division
+// `factorize` and the `*_compiletime` multiplicative functions look small arguments up here,
+// so there is no sieve at startup and a small query costs a load (a factorization, one per prime factor)
+// the bound is IVL_NT_SMALL_TABLE_BOUND, 2^12 unless defined otherwise (the same way in every translation unit)
+// every translation unit that includes this generates the tables, linear in the bound: with gcc 12 at -O2
+// ~0.2 seconds of compile time at 2^12, ~2.7 seconds at 2^16, past the bound `factorize` trial divides as usual
+// the prime inverses stop at the bound too, so past its square trial division falls back to the wheel,
+// a 32bit prime takes ~1.5us at 2^16 and ~50us at 2^12: define the bound to 2^16 where that matters
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#ifndef IVL_NT_SMALL_TABLE_BOUND
+#define IVL_NT_SMALL_TABLE_BOUND (1 << 12)
+#endif
+
+namespace ivl::nt {
+
+inline constexpr std::uint32_t small_table_bound = IVL_NT_SMALL_TABLE_BOUND;
+static_assert(small_table_bound >= 1024 && small_table_bound <= (1 << 24), "IVL_NT_SMALL_TABLE_BOUND out of range");
+
+namespace small_tables_detail {
+
+  // the smallest unsigned type that holds `Max`
+  template<std::uint64_t Max>
+  using Fit = std::conditional_t<Max <= 0xff,
+    std::uint8_t,
+    std::conditional_t<Max <= 0xffff,
+      std::uint16_t,
+      std::conditional_t<Max <= 0xffffffff, std::uint32_t, std::uint64_t>>>;
+
+  using Small = Fit<small_table_bound - 1>;
+  using Sigma = Fit<std::uint64_t{ 8 } * small_table_bound>;// sigma(n) < 8n for every n this can be
+
+}// namespace small_tables_detail
+
+// plain arrays on purpose: with `std::array` every access is a call the constant evaluator has to go through,
+// which makes the generation ~7 times slower
+struct SmallTables
+{
+  small_tables_detail::Small spf[small_table_bound];// 0 for 0 and 1
+  std::uint16_t tau[small_table_bound];
+  small_tables_detail::Sigma sigma[small_table_bound];
+  small_tables_detail::Small phi[small_table_bound];
+  std::int8_t mu[small_table_bound];
+  std::size_t prime_count;// below the bound
+};
+
+namespace small_tables_detail {
+
+  // a linear sieve, every n is crossed out once, by its smallest prime factor
+  // with p^e exactly dividing n for the smallest p, f(n) = f(n / p^e) f(p^e), and f(p^e) comes from f(p^(e-1))
+  constexpr SmallTables generate()
+  {
+    SmallTables t{};
+    Small primes[small_table_bound / 2 + 1]{};
+    Small prime_power[small_table_bound]{};// p^e of the smallest p
+    std::size_t count = 0;
+    t.tau[1] = 1;
+    t.sigma[1] = 1;
+    t.phi[1] = 1;
+    t.mu[1] = 1;
+    for (std::uint32_t n = 2; n < small_table_bound; ++n) {
+      if (t.spf[n] == 0) {
+        t.spf[n] = static_cast<Small>(n);
+        primes[count++] = static_cast<Small>(n);
+      }
+      const std::uint32_t p = t.spf[n], m = n / p;
+      prime_power[n] = static_cast<Small>(t.spf[m] == p ? prime_power[m] * p : p);
+      if (prime_power[n] == n) {
+        t.tau[n] = static_cast<std::uint16_t>(t.tau[m] + 1);
+        t.sigma[n] = static_cast<Sigma>(t.sigma[m] * p + 1);
+        t.phi[n] = static_cast<Small>(m == 1 ? p - 1 : t.phi[m] * p);
+        t.mu[n] = static_cast<std::int8_t>(m == 1 ? -1 : 0);
+      } else {
+        const std::uint32_t a = n / prime_power[n], b = prime_power[n];
+        t.tau[n] = static_cast<std::uint16_t>(t.tau[a] * t.tau[b]);
+        t.sigma[n] = static_cast<Sigma>(t.sigma[a] * t.sigma[b]);
+        t.phi[n] = static_cast<Small>(t.phi[a] * t.phi[b]);
+        t.mu[n] = static_cast<std::int8_t>(t.mu[a] * t.mu[b]);
+      }
+      for (std::size_t i = 0; i < count && primes[i] <= p && std::uint64_t{ primes[i] } * n < small_table_bound; ++i) {
+        t.spf[primes[i] * n] = primes[i];
+      }
+    }
+    t.prime_count = count;
+    return t;
+  }
+
+}// namespace small_tables_detail
+
+inline constexpr SmallTables small_tables = small_tables_detail::generate();
+
+static_assert(small_tables.spf[91] == 7 && small_tables.spf[97] == 97 && small_tables.tau[720] == 30);
+static_assert(small_tables.sigma[720] == 2418 && small_tables.phi[720] == 192 && small_tables.phi[1] == 1);
+static_assert(small_tables.mu[30] == -1 && small_tables.mu[12] == 0 && small_tables.mu[1] == 1);
+static_assert(small_table_bound != 1 << 12 || small_tables.prime_count == 564);
+static_assert(small_table_bound != 1 << 16 || small_tables.prime_count == 6542);
+
+// n is a multiple of the odd prime `p` iff n * inverse <= limit (modulo 2^64), for any 64bit n
+struct DivisibilityPrime
+{
+  std::uint64_t inverse;// p^-1 mod 2^64
+  std::uint64_t limit;// (2^64 - 1) / p
+  std::uint32_t p;
+
+  constexpr bool divides(std::uint64_t n) const { return n * inverse <= limit; }
+};
+
+struct DivisibilityPrimes
+{
+  DivisibilityPrime primes[small_tables.prime_count - 1];// the odd ones, increasing
+
+  static constexpr std::size_t size() { return small_tables.prime_count - 1; }
+  constexpr const DivisibilityPrime *begin() const { return primes; }
+  constexpr const DivisibilityPrime *end() const { return primes + size(); }
+};
+
+inline constexpr DivisibilityPrimes small_divisibility_primes = [] {
+  DivisibilityPrimes out{};
+  std::size_t k = 0;
+  for (std::uint32_t p = 3; p < small_table_bound; p += 2) {
+    if (small_tables.spf[p] != p) continue;
+    // newton's iteration doubles the correct low bits every step, p itself is right in the low 3 (p p == 1 mod 8)
+    std::uint64_t inverse = p;
+    for (int i = 0; i < 5; ++i) inverse *= 2 - p * inverse;
+    out.primes[k++] = { inverse, std::numeric_limits<std::uint64_t>::max() / p, p };
+  }
+  return out;
+}();
+
+static_assert(small_divisibility_primes.primes[0].p == 3 && small_divisibility_primes.primes[0].inverse * 3 == 1);
+static_assert(small_divisibility_primes.primes[2].divides(7 * 1000003)
+              && !small_divisibility_primes.primes[2].divides(7 * 1000003 + 1));
+
+}// namespace ivl::nt
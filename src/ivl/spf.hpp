@@ -0,0 +1,210 @@
+#pragma once
+
+#include <ivl/factorize.hpp>
+#include <ivl/instrument.hpp>
+#include <ivl/primes.hpp>
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace ivl::nt {
+
+class SpfLimitException : public std::exception
+{
+public:
+  virtual const char *what() const noexcept override
+  {
+    return "argument is outside of the smallest-prime-factor table";
+  }
+};
+
+// smallest-prime-factor table for [1, limit], built with a linear sieve
+//
+// only odd numbers are stored (wheel of 2), evens are stripped by the caller,
+// which halves the memory
+// primes are stored as 0, so an entry only ever holds a prime <= sqrt(limit),
+// meaning `std::uint16_t` entries are enough for limit < 2^32
+// (1e9 is then ~1GB, 2e8 is ~200MB)
+template<typename E = std::uint32_t> class SpfTable
+{
+  static_assert(std::is_unsigned_v<E>, "entries have to be unsigned");
+
+private:
+  std::uint64_t m_limit;
+  // m_spf[i] == spf(2i + 1), or 0 if 2i + 1 is prime (or 1)
+  std::vector<E> m_spf;
+
+public:
+  // the largest limit whose smallest factors all fit in `E`
+  static constexpr std::uint64_t max_limit()
+  {
+    constexpr std::uint64_t entry_max = std::numeric_limits<E>::max();
+    if constexpr (sizeof(E) >= sizeof(std::uint32_t)) {
+      return std::numeric_limits<std::uint64_t>::max();
+    } else {
+      return (entry_max + 1) * (entry_max + 1) - 1;
+    }
+  }
+
+  explicit constexpr SpfTable(std::uint64_t limit) : m_limit(limit), m_spf(limit / 2 + 1, E{ 0 })
+  {
+    if (limit > max_limit()) throw SpfLimitException{};
+    // odd primes <= sqrt(limit), the only ones that can be a smallest factor of a composite <= limit
+    std::vector<std::uint64_t> primes;
+    for (std::uint64_t i = 3; i <= limit; i += 2) {
+      const std::uint64_t spf_i = m_spf[i / 2] ? m_spf[i / 2] : i;
+      if (spf_i == i && i <= limit / i) primes.push_back(i);
+      const std::uint64_t bound = std::min(spf_i, limit / i);
+      // every odd composite c is visited exactly once, as spf(c) * (c / spf(c))
+      for (auto p : primes) {
+        if (p > bound) break;
+        m_spf[p * i / 2] = static_cast<E>(p);
+      }
+    }
+  }
+
+  constexpr std::uint64_t limit() const { return m_limit; }
+
+  // `n` has to be in [2, limit]
+  constexpr std::uint64_t operator[](std::uint64_t n) const
+  {
+    if (n % 2 == 0) return 2;
+    return m_spf[n / 2] ? m_spf[n / 2] : n;
+  }
+
+  constexpr bool is_prime(std::uint64_t n) const { return n >= 2 && (*this)[n] == n; }
+
+  // the odd entries, limit / 2 + 1 of them, e.g. for writing them to a table file
+  constexpr std::span<const E> entries() const { return m_spf; }
+};
+
+// the entries of `SpfTable<E>{ limit }` a range at a time, for tables that are too large to build in memory
+// (`TableFileWriter::add_spf` streams them into a file), a plain segmented sieve:
+// the odd primes up to sqrt(limit) in increasing order, each one marks the multiples nothing smaller has marked
+template<typename E = std::uint32_t> class SpfSegments
+{
+  static_assert(std::is_unsigned_v<E>, "entries have to be unsigned");
+
+private:
+  std::uint64_t m_limit;
+  std::vector<std::uint32_t> m_primes;
+
+public:
+  explicit SpfSegments(std::uint64_t limit) : m_limit(limit)
+  {
+    if (limit > SpfTable<E>::max_limit()) throw SpfLimitException{};
+    for (std::uint32_t p : { 3, 5 }) {
+      if (std::uint64_t{ p } * p <= limit) m_primes.push_back(p);
+    }
+    const auto rest = sieving_primes(limit);
+    m_primes.insert(m_primes.end(), rest.begin(), rest.end());
+  }
+
+  constexpr std::uint64_t limit() const { return m_limit; }
+
+  // out[i] = entries()[first + i], first + out.size() is at most limit / 2 + 1
+  void fill(std::uint64_t first, std::span<E> out) const
+  {
+    std::fill(out.begin(), out.end(), E{ 0 });
+    if (out.empty()) return;
+    // the odd numbers 2i + 1 for i in [first, first + out.size())
+    const std::uint64_t lo = 2 * first + 1;
+    const std::uint64_t hi = 2 * (first + out.size()) - 1;
+    for (std::uint64_t p : m_primes) {
+      if (p > hi / p) break;
+      // the odd multiples from p^2 on, the smaller ones have a smaller factor
+      std::uint64_t x = std::max(p * p, (lo + p - 1) / p * p);
+      if (x % 2 == 0) x += p;
+      for (; x <= hi; x += 2 * p) {
+        E &entry = out[static_cast<std::size_t>(x / 2 - first)];
+        if (entry == 0) entry = static_cast<E>(p);
+      }
+    }
+  }
+};
+
+// the same table over entries that live somewhere else (a mapped table file, see table-file.hpp)
+template<typename E = std::uint32_t> class SpfView
+{
+  static_assert(std::is_unsigned_v<E>, "entries have to be unsigned");
+
+private:
+  std::uint64_t m_limit;
+  std::span<const E> m_spf;
+
+public:
+  // `entries` as `SpfTable::entries()` has them
+  constexpr SpfView(std::uint64_t limit, std::span<const E> entries) : m_limit(limit), m_spf(entries)
+  {
+    if (entries.size() != limit / 2 + 1) throw SpfLimitException{};
+  }
+
+  constexpr std::uint64_t limit() const { return m_limit; }
+
+  // `n` has to be in [2, limit]
+  constexpr std::uint64_t operator[](std::uint64_t n) const
+  {
+    if (n % 2 == 0) return 2;
+    return m_spf[n / 2] ? m_spf[n / 2] : n;
+  }
+
+  constexpr bool is_prime(std::uint64_t n) const { return n >= 2 && (*this)[n] == n; }
+};
+
+template<typename S> concept SpfLike = requires(const S &table, std::uint64_t n) {
+  { table.limit() } -> std::convertible_to<std::uint64_t>;
+  { table[n] } -> std::convertible_to<std::uint64_t>;
+  { table.is_prime(n) } -> std::same_as<bool>;
+};
+
+static_assert(SpfLike<SpfTable<std::uint16_t>> && SpfLike<SpfView<>>);
+
+// O(log n) factorization via the table (owned or not), `n` has to be within the table
+template<typename T, typename ET = ExponentType, typename F = Factorization<T, ET>, SpfLike S>
+  requires std::integral<T>
+constexpr F factorize(T n, const S &table)
+{
+  if (n < T{ 0 }) n = -n;
+  if (n == T{ 0 }) throw ZeroFactorizationException{};
+  auto m = static_cast<std::uint64_t>(n);
+  if (m > table.limit()) throw SpfLimitException{};
+  instrument::add(instrument::Counter::factorizations);
+  F factorization;
+  if (m % 2 == 0) {
+    ET e = 0;
+    while (m % 2 == 0) {
+      m /= 2;
+      ++e;
+    }
+    append_factor(factorization, T{ 2 }, e);
+  }
+  while (m != 1) {
+    const auto p = table[m];
+    ET e = 0;
+    while (m % p == 0) {
+      m /= p;
+      ++e;
+    }
+    append_factor(factorization, static_cast<T>(p), e);
+  }
+  return factorization;
+}
+
+static_assert(factorize<int, std::uint32_t>(2100, SpfTable<std::uint16_t>{ 3000 })
+              == std::vector<std::pair<int, std::uint32_t>>{ { 2, 2 }, { 3, 1 }, { 5, 2 }, { 7, 1 } });
+static_assert(factorize<int, std::uint32_t>(2999, SpfTable<>{ 3000 })
+              == std::vector<std::pair<int, std::uint32_t>>{ { 2999, 1 } });
+static_assert([] {
+  const SpfTable<std::uint16_t> table{ 3000 };
+  return factorize<int, std::uint32_t>(2100, SpfView<std::uint16_t>{ 3000, table.entries() })
+         == factorize<int, std::uint32_t>(2100, table);
+}());
+
+}// namespace ivl::nt
@@ -0,0 +1,400 @@
+#pragma once
+
+// bulk factorization of whitespace separated decimal uint64s, for inputs with millions of them
+// the input is cut into chunks at whitespace, a pool of workers parses, factorizes and formats whole chunks,
+// and whoever finishes the oldest chunk writes out everything that's ready, in input order
+// at most `window` chunks are between being read and being written, so memory stays around
+// window * chunk_bytes however large the input is and however uneven the chunks are
+//
+// output formats, one record per input number:
+// * text: `n: p^e p^e ...` and a newline, primes increasing, `0:` and `1:` have no factors
+// * binary: n (8 bytes), k (1 byte), then k times p (8 bytes), e (1 byte), all little endian
+
+#include <ivl/factorize.hpp>
+#include <ivl/mapped-file.hpp>
+#include <ivl/pollard-rho.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ivl::nt {
+
+class StreamParseException : public std::exception
+{
+private:
+  std::uint64_t m_offset;
+  std::string m_message;
+
+public:
+  StreamParseException(std::uint64_t offset, std::string_view token)
+    : m_offset(offset),
+      m_message("not a 64bit unsigned integer at byte " + std::to_string(offset) + ": '"
+                + std::string{ token.substr(0, 32) } + "'")
+  {}
+
+  // from the start of the input
+  std::uint64_t offset() const { return m_offset; }
+
+  virtual const char *what() const noexcept override { return m_message.c_str(); }
+};
+
+class StreamIoException : public std::exception
+{
+public:
+  virtual const char *what() const noexcept override { return "reading the input or writing the output failed"; }
+};
+
+enum class StreamFormat { text, binary };
+
+struct StreamOptions
+{
+  std::size_t threads = 0;// 0 is one per hardware thread
+  std::size_t chunk_bytes = 1 << 20;// input per job, cut at the next whitespace
+  std::size_t window = 0;// chunks in flight, 0 is four per thread
+  StreamFormat format = StreamFormat::text;
+};
+
+struct StreamStats
+{
+  std::uint64_t numbers = 0;
+  std::uint64_t chunks = 0;
+  std::uint64_t bytes_in = 0;
+  std::uint64_t bytes_out = 0;
+};
+
+namespace stream_detail {
+
+  // a token can't be longer than this and still fit in 64 bits, smaller chunks would split valid tokens
+  inline constexpr std::size_t min_chunk_bytes = 64;
+
+  constexpr bool is_space(char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+
+  // calls `fn(n)` for every number in `text`, `offset` is where `text` starts in the input, for the errors
+  template<typename Fn> constexpr std::uint64_t parse(std::string_view text, std::uint64_t offset, Fn &&fn)
+  {
+    const char *it = text.data();
+    const char *const last = text.data() + text.size();
+    std::uint64_t count = 0;
+    while (true) {
+      while (it != last && is_space(*it)) ++it;
+      if (it == last) return count;
+      std::uint64_t n = 0;
+      const auto [end, error] = std::from_chars(it, last, n);
+      if (error != std::errc{} || (end != last && !is_space(*end))) {
+        const char *token_end = it;
+        while (token_end != last && !is_space(*token_end)) ++token_end;
+        throw StreamParseException{ offset + static_cast<std::uint64_t>(it - text.data()),
+          std::string_view{ it, static_cast<std::size_t>(token_end - it) } };
+      }
+      fn(n);
+      ++count;
+      it = end;
+    }
+  }
+
+  // 0 and 1 have no prime factors, `factorize` refuses 0 so it doesn't get asked
+  inline InlineFactorization<std::uint64_t> factorize_any(std::uint64_t n)
+  {
+    if (n <= 1) return {};
+    return factorize<std::uint64_t, ExponentType, InlineFactorization<std::uint64_t>>(n, pollard_rho_strategy);
+  }
+
+  // at most 20 digits, which the compiler can see (unlike with `std::to_chars`)
+  inline char *put_decimal(char *it, std::uint64_t x)
+  {
+    char digits[20];
+    std::size_t k = 0;
+    do {
+      digits[k++] = static_cast<char>('0' + x % 10);
+      x /= 10;
+    } while (x != 0);
+    while (k != 0) *it++ = digits[--k];
+    return it;
+  }
+
+  // the whole record goes into a stack buffer first, one append per number
+  inline void format_text(std::uint64_t n, const InlineFactorization<std::uint64_t> &f, std::string &out)
+  {
+    // n and ':', then at most 15 of " p^e", and the newline, every number gets 20 digits of room
+    constexpr std::size_t capacity = InlineFactorization<std::uint64_t>::capacity();
+    char buffer[20 + 1 + capacity * (1 + 20 + 1 + 20) + 1];
+    char *it = put_decimal(buffer, n);
+    *it++ = ':';
+    // the bound is redundant, it's there so the compiler sees the buffer is large enough
+    for (std::size_t i = 0; i < std::min(f.size(), capacity); ++i) {
+      *it++ = ' ';
+      it = put_decimal(it, f.prime(i));
+      *it++ = '^';
+      it = put_decimal(it, f.exponent(i));
+    }
+    *it++ = '\n';
+    out.append(buffer, it);
+  }
+
+  inline char *put_le64(char *it, std::uint64_t x)
+  {
+    for (int i = 0; i < 8; ++i) *it++ = static_cast<char>(x >> (8 * i));
+    return it;
+  }
+
+  inline void format_binary(std::uint64_t n, const InlineFactorization<std::uint64_t> &f, std::string &out)
+  {
+    constexpr std::size_t capacity = InlineFactorization<std::uint64_t>::capacity();
+    char buffer[8 + 1 + capacity * (8 + 1)];
+    char *it = put_le64(buffer, n);
+    *it++ = static_cast<char>(f.size());
+    for (std::size_t i = 0; i < std::min(f.size(), capacity); ++i) {
+      it = put_le64(it, f.prime(i));
+      *it++ = static_cast<char>(f.exponent(i));
+    }
+    out.append(buffer, it);
+  }
+
+  // parses, factorizes and formats one chunk, returns how many numbers it had
+  inline std::uint64_t process(std::string_view text, std::uint64_t offset, StreamFormat format, std::string &out)
+  {
+    if (format == StreamFormat::text) {
+      return parse(text, offset, [&](std::uint64_t n) { format_text(n, factorize_any(n), out); });
+    }
+    return parse(text, offset, [&](std::uint64_t n) { format_binary(n, factorize_any(n), out); });
+  }
+
+  struct Job
+  {
+    std::uint64_t index = 0;
+    std::uint64_t offset = 0;
+    std::string storage;// the text when it was read from a stream
+    std::string_view mapped;// the text when it wasn't
+
+    // not a member view into `storage`, short strings live inside the object and would move away from it
+    std::string_view text() const { return storage.empty() ? mapped : std::string_view{ storage }; }
+  };
+
+  // the reader (the calling thread) submits chunks, the workers turn them into output,
+  // slots are a ring of `window` finished chunks waiting for the older ones
+  class Pipeline
+  {
+  private:
+    std::ostream &m_out;
+    const StreamOptions m_options;
+    const std::size_t m_window;
+
+    std::mutex m_mutex;
+    std::condition_variable m_work;// workers wait for jobs
+    std::condition_variable m_space;// the reader waits for room in the window
+    std::deque<Job> m_jobs;
+    std::vector<std::optional<std::string>> m_slots;
+    std::uint64_t m_next_read = 0;
+    std::uint64_t m_next_write = 0;
+    bool m_closed = false;
+    bool m_writing = false;
+    std::exception_ptr m_error;
+    StreamStats m_stats;
+
+    std::vector<std::jthread> m_workers;
+
+    void fail(std::exception_ptr error)
+    {
+      std::lock_guard lock{ m_mutex };
+      if (!m_error) m_error = error;
+      m_work.notify_all();
+      m_space.notify_all();
+    }
+
+    // deposits the output of chunk `index`, then writes out everything that's ready unless someone already is
+    void finish(std::uint64_t index, std::string output, std::uint64_t numbers)
+    {
+      std::unique_lock lock{ m_mutex };
+      m_stats.numbers += numbers;
+      m_slots[index % m_window] = std::move(output);
+      if (m_writing) return;
+      m_writing = true;
+      while (!m_error && m_slots[m_next_write % m_window]) {
+        const std::string ready = *std::exchange(m_slots[m_next_write % m_window], std::nullopt);
+        lock.unlock();
+        m_out.write(ready.data(), static_cast<std::streamsize>(ready.size()));
+        lock.lock();
+        if (!m_out) {
+          m_error = std::make_exception_ptr(StreamIoException{});
+          m_work.notify_all();
+          m_space.notify_all();
+        }
+        m_stats.bytes_out += ready.size();
+        ++m_next_write;
+        m_space.notify_one();
+      }
+      m_writing = false;
+    }
+
+    void work()
+    {
+      while (true) {
+        Job job;
+        {
+          std::unique_lock lock{ m_mutex };
+          m_work.wait(lock, [&] { return !m_jobs.empty() || m_closed || m_error; });
+          if (m_error || m_jobs.empty()) return;
+          job = std::move(m_jobs.front());
+          m_jobs.pop_front();
+        }
+        try {
+          std::string output;
+          // text output is usually a bit longer than the input
+          output.reserve(job.text().size() + job.text().size() / 2);
+          const std::uint64_t numbers = process(job.text(), job.offset, m_options.format, output);
+          finish(job.index, std::move(output), numbers);
+        } catch (...) {
+          fail(std::current_exception());
+          return;
+        }
+      }
+    }
+
+  public:
+    Pipeline(std::ostream &out, const StreamOptions &options)
+      : m_out(out), m_options(options),
+        m_window(options.window ? options.window : 4 * std::max<std::size_t>(options.threads, 1)),
+        m_slots(m_window)
+    {
+      for (std::size_t i = 0; i < std::max<std::size_t>(m_options.threads, 1); ++i) {
+        m_workers.emplace_back([this] { work(); });
+      }
+    }
+
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+
+    ~Pipeline() { close(); }
+
+    // either `storage` owns the chunk or it is empty and `text` points into the caller's input
+    // blocks while the window is full, false once something failed (`wait` rethrows it)
+    bool submit(std::uint64_t offset, std::string storage, std::string_view text)
+    {
+      std::unique_lock lock{ m_mutex };
+      m_space.wait(lock, [&] { return m_next_read < m_next_write + m_window || m_error; });
+      if (m_error) return false;
+      m_jobs.push_back(Job{ m_next_read, offset, std::move(storage), text });
+      ++m_next_read;
+      ++m_stats.chunks;
+      m_stats.bytes_in += m_jobs.back().text().size();
+      m_work.notify_one();
+      return true;
+    }
+
+    void close()
+    {
+      {
+        std::lock_guard lock{ m_mutex };
+        m_closed = true;
+      }
+      m_work.notify_all();
+      m_workers.clear();
+    }
+
+    // after the last `submit`, everything is written (and flushed) when this returns
+    StreamStats wait()
+    {
+      close();
+      if (m_error) std::rethrow_exception(m_error);
+      m_out.flush();
+      if (!m_out) throw StreamIoException{};
+      return m_stats;
+    }
+  };
+
+  inline StreamOptions normalized(StreamOptions options)
+  {
+    if (options.threads == 0) options.threads = std::max(std::thread::hardware_concurrency(), 1U);
+    options.chunk_bytes = std::max(options.chunk_bytes, min_chunk_bytes);
+    return options;
+  }
+
+}// namespace stream_detail
+
+// `text` has to outlive the call, nothing is copied
+inline StreamStats factorize_stream(std::string_view text, std::ostream &out, const StreamOptions &options = {})
+{
+  const StreamOptions o = stream_detail::normalized(options);
+  stream_detail::Pipeline pipeline{ out, o };
+  for (std::size_t begin = 0; begin < text.size();) {
+    std::size_t end = std::min(begin + o.chunk_bytes, text.size());
+    while (end < text.size() && !stream_detail::is_space(text[end])) ++end;
+    if (!pipeline.submit(begin, {}, text.substr(begin, end - begin))) break;
+    begin = end;
+  }
+  return pipeline.wait();
+}
+
+// reads `chunk_bytes` at a time, the unfinished token at the end of a block moves on to the next one
+inline StreamStats factorize_stream(std::istream &in, std::ostream &out, const StreamOptions &options = {})
+{
+  const StreamOptions o = stream_detail::normalized(options);
+  // reading flushes the tied stream (`std::cin` flushes `std::cout`), which would race with the workers writing
+  struct Untie
+  {
+    std::istream &in;
+    std::ostream *tied = in.tie(nullptr);
+    ~Untie() { in.tie(tied); }
+  } untie{ in };
+  stream_detail::Pipeline pipeline{ out, o };
+  std::string carry;
+  std::uint64_t offset = 0;
+  while (true) {
+    std::string block = std::move(carry);
+    carry.clear();
+    const std::size_t kept = block.size();
+    block.resize(kept + o.chunk_bytes);
+    in.read(block.data() + kept, static_cast<std::streamsize>(o.chunk_bytes));
+    block.resize(kept + static_cast<std::size_t>(in.gcount()));
+    if (in.bad()) throw StreamIoException{};
+    const bool last = in.eof();
+    if (!last) {
+      // a block without any whitespace is an invalid token, it goes out whole and fails in parsing
+      std::size_t cut = block.size();
+      while (cut > 0 && !stream_detail::is_space(block[cut - 1])) --cut;
+      if (cut > 0) {
+        carry.assign(block, cut);
+        block.resize(cut);
+      }
+    }
+    const std::uint64_t size = block.size();
+    if (!block.empty() && !pipeline.submit(offset, std::move(block), {})) break;
+    offset += size;
+    if (last) break;
+  }
+  return pipeline.wait();
+}
+
+// maps regular files, streams anything else (fifos, /dev/stdin, systems without mmap)
+inline StreamStats factorize_file(const std::string &path, std::ostream &out, const StreamOptions &options = {})
+{
+#ifdef IVL_NT_MMAP
+  std::optional<MappedFile> mapped;
+  try {
+    mapped.emplace(path);
+  } catch (const std::system_error &) {
+  }
+  if (mapped) return factorize_stream(mapped->view(), out, options);
+#endif
+  std::ifstream in{ path, std::ios::binary };
+  if (!in) throw StreamIoException{};
+  return factorize_stream(in, out, options);
+}
+
+}// namespace ivl::nt
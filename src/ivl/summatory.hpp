@@ -0,0 +1,295 @@
+#pragma once
+
+// sums of multiplicative functions up to N in ~O(N^(3/4) / log N) time and O(sqrt(N)) memory
+// min_25 style: lucy's dp gives sums over primes for every floor(N / i),
+// a recursion over smallest prime factors then adds the composites
+
+#include <ivl/factorize.hpp>
+#include <ivl/primes.hpp>
+
+#include <algorithm>
+#include <barrier>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ivl::nt {
+
+// one value of type R for every distinct floor(N / i), i in [1, N]
+// there are ~2 sqrt(N) of them, they are stored in decreasing order
+template<typename R> class QuotientTable
+{
+private:
+  std::uint64_t m_n;
+  std::uint64_t m_sqrt;
+  std::vector<std::uint64_t> m_values;
+  std::vector<R> m_data;
+
+public:
+  explicit QuotientTable(std::uint64_t n) : m_n(n), m_sqrt(isqrt(n))
+  {
+    for (std::uint64_t i = 1; i <= n; i = n / (n / i) + 1) m_values.push_back(n / i);
+    m_data.resize(m_values.size());
+  }
+
+  std::uint64_t n() const { return m_n; }
+  std::size_t size() const { return m_values.size(); }
+
+  // position of `v`, which has to be some floor(N / i)
+  // every v <= sqrt(N) is one, so they sit at the end, v > sqrt(N) is N / (index + 1)
+  std::size_t index(std::uint64_t v) const
+  {
+    return v <= m_sqrt ? static_cast<std::size_t>(m_values.size() - v) : static_cast<std::size_t>(m_n / v - 1);
+  }
+
+  std::span<const std::uint64_t> values() const { return m_values; }
+  std::span<R> data() { return m_data; }
+  std::span<const R> data() const { return m_data; }
+
+  R &operator[](std::size_t i) { return m_data[i]; }
+  const R &operator[](std::size_t i) const { return m_data[i]; }
+
+  // value at v = floor(N / i)
+  R &at(std::uint64_t v) { return m_data[index(v)]; }
+  const R &at(std::uint64_t v) const { return m_data[index(v)]; }
+
+  // for combining sums over primes, e.g. f(p) = p + 1 is `power_sums_1 + power_sums_0`
+  QuotientTable &operator+=(const QuotientTable &other)
+  {
+    for (std::size_t i = 0; i < m_data.size(); ++i) m_data[i] += other.m_data[i];
+    return *this;
+  }
+
+  QuotientTable &operator-=(const QuotientTable &other)
+  {
+    for (std::size_t i = 0; i < m_data.size(); ++i) m_data[i] -= other.m_data[i];
+    return *this;
+  }
+
+  QuotientTable &operator*=(const R &scalar)
+  {
+    for (auto &x : m_data) x *= scalar;
+    return *this;
+  }
+
+  friend QuotientTable operator+(QuotientTable left, const QuotientTable &right) { return left += right; }
+  friend QuotientTable operator-(QuotientTable left, const QuotientTable &right) { return left -= right; }
+  friend QuotientTable operator*(QuotientTable left, const R &scalar) { return left *= scalar; }
+};
+
+namespace summatory_detail {
+
+  // `run(count, job)` calls `job(begin, end)` over [0, count) split between `threads` threads,
+  // the calling one included, the workers sleep on a barrier between jobs
+  class WorkerPool
+  {
+  private:
+    std::uint32_t m_threads;
+    std::barrier<> m_barrier;
+    std::function<void(std::size_t, std::size_t)> m_job;
+    std::size_t m_count;
+    bool m_stop;
+    std::vector<std::jthread> m_workers;
+
+    void slice(std::uint32_t t) const
+    {
+      const std::size_t per = m_count / m_threads + 1;
+      const std::size_t begin = std::min(m_count, t * per);
+      m_job(begin, std::min(m_count, begin + per));
+    }
+
+  public:
+    explicit WorkerPool(std::uint32_t threads)
+      : m_threads(std::max<std::uint32_t>(threads, 1)), m_barrier(m_threads), m_count(0), m_stop(false)
+    {
+      for (std::uint32_t t = 1; t < m_threads; ++t) {
+        m_workers.emplace_back([this, t] {
+          while (true) {
+            m_barrier.arrive_and_wait();
+            if (m_stop) return;
+            slice(t);
+            m_barrier.arrive_and_wait();
+          }
+        });
+      }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool()
+    {
+      m_stop = true;
+      if (m_threads > 1) m_barrier.arrive_and_wait();
+    }
+
+    std::uint32_t threads() const { return m_threads; }
+
+    void run(std::size_t count, std::function<void(std::size_t, std::size_t)> job)
+    {
+      m_job = std::move(job);
+      m_count = count;
+      if (m_threads > 1) m_barrier.arrive_and_wait();
+      slice(0);
+      if (m_threads > 1) m_barrier.arrive_and_wait();
+    }
+  };
+
+  // below this many updates a prime isn't worth waking the workers for
+  inline constexpr std::size_t parallel_threshold = 1 << 12;
+
+}// namespace summatory_detail
+
+// lucy's dp: sum of w(p) over primes p <= v, for every v = floor(N / i)
+// w has to be completely multiplicative, `prefix(v)` is the sum of w(n) over 2 <= n <= v
+// each prime p <= sqrt(N) removes the numbers with smallest prime factor p:
+//   S(v) -= w(p) * (S(v / p) - S(p - 1))   for v >= p^2
+// with `threads > 1` the updates of the small primes (the bulk of the work) are split between threads
+template<typename R, typename W, typename Prefix>
+QuotientTable<R> lucy_prime_sums(std::uint64_t n, W &&w, Prefix &&prefix, std::uint32_t threads = 1)
+{
+  QuotientTable<R> table{ n };
+  const auto values = table.values();
+  const std::size_t size = values.size();
+  for (std::size_t i = 0; i < size; ++i) table[i] = prefix(values[i]);
+  if (n < 4) return table;
+
+  const std::uint64_t sq = isqrt(n);
+  // values > sqrt(N) are N / (i + 1) at index i, there are `large` of them
+  const std::size_t large = table.index(sq + 1) + 1;
+  std::vector<std::uint32_t> primes{ 2, 3, 5 };
+  const auto rest = sieving_primes(n);
+  primes.insert(primes.end(), rest.begin(), rest.end());
+
+  summatory_detail::WorkerPool pool{ threads };
+  std::vector<R> scratch;
+  for (std::uint64_t p : primes) {
+    if (p * p > n) break;
+    const R wp = static_cast<R>(w(p));
+    const R below = table.at(p - 1);
+    const std::size_t count =
+      p * p <= sq ? static_cast<std::size_t>(size - p * p + 1) : static_cast<std::size_t>(n / (p * p));
+    // floor(N / (i + 1) / p) == floor(N / ((i + 1) p)), which is a direct index while it's still large
+    const auto updated = [&](std::size_t i) {
+      const std::size_t j = (i + 1) * p - 1;
+      const R &next = i < large && j < large ? table[j] : table.at(values[i] / p);
+      return table[i] - wp * (next - below);
+    };
+    if (pool.threads() == 1 || count < summatory_detail::parallel_threshold) {
+      // increasing index is decreasing v, so v / p is always read before it gets updated
+      for (std::size_t i = 0; i < count; ++i) table[i] = updated(i);
+    } else {
+      scratch.resize(count);
+      pool.run(count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) scratch[i] = updated(i);
+      });
+      pool.run(count, [&](std::size_t begin, std::size_t end) {
+        std::copy(scratch.begin() + static_cast<std::ptrdiff_t>(begin),
+          scratch.begin() + static_cast<std::ptrdiff_t>(end),
+          table.data().begin() + static_cast<std::ptrdiff_t>(begin));
+      });
+    }
+  }
+  return table;
+}
+
+// sum of n^k over 2 <= n <= v, k <= 3
+// the divisions by 2 and 3 happen on the factors, so this also works for modular R
+template<typename R> R power_prefix_sum(std::uint64_t v, std::uint32_t k)
+{
+  if (v < 2) return R{ 0 };
+  std::uint64_t a = v;
+  std::uint64_t b = v + 1;
+  (a % 2 == 0 ? a : b) /= 2;
+  switch (k) {
+  case 0:
+    return static_cast<R>(v - 1);
+  case 1:
+    return static_cast<R>(a) * static_cast<R>(b) - R{ 1 };
+  case 2: {
+    std::uint64_t c = 2 * v + 1;
+    (a % 3 == 0 ? a : b % 3 == 0 ? b : c) /= 3;
+    return static_cast<R>(a) * static_cast<R>(b) * static_cast<R>(c) - R{ 1 };
+  }
+  case 3: {
+    const R half = static_cast<R>(a) * static_cast<R>(b);
+    return half * half - R{ 1 };
+  }
+  default:
+    throw std::invalid_argument{ "power_prefix_sum only knows k <= 3" };
+  }
+}
+
+// sum of p^k over primes p <= v, for every v = floor(N / i)
+// k = 0 is prime counting, k = 1 sums the primes
+template<typename R> QuotientTable<R> prime_power_sums(std::uint64_t n, std::uint32_t k, std::uint32_t threads = 1)
+{
+  return lucy_prime_sums<R>(
+    n,
+    [k](std::uint64_t p) {
+      R out{ 1 };
+      for (std::uint32_t i = 0; i < k; ++i) out *= static_cast<R>(p);
+      return out;
+    },
+    [k](std::uint64_t v) { return power_prefix_sum<R>(v, k); },
+    threads);
+}
+
+// sum of f(n) over 1 <= n <= N, f multiplicative with f(p^e) = callable(p, e)
+// (same callables as `multiplicative_completion`, p is passed as an R, so that e.g.
+// `mu_prime_power` gives a proper -1 for signed R instead of a wrapped around 2^64 - 1)
+// `prime_sums` holds the sum of f(p) over primes p <= v for every v = floor(N / i),
+// which lucy can't do directly for a non completely multiplicative f, but f(p) is
+// usually a polynomial in p, so it is a combination of `prime_power_sums`:
+//   sigma: (p + 1)   -> prime_power_sums(N, 1) + prime_power_sums(N, 0)
+//   phi:   (p - 1)   -> prime_power_sums(N, 1) - prime_power_sums(N, 0)
+//   tau:   2         -> prime_power_sums(N, 0) * 2
+//   mu:    -1        -> prime_power_sums(N, 0) * -1
+template<typename R, typename Callable>
+R multiplicative_sum(std::uint64_t n, Callable &&callable, const QuotientTable<R> &prime_sums)
+{
+  if (n == 0) return R{ 0 };
+  const std::uint64_t sq = isqrt(n);
+  std::vector<std::uint64_t> primes;
+  for (std::uint64_t p : { 2, 3, 5 }) {
+    if (p <= sq) primes.push_back(p);
+  }
+  for (std::uint64_t p : sieving_primes(n)) primes.push_back(p);
+  // f(p) for primes smaller than primes[j] summed up, and f(p^e) for every p <= sqrt(N), p^e <= N
+  std::vector<R> below{ R{ 0 } };
+  std::vector<std::size_t> offsets{ 0 };
+  std::vector<R> values;
+  for (auto p : primes) {
+    below.push_back(prime_sums.at(p));
+    std::uint64_t pe = p;
+    for (ExponentType e = 1;; ++e) {
+      values.push_back(static_cast<R>(callable(static_cast<R>(p), e)));
+      if (pe > n / p) break;
+      pe *= p;
+    }
+    offsets.push_back(values.size());
+  }
+
+  // f(m) summed over 2 <= m <= x whose smallest prime factor is at least primes[j]
+  const auto sum = [&](const auto &self, std::uint64_t x, std::size_t j) -> R {
+    if (j < primes.size() ? x < primes[j] : x <= sq) return R{ 0 };
+    // primes in [primes[j], x]
+    R out = prime_sums.at(x) - below[j];
+    for (std::size_t i = j; i < primes.size() && primes[i] * primes[i] <= x; ++i) {
+      const std::uint64_t p = primes[i];
+      const R *f = values.data() + offsets[i];
+      std::uint64_t pe = p;
+      for (std::size_t e = 0; pe <= x / p; ++e, pe *= p) {
+        // p^(e+1) * (something with larger prime factors), and p^(e+2) on its own
+        out += f[e] * self(self, x / pe, i + 1) + f[e + 1];
+      }
+    }
+    return out;
+  };
+  return R{ 1 } + sum(sum, n, 0);
+}
+
+}// namespace ivl::nt
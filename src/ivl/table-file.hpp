@@ -0,0 +1,524 @@
+#pragma once
+
+// precomputed tables on disk, mapped at startup instead of rebuilt
+// a file holds any number of named sections, each one of
+// * primes: the bitset of `SegmentedSieve` over [7, limit], byte k bit i is 30k + wheel30::residues[i]
+// * spf: the odd entries of `SpfTable` (smallest prime factor of 2i + 1, 0 for primes) for [1, limit]
+// * values: f(0), f(1), ..., f(limit) of some function, in any builtin integer type
+// layout, all little endian:
+// * a header page: `table_file_detail::Header`, then one `table_file_detail::Entry` per section
+// * the sections, each starting on a page boundary, so every section maps to whole pages of its own
+// the header checksums the directory and every entry checksums its section
+//
+// `TableFile` maps the file read only: processes that map the same file share its page cache,
+// nothing is copied and only the pages that get touched are ever read
+// opening checks the header and the directory, reading every section to check it is `verify()`
+// the sections come out as the types the library already knows: `SpfView` (so `factorize(n, file.spf<E>())`),
+// `PrimeBits` and plain spans (see `runtime::with_table` in multi-fns.hpp)
+//
+// TableFileWriter out{ "tables.bin" };
+// out.add_spf("spf", spf_table);// or out.add_spf<std::uint16_t>("spf", limit), without the table in memory
+// out.add_values<std::uint64_t>("sigma", sigma_span);
+// out.finish();// writes "tables.bin.tmp", then renames it over "tables.bin"
+
+#include <ivl/mapped-file.hpp>
+#include <ivl/primes.hpp>
+#include <ivl/spf.hpp>
+#include <ivl/wheel.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+namespace ivl::nt {
+
+class TableFileException : public std::exception
+{
+private:
+  std::string m_message;
+
+public:
+  explicit TableFileException(std::string message) : m_message(std::move(message)) {}
+
+  virtual const char *what() const noexcept override { return m_message.c_str(); }
+};
+
+enum class TableKind : std::uint32_t { primes = 1, spf = 2, values = 3 };
+
+enum class TableElement : std::uint32_t { none = 0, u8, u16, u32, u64, i8, i16, i32, i64 };
+
+template<typename R> constexpr TableElement table_element()
+{
+  static_assert(std::is_integral_v<R> && !std::is_same_v<R, bool> && sizeof(R) <= 8, "builtin integers only");
+  constexpr std::uint32_t log = std::countr_zero(sizeof(R));
+  return static_cast<TableElement>((std::is_signed_v<R> ? 5 : 1) + log);
+}
+
+constexpr std::size_t table_element_size(TableElement element)
+{
+  if (element == TableElement::none) return 1;
+  return std::size_t{ 1 } << ((static_cast<std::uint32_t>(element) - 1) % 4);
+}
+
+static_assert(table_element<std::uint16_t>() == TableElement::u16);
+static_assert(table_element<std::int64_t>() == TableElement::i64 && table_element<std::int8_t>() == TableElement::i8);
+static_assert(table_element_size(TableElement::i32) == 4 && table_element_size(TableElement::u8) == 1);
+
+namespace table_file_detail {
+
+  inline constexpr std::uint32_t version = 1;
+  inline constexpr std::array<char, 8> magic{ 'i', 'v', 'l', 'n', 't', 't', 'b', 'l' };
+  inline constexpr std::uint64_t page = 4096;
+
+  struct Header
+  {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t sections;
+    std::uint64_t file_size;
+    std::uint64_t directory_checksum;
+    std::array<std::uint8_t, 32> reserved;
+  };
+
+  struct Entry
+  {
+    std::array<char, 16> name;// zero padded
+    TableKind kind;
+    TableElement element;
+    std::uint64_t limit;
+    std::uint64_t offset;// from the start of the file, a multiple of `page`
+    std::uint64_t bytes;
+    std::uint64_t checksum;
+    std::uint64_t reserved;
+  };
+
+  static_assert(sizeof(Header) == 64 && sizeof(Entry) == 64 && std::is_trivially_copyable_v<Entry>);
+
+  // as many sections as fit in the header page
+  inline constexpr std::size_t max_sections = (page - sizeof(Header)) / sizeof(Entry);
+
+  // what a section of that kind and limit has to hold, nothing if that doesn't fit in 64 bits
+  // (the limit of a corrupt entry can be anything, a product that wraps around could match its size)
+  constexpr std::optional<std::uint64_t> expected_bytes(TableKind kind, TableElement element, std::uint64_t limit)
+  {
+    constexpr std::uint64_t max = std::numeric_limits<std::uint64_t>::max();
+    const std::uint64_t size = table_element_size(element);
+    switch (kind) {
+    case TableKind::primes: return limit / 30 + 1;
+    case TableKind::spf: return limit / 2 + 1 > max / size ? std::nullopt : std::optional{ (limit / 2 + 1) * size };
+    case TableKind::values:
+      return limit >= max / size ? std::nullopt : std::optional{ (limit + 1) * size };
+    }
+    return std::nullopt;
+  }
+
+  static_assert(expected_bytes(TableKind::values, TableElement::u64, std::uint64_t{ 1 } << 61) == std::nullopt);
+  static_assert(expected_bytes(TableKind::values, TableElement::u64, (std::uint64_t{ 1 } << 61) - 2) == ~7ULL);
+  static_assert(expected_bytes(TableKind::spf, TableElement::u16, ~0ULL) == std::nullopt);
+
+  // four independent multiply-rotate lanes over 64bit words, runs at memory speed
+  // the bytes can come in pieces of any size, the result is the same
+  class Checksum
+  {
+  private:
+    static constexpr std::uint64_t multiplier = 0x9e3779b97f4a7c15ULL;
+
+    std::array<std::uint64_t, 4> m_lanes{ 1, 2, 3, 4 };
+    std::array<unsigned char, 32> m_pending{};
+    std::size_t m_pending_size = 0;
+    std::uint64_t m_length = 0;
+
+    void block(const unsigned char *data)
+    {
+      for (std::size_t i = 0; i < 4; ++i) {
+        std::uint64_t word;
+        std::memcpy(&word, data + 8 * i, 8);
+        m_lanes[i] = std::rotl((m_lanes[i] ^ word) * multiplier, 31);
+      }
+    }
+
+  public:
+    void update(const void *data, std::size_t size)
+    {
+      auto bytes = static_cast<const unsigned char *>(data);
+      m_length += size;
+      if (m_pending_size != 0) {
+        const std::size_t take = std::min(size, m_pending.size() - m_pending_size);
+        std::memcpy(m_pending.data() + m_pending_size, bytes, take);
+        m_pending_size += take;
+        bytes += take;
+        size -= take;
+        if (m_pending_size < m_pending.size()) return;
+        block(m_pending.data());
+        m_pending_size = 0;
+      }
+      for (; size >= 32; bytes += 32, size -= 32) block(bytes);
+      std::memcpy(m_pending.data(), bytes, size);
+      m_pending_size = size;
+    }
+
+    std::uint64_t digest() const
+    {
+      Checksum copy = *this;
+      if (copy.m_pending_size != 0) {
+        std::fill(copy.m_pending.begin() + static_cast<std::ptrdiff_t>(copy.m_pending_size), copy.m_pending.end(), 0);
+        copy.block(copy.m_pending.data());
+      }
+      std::uint64_t out = m_length * multiplier;
+      for (auto lane : copy.m_lanes) out = std::rotl((out ^ lane) * multiplier, 27);
+      return out;
+    }
+  };
+
+  inline std::uint64_t checksum(const void *data, std::size_t size)
+  {
+    Checksum c;
+    c.update(data, size);
+    return c.digest();
+  }
+
+  inline bool little_endian() { return std::endian::native == std::endian::little; }
+
+}// namespace table_file_detail
+
+// the primes up to `limit()` as `TableKind::primes` stores them
+class PrimeBits
+{
+private:
+  std::uint64_t m_limit;
+  std::span<const std::uint8_t> m_bits;
+
+public:
+  PrimeBits(std::uint64_t limit, std::span<const std::uint8_t> bits) : m_limit(limit), m_bits(bits)
+  {
+    if (bits.size() != limit / 30 + 1) throw TableFileException{ "prime bitset of the wrong size" };
+  }
+
+  std::uint64_t limit() const { return m_limit; }
+
+  // `n` has to be at most `limit()`
+  bool is_prime(std::uint64_t n) const
+  {
+    if (n < 7) return n == 2 || n == 3 || n == 5;
+    const std::uint8_t i = wheel30::index[n % 30];
+    return i != 8 && (m_bits[n / 30] >> i & 1);
+  }
+
+  std::span<const std::uint8_t> bits() const { return m_bits; }
+};
+
+// writes the file section by section, so only one table has to be in memory at a time
+class TableFileWriter
+{
+private:
+  std::string m_path;
+  std::string m_temporary;
+  std::ofstream m_out;
+  std::vector<table_file_detail::Entry> m_entries;
+  std::uint64_t m_offset = table_file_detail::page;
+  table_file_detail::Checksum m_checksum;
+  bool m_open_section = false;
+  bool m_finished = false;
+
+  void write(const void *data, std::size_t size)
+  {
+    m_out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    if (!m_out) throw TableFileException{ "writing " + m_temporary + " failed" };
+  }
+
+  void pad_to_page()
+  {
+    static constexpr std::array<char, table_file_detail::page> zeros{};
+    const std::uint64_t rest = (table_file_detail::page - m_offset % table_file_detail::page) % table_file_detail::page;
+    write(zeros.data(), rest);
+    m_offset += rest;
+  }
+
+public:
+  explicit TableFileWriter(std::string path)
+    : m_path(std::move(path)), m_temporary(m_path + ".tmp"), m_out(m_temporary, std::ios::binary | std::ios::trunc)
+  {
+    if (!table_file_detail::little_endian()) throw TableFileException{ "table files are little endian only" };
+    if (!m_out) throw TableFileException{ "can't create " + m_temporary };
+    // the header page goes in last, once the directory is known
+    const std::array<char, table_file_detail::page> zeros{};
+    write(zeros.data(), zeros.size());
+  }
+
+  TableFileWriter(const TableFileWriter &) = delete;
+  TableFileWriter &operator=(const TableFileWriter &) = delete;
+
+  // without `finish()` nothing but the temporary file was ever written, it goes away
+  ~TableFileWriter()
+  {
+    if (m_finished) return;
+    m_out.close();
+    std::error_code ignored;
+    std::filesystem::remove(m_temporary, ignored);
+  }
+
+  // a section written in pieces: `begin_section`, any number of `append`s, `end_section`
+  void begin_section(std::string_view name, TableKind kind, TableElement element, std::uint64_t limit)
+  {
+    if (m_open_section) throw TableFileException{ "the previous section isn't finished" };
+    if (name.empty() || name.size() >= 16) throw TableFileException{ "section names are 1 to 15 characters" };
+    if (m_entries.size() == table_file_detail::max_sections) throw TableFileException{ "too many sections" };
+    for (const auto &entry : m_entries) {
+      if (std::string_view{ entry.name.data() } == name) {
+        throw TableFileException{ "duplicate section " + std::string{ name } };
+      }
+    }
+    table_file_detail::Entry entry{};
+    std::copy(name.begin(), name.end(), entry.name.begin());
+    entry.kind = kind;
+    entry.element = element;
+    entry.limit = limit;
+    entry.offset = m_offset;
+    m_entries.push_back(entry);
+    m_checksum = {};
+    m_open_section = true;
+  }
+
+  void append(const void *data, std::size_t size)
+  {
+    if (!m_open_section) throw TableFileException{ "no section to append to" };
+    write(data, size);
+    m_checksum.update(data, size);
+    m_entries.back().bytes += size;
+    m_offset += size;
+  }
+
+  void end_section()
+  {
+    if (!m_open_section) throw TableFileException{ "no section to end" };
+    auto &entry = m_entries.back();
+    if (entry.bytes != table_file_detail::expected_bytes(entry.kind, entry.element, entry.limit)) {
+      throw TableFileException{ "section " + std::string{ entry.name.data() } + " has the wrong size" };
+    }
+    entry.checksum = m_checksum.digest();
+    m_open_section = false;
+    pad_to_page();
+  }
+
+  // the primes up to `limit`, sieved a segment at a time straight into the file
+  void add_primes(std::string_view name, std::uint64_t limit)
+  {
+    begin_section(name, TableKind::primes, TableElement::u8, limit);
+    std::uint64_t written = 0;
+    if (limit >= 7) {
+      const auto base = sieving_primes(limit);
+      SegmentedSieve sieve{ 7, limit, base };
+      while (sieve.next_segment()) {
+        // the segment is padded to whole words, only whole bytes of [0, limit / 30] go out
+        const auto bytes = sieve.segment().first(
+          static_cast<std::size_t>(std::min<std::uint64_t>(sieve.segment().size(), limit / 30 + 1 - written)));
+        append(bytes.data(), bytes.size());
+        written += bytes.size();
+      }
+    }
+    const std::uint8_t zero = 0;
+    for (; written < limit / 30 + 1; ++written) append(&zero, 1);
+    end_section();
+  }
+
+  template<typename E> void add_spf(std::string_view name, const SpfTable<E> &table)
+  {
+    begin_section(name, TableKind::spf, table_element<E>(), table.limit());
+    append(table.entries().data(), table.entries().size_bytes());
+    end_section();
+  }
+
+  // the same section without the table, sieved `window` entries at a time straight into the file
+  template<typename E> void add_spf(std::string_view name, std::uint64_t limit, std::size_t window = 1 << 22)
+  {
+    const SpfSegments<E> segments{ limit };
+    begin_section(name, TableKind::spf, table_element<E>(), limit);
+    const std::uint64_t count = limit / 2 + 1;
+    std::vector<E> entries(static_cast<std::size_t>(std::min<std::uint64_t>(count, std::max<std::size_t>(window, 1))));
+    for (std::uint64_t first = 0; first < count; first += entries.size()) {
+      const auto size = static_cast<std::size_t>(std::min<std::uint64_t>(count - first, entries.size()));
+      const auto part = std::span{ entries }.first(size);
+      segments.fill(first, part);
+      append(part.data(), part.size_bytes());
+    }
+    end_section();
+  }
+
+  // f(0), ..., f(values.size() - 1)
+  template<typename R> void add_values(std::string_view name, std::span<const R> values)
+  {
+    if (values.empty()) throw TableFileException{ "a values section needs at least f(0)" };
+    begin_section(name, TableKind::values, table_element<R>(), values.size() - 1);
+    append(values.data(), values.size_bytes());
+    end_section();
+  }
+
+  // writes the header and moves the file into place, readers see either the old file or the whole new one
+  void finish()
+  {
+    if (m_open_section) throw TableFileException{ "the last section isn't finished" };
+    table_file_detail::Header header{};
+    header.magic = table_file_detail::magic;
+    header.version = table_file_detail::version;
+    header.sections = static_cast<std::uint32_t>(m_entries.size());
+    header.file_size = m_offset;
+    header.directory_checksum =
+      table_file_detail::checksum(m_entries.data(), m_entries.size() * sizeof(table_file_detail::Entry));
+    m_out.seekp(0);
+    write(&header, sizeof(header));
+    write(m_entries.data(), m_entries.size() * sizeof(table_file_detail::Entry));
+    m_out.close();
+    if (!m_out) throw TableFileException{ "writing " + m_temporary + " failed" };
+    std::filesystem::rename(m_temporary, m_path);
+    m_finished = true;
+  }
+};
+
+// a table file, mapped where there is mmap and read into memory otherwise
+class TableFile
+{
+private:
+  std::string m_path;
+#ifdef IVL_NT_MMAP
+  std::unique_ptr<MappedFile> m_mapped;
+#else
+  std::unique_ptr<std::uint64_t[]> m_buffer;// page aligned sections stay 8 byte aligned at least
+#endif
+  const unsigned char *m_data = nullptr;
+  std::size_t m_size = 0;
+  std::vector<table_file_detail::Entry> m_entries;
+
+  [[noreturn]] void fail(const std::string &what) const { throw TableFileException{ m_path + ": " + what }; }
+
+  const table_file_detail::Entry &find(std::string_view name, TableKind kind, TableElement element) const
+  {
+    for (const auto &entry : m_entries) {
+      if (std::string_view{ entry.name.data() } != name) continue;
+      if (entry.kind != kind || (element != TableElement::none && entry.element != element)) {
+        fail("section " + std::string{ name } + " isn't of the requested kind or type");
+      }
+      return entry;
+    }
+    fail("no section " + std::string{ name });
+  }
+
+  template<typename R> std::span<const R> data(const table_file_detail::Entry &entry) const
+  {
+    return { reinterpret_cast<const R *>(m_data + entry.offset), static_cast<std::size_t>(entry.bytes / sizeof(R)) };
+  }
+
+public:
+  explicit TableFile(std::string path) : m_path(std::move(path))
+  {
+    using namespace table_file_detail;
+    if (!little_endian()) fail("table files are little endian only");
+#ifdef IVL_NT_MMAP
+    try {
+      m_mapped = std::make_unique<MappedFile>(m_path, MappedAccess::random);
+    } catch (const std::system_error &e) {
+      fail(e.what());
+    }
+    m_data = reinterpret_cast<const unsigned char *>(m_mapped->view().data());
+    m_size = m_mapped->view().size();
+#else
+    std::ifstream in{ m_path, std::ios::binary | std::ios::ate };
+    if (!in) fail("can't open it");
+    m_size = static_cast<std::size_t>(in.tellg());
+    m_buffer = std::make_unique<std::uint64_t[]>(m_size / 8 + 1);
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(m_buffer.get()), static_cast<std::streamsize>(m_size));
+    if (!in) fail("can't read it");
+    m_data = reinterpret_cast<const unsigned char *>(m_buffer.get());
+#endif
+    Header header;
+    if (m_size < page) fail("too short for a table file");
+    std::memcpy(&header, m_data, sizeof(header));
+    if (header.magic != magic) fail("not a table file");
+    if (header.version != version) fail("table file version " + std::to_string(header.version) + " isn't supported");
+    if (header.file_size != m_size) fail("truncated");
+    if (header.sections > max_sections) fail("corrupt directory");
+    m_entries.resize(header.sections);
+    std::memcpy(m_entries.data(), m_data + sizeof(header), m_entries.size() * sizeof(Entry));
+    if (checksum(m_entries.data(), m_entries.size() * sizeof(Entry)) != header.directory_checksum) {
+      fail("corrupt directory");
+    }
+    for (const auto &entry : m_entries) {
+      const bool named = entry.name.back() == '\0' && entry.name.front() != '\0';
+      if (!named || entry.offset % page != 0 || entry.offset < page || entry.offset > m_size
+          || entry.bytes > m_size - entry.offset
+          || entry.bytes != expected_bytes(entry.kind, entry.element, entry.limit)) {
+        fail("corrupt directory");
+      }
+    }
+  }
+
+  TableFile(const TableFile &) = delete;
+  TableFile &operator=(const TableFile &) = delete;
+
+  struct Section
+  {
+    std::string name;
+    TableKind kind;
+    TableElement element;
+    std::uint64_t limit;
+    std::uint64_t bytes;
+  };
+
+  std::vector<Section> sections() const
+  {
+    std::vector<Section> out;
+    for (const auto &e : m_entries) out.push_back({ e.name.data(), e.kind, e.element, e.limit, e.bytes });
+    return out;
+  }
+
+  bool contains(std::string_view name) const
+  {
+    return std::any_of(m_entries.begin(), m_entries.end(),
+      [&](const auto &entry) { return std::string_view{ entry.name.data() } == name; });
+  }
+
+  // reads every section and compares checksums, throws on the first mismatch
+  void verify() const
+  {
+    for (const auto &entry : m_entries) {
+      if (table_file_detail::checksum(m_data + entry.offset, entry.bytes) != entry.checksum) {
+        fail("section " + std::string{ entry.name.data() } + " is corrupt");
+      }
+    }
+  }
+
+  PrimeBits primes(std::string_view name = "primes") const
+  {
+    const auto &entry = find(name, TableKind::primes, TableElement::none);
+    return { entry.limit, data<std::uint8_t>(entry) };
+  }
+
+  template<typename E> SpfView<E> spf(std::string_view name = "spf") const
+  {
+    const auto &entry = find(name, TableKind::spf, table_element<E>());
+    return { entry.limit, data<E>(entry) };
+  }
+
+  // f(0), ..., f(limit)
+  template<typename R> std::span<const R> values(std::string_view name) const
+  {
+    return data<R>(find(name, TableKind::values, table_element<R>()));
+  }
+};
+
+}// namespace ivl::nt
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace ivl::nt::wheel30 {
+
+// numbers coprime to 30 are exactly 30k + residues[i]
+inline constexpr std::array<std::uint8_t, 8> residues{ 1, 7, 11, 13, 17, 19, 23, 29 };
+
+// residues[i + 1] - residues[i], the last one wraps around to 31
+inline constexpr std::array<std::uint8_t, 8> gaps{ 6, 4, 2, 4, 2, 4, 6, 2 };
+
+// position of `r` in `residues`, 8 if `r` isn't coprime to 30
+inline constexpr std::array<std::uint8_t, 30> index = [] {
+  std::array<std::uint8_t, 30> out{};
+  out.fill(8);
+  for (std::uint8_t i = 0; i < 8; ++i) out[residues[i]] = i;
+  return out;
+}();
+
+static_assert(index[1] == 0 && index[29] == 7 && index[15] == 8);
+
+}// namespace ivl::nt::wheel30
@@ -1,9 +1,49 @@
+// the tests run with the hot path counters on, so the hooks get exercised too
+#define IVL_NT_INSTRUMENT
+
+#include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
-// #include <ivl/bignum.hpp>
+#include <sstream>
+#include <ivl/bignum.hpp>
+#include <ivl/divisors.hpp>
+#include <ivl/factorization-algebra.hpp>
+#include <ivl/factorization-cache.hpp>
+#include <ivl/factorize.hpp>
+#include <ivl/instrument.hpp>
+#include <ivl/interval-factorize.hpp>
+#include <ivl/lazy.hpp>
+#include <ivl/modint.hpp>
+#include <ivl/multi-fns.hpp>
+#include <ivl/multi-table.hpp>
+#include <ivl/ntt.hpp>
+#include <ivl/pollard-rho.hpp>
+#include <ivl/prime-count.hpp>
+#include <ivl/primes.hpp>
+#include <ivl/safe.hpp>
+#include <ivl/simd-divisibility.hpp>
+#include <ivl/spf.hpp>
+#include <ivl/stream-factorize.hpp>
+#include <ivl/summatory.hpp>
+#include <ivl/table-file.hpp>
 #include <limits>
+#include <numeric>
+#include <random>
+#include <span>
+#include <thread>
+
+#if __has_include(<flint/fmpzxx.h>)
+#include <flint/fmpzxx.h>
+#include <ivl/batch-gcd.hpp>
+#include <ivl/flint-accumulate.hpp>
+#include <ivl/flint-factorize.hpp>
+#define IVL_NT_TEST_FLINT
+#endif
 
 template<typename T> void test_add()
 {
@@ -130,61 +170,17 @@ template<typename T> T complicated_expression()
   return c;
 }
 
-template<typename T, T Mod> struct Mint
-{
-  T m_data;
-
-  Mint &operator+=(Mint arg)
-  {
-    m_data += arg.m_data;
-    m_data %= Mod;
-    return *this;
-  }
-  friend Mint operator+(Mint a, Mint b)
-  {
-    a += b;
-    return a;
-  }
-
-  Mint &operator-=(Mint arg)
-  {
-    m_data -= arg.m_data;
-    m_data %= Mod;
-    if (m_data < 0) m_data += Mod;
-    return *this;
-  }
-  friend Mint operator-(Mint a, Mint b)
-  {
-    a -= b;
-    return a;
-  }
-
-  Mint &operator*=(Mint arg)
-  {
-    m_data *= arg.m_data;
-    m_data %= Mod;
-    return *this;
-  }
-  friend Mint operator*(Mint a, Mint b)
-  {
-    a *= b;
-    return a;
-  }
-};
-
-template<typename T, T Mod> std::ostream &operator<<(std::ostream &out, Mint<T, Mod> m) { return out << m.m_data; }
-
 template<typename T> void test1()
 {
   constexpr std::uint64_t P = 102931;
   // constexpr std::int64_t P = std::numeric_limits<std::int64_t>::max();
-  auto a = complicated_expression<Mint<std::int64_t, P>>();
+  auto a = complicated_expression<ivl::nt::StaticModint<P>>();
   auto b = complicated_expression<T>();
-  auto av = a.m_data;
+  auto av = static_cast<std::int64_t>(a.value());
   auto bv = (b % T{ P }).template get<std::int64_t>();
   if (av != bv) {
     std::cout << "ERROR: " << av << " != " << bv << std::endl;
-    std::cout << "a: " << a.m_data << std::endl;
+    std::cout << "a: " << a << std::endl;
     std::cout << "b: " << b << std::endl;
     exit(1);
   }
@@ -200,15 +196,1306 @@ template<typename T> void multitest()
   test1<T>();
 }
 
+void test_spf()
+{
+  const ivl::nt::SpfTable<std::uint16_t> table{ 200000 };
+  for (std::uint32_t n = 1; n <= 200000; ++n) {
+    if (ivl::nt::factorize(n) != ivl::nt::factorize(n, table)) {
+      std::cout << "spf mismatch at " << n << std::endl;
+      throw 42;
+    }
+  }
+}
+
+void test_pollard_rho()
+{
+  srand(42);
+  for (std::uint32_t i = 0; i < 2000; ++i) {
+    const std::uint64_t n = (static_cast<std::uint64_t>(rand()) << 9) ^ static_cast<std::uint64_t>(rand());
+    if (n == 0) continue;
+    if (ivl::nt::factorize(n) != ivl::nt::factorize(n, ivl::nt::pollard_rho_strategy)) {
+      std::cout << "pollard-rho mismatch at " << n << std::endl;
+      throw 42;
+    }
+  }
+  // semiprimes that trial division can't do
+  const std::uint64_t p = 4294967291ULL;
+  const std::uint64_t q = 4294967279ULL;
+  const ivl::nt::Factorization<std::uint64_t> expected{ { q, 1 }, { p, 1 } };
+  if (ivl::nt::factorize(p * q, ivl::nt::pollard_rho_strategy) != expected) {
+    std::cout << "pollard-rho failed on " << p * q << std::endl;
+    throw 42;
+  }
+}
+
+void test_primes()
+{
+  std::vector<std::uint64_t> sieved;
+  for (auto p : ivl::nt::primes(999000, 1001000)) sieved.push_back(p);
+  std::vector<std::uint64_t> expected;
+  for (std::uint64_t n = 999000; n <= 1001000; ++n) {
+    if (ivl::nt::factorize(n).front().first == n) expected.push_back(n);
+  }
+  if (sieved != expected) {
+    std::cout << "primes(999000, 1001000) has " << sieved.size() << " primes, expected " << expected.size()
+              << std::endl;
+    throw 42;
+  }
+  if (ivl::nt::count_primes(0, 10000000, 4) != 664579) {
+    std::cout << "pi(1e7) mismatch" << std::endl;
+    throw 42;
+  }
+}
+
+void test_interval_factorize()
+{
+  const std::uint64_t lo = 1000000000000ULL - 20000;
+  const std::uint64_t hi = 1000000000000ULL + 20000;
+  const auto interval = ivl::nt::factorize_interval(lo, hi, 3);
+  for (std::uint64_t n = lo; n <= hi; ++n) {
+    const auto expected = ivl::nt::factorize(n, ivl::nt::pollard_rho_strategy);
+    const auto got = interval[n - lo];
+    if (!std::equal(expected.begin(), expected.end(), got.begin(), got.end())) {
+      std::cout << "interval factorization mismatch at " << n << std::endl;
+      throw 42;
+    }
+    if (ivl::nt::generate_all_divisors(got) != ivl::nt::generate_all_divisors(expected)) {
+      std::cout << "divisors of interval factorization mismatch at " << n << std::endl;
+      throw 42;
+    }
+  }
+}
+
+void test_multiplicative_table()
+{
+  constexpr std::size_t n = 100000;
+  ivl::nt::AlignedTable<std::uint64_t> linear(n + 1);
+  ivl::nt::AlignedTable<std::uint64_t> blocked(n + 1);
+  ivl::nt::linear_sieve_table(ivl::nt::powsum, linear.span());
+  ivl::nt::multiplicative_table(ivl::nt::powsum, blocked.span(), 3);
+  for (std::uint64_t i = 1; i <= n; ++i) {
+    if (linear[i] != ivl::nt::sigma_compiletime(i) || blocked[i] != linear[i]) {
+      std::cout << "sigma table mismatch at " << i << std::endl;
+      throw 42;
+    }
+  }
+  // windows that straddle blocks, segments and squares of primes
+  for (std::uint64_t first = 0; first <= n; first += 12345) {
+    std::vector<std::uint64_t> window(std::min<std::uint64_t>(12345, n + 1 - first));
+    ivl::nt::multiplicative_table_window(ivl::nt::powsum, std::span{ window }, first, 2);
+    for (std::size_t i = first == 0 ? 1 : 0; i < window.size(); ++i) {
+      if (window[i] != linear[first + i]) {
+        std::cout << "sigma table window mismatch at " << first + i << std::endl;
+        throw 42;
+      }
+    }
+  }
+  std::vector<std::int8_t> mu(n + 1);
+  ivl::nt::multiplicative_table(ivl::nt::mu_prime_power, std::span{ mu }, 2);
+  for (std::int64_t i = 1; i <= static_cast<std::int64_t>(n); ++i) {
+    if (mu[static_cast<std::size_t>(i)] != ivl::nt::mu_compiletime(i)) {
+      std::cout << "mu table mismatch at " << i << std::endl;
+      throw 42;
+    }
+  }
+}
+
+void test_dirichlet_convolution()
+{
+  // sigma_k = id_k * one with k captured at runtime, the per prime power path against the divisor pairs
+  // (both wrap around modulo 2^64 the same way)
+  for (std::uint32_t k = 0; k < 4; ++k) {
+    const auto id_k = ivl::nt::runtime::multiplicative_completion(
+      [k]<typename T>(T p, std::uint32_t e) -> T { return ivl::nt::pow(p, k * e); });
+    const auto sigma_k = ivl::nt::runtime::dirichlet_convolution(id_k, ivl::nt::one);
+    const auto generic = ivl::nt::runtime::generic_dirichlet_convolution(id_k, ivl::nt::one);
+    static_assert(ivl::nt::MultiplicativeFunction<decltype(sigma_k)>);
+    // the inverse of sigma_k is mu * (mu id_k), convolving both back has to give epsilon
+    const auto mu_id_k = ivl::nt::runtime::multiplicative_completion(
+      [k]<typename T>(T p, std::uint32_t e) -> T { return ivl::nt::mu_prime_power(p, e) * ivl::nt::pow(p, k * e); });
+    const auto inverse = ivl::nt::runtime::dirichlet_convolution(ivl::nt::mu_compiletime, mu_id_k);
+    const auto identity = ivl::nt::runtime::dirichlet_convolution(sigma_k, inverse);
+    for (std::uint64_t n = 1; n <= 2000; ++n) {
+      if (sigma_k(n) != generic(n) || identity(n) != (n == 1 ? 1 : 0)) {
+        std::cout << "dirichlet convolution mismatch at k = " << k << ", n = " << n << std::endl;
+        throw 42;
+      }
+    }
+    const auto f = ivl::nt::merge_factorizations(
+      ivl::nt::factorize(std::uint64_t{ 1 } << 20), ivl::nt::factorize(std::uint64_t{ 59049 * 49 }));
+    if (sigma_k(f) != generic(f)) {
+      std::cout << "dirichlet convolution mismatch at k = " << k << " on 2^20 3^10 7^2" << std::endl;
+      throw 42;
+    }
+  }
+
+  // not multiplicative, so the divisor pairs
+  // 1 on the square free numbers, 2 elsewhere
+  const auto square_free = [](const auto &f) -> std::uint64_t {
+    return std::ranges::all_of(f, [](const auto &pair) { return pair.second <= 1; }) ? 1 : 2;
+  };
+  const auto count = ivl::nt::runtime::dirichlet_convolution(square_free, ivl::nt::one);
+  static_assert(!ivl::nt::MultiplicativeFunction<decltype(count)>);
+  if (count(std::uint64_t{ 12 }) != 8) {
+    std::cout << "dirichlet convolution of a plain function is wrong" << std::endl;
+    throw 42;
+  }
+}
+
+void test_summatory()
+{
+  using ivl::nt::int128_t;
+  constexpr std::uint64_t n = 100000;
+  std::vector<std::int64_t> sigma(n + 1);
+  std::vector<std::int64_t> mu(n + 1);
+  ivl::nt::linear_sieve_table(ivl::nt::powsum, std::span{ sigma });
+  ivl::nt::linear_sieve_table(ivl::nt::mu_prime_power, std::span{ mu });
+  for (std::uint64_t m : { 1, 2, 3, 10, 997, 1024, 12345, 100000 }) {
+    int128_t sigma_sum = 0;
+    int128_t mertens = 0;
+    for (std::uint64_t i = 1; i <= m; ++i) sigma_sum += sigma[i], mertens += mu[i];
+    const auto count = ivl::nt::prime_power_sums<int128_t>(m, 0, 2);
+    const auto sum = ivl::nt::prime_power_sums<int128_t>(m, 1);
+    if (ivl::nt::multiplicative_sum(m, ivl::nt::powsum, sum + count) != sigma_sum
+        || ivl::nt::multiplicative_sum(m, ivl::nt::mu_prime_power, count * int128_t{ -1 }) != mertens) {
+      std::cout << "multiplicative sum mismatch at " << m << std::endl;
+      throw 42;
+    }
+  }
+  if (ivl::nt::prime_power_sums<std::int64_t>(10000000, 0, 3).at(10000000) != 664579) {
+    std::cout << "lucy pi(10^7) mismatch" << std::endl;
+    throw 42;
+  }
+}
+
+void test_prime_count()
+{
+  for (std::uint64_t x : { 0, 1, 2, 100, 65535, 1000003, 123456789 }) {
+    std::uint64_t count = 0;
+    ivl::nt::uint128_t sum = 0;
+    ivl::nt::for_each_prime(1, x, [&](std::uint64_t p) { ++count, sum += p; });
+    if (ivl::nt::pi(x) != count || ivl::nt::prime_sum(x) != sum) {
+      std::cout << "lucy prime count mismatch at " << x << std::endl;
+      throw 42;
+    }
+  }
+  // lucy up to 3 * 10^9, meissel past it, the primes in between counted one at a time
+  std::uint64_t from = 3'000'000'000;
+  std::uint64_t count = ivl::nt::pi(from);
+  ivl::nt::uint128_t sum = ivl::nt::prime_sum(from);
+  for (std::uint64_t x : { 3'000'000'001, 3'000'065'536, 3'001'000'003 }) {
+    ivl::nt::for_each_prime(from + 1, x, [&](std::uint64_t p) { ++count, sum += p; });
+    from = x;
+    if (ivl::nt::pi(x, 2) != count || ivl::nt::prime_sum(x) != sum) {
+      std::cout << "meissel prime count mismatch at " << x << std::endl;
+      throw 42;
+    }
+  }
+  if (ivl::nt::pi(10000000000, 2) != 455052511
+      || ivl::nt::prime_sum(10000000000) != ivl::nt::uint128_t{ 2220822432581729238ULL }) {
+    std::cout << "pi(10^10) mismatch" << std::endl;
+    throw 42;
+  }
+  try {
+    ivl::nt::pi(1'000'000'000'000'000'000, 1, 1 << 20);
+    std::cout << "prime count memory limit ignored" << std::endl;
+    throw 42;
+  } catch (const ivl::nt::PrimeCountMemoryException &) {
+  }
+}
+
+void test_inline_factorization()
+{
+  using Inline = ivl::nt::InlineFactorization<std::uint64_t>;
+  const ivl::nt::SpfTable<> table{ 100000 };
+  for (std::uint64_t n = 1; n <= 100000; ++n) {
+    const auto expected = ivl::nt::factorize(n);
+    const Inline got = ivl::nt::factorize<std::uint64_t, ivl::nt::ExponentType, Inline>(n);
+    if (got != Inline{ expected } || got != ivl::nt::factorize<std::uint64_t, ivl::nt::ExponentType, Inline>(n, table)
+        || got != ivl::nt::factorize<std::uint64_t, ivl::nt::ExponentType, Inline>(n, ivl::nt::pollard_rho_strategy)
+        || ivl::nt::generate_all_divisors(got) != ivl::nt::generate_all_divisors(expected)) {
+      std::cout << "inline factorization mismatch at " << n << std::endl;
+      throw 42;
+    }
+  }
+  // primorial of the first 15 primes, as many distinct primes as 64 bits can hold
+  const std::uint64_t primorial = 614889782588491410ULL;
+  const auto f =
+    ivl::nt::factorize<std::uint64_t, ivl::nt::ExponentType, Inline>(primorial, ivl::nt::pollard_rho_strategy);
+  std::vector<std::uint64_t> walked;
+  for (const auto &divisor : ivl::nt::DivisorIterable{ f }) {
+    if (divisor.value != ivl::nt::id(divisor.factorization)) {
+      std::cout << "divisor iterator value " << divisor.value << " doesn't match its exponents" << std::endl;
+      throw 42;
+    }
+    walked.push_back(divisor.value);
+  }
+  // a copy holds its own divisor, it stays where it was taken while the original moves on
+  auto it = ivl::nt::DivisorIterable{ f }.begin();
+  ++it;
+  ++it;
+  auto copy = it;
+  const auto before = it->value;
+  ++it;
+  if (copy->value != before || it->value == before || (++copy)->value != it->value || ++copy != ++it
+      || copy->value != ivl::nt::id(copy->factorization)) {
+    std::cout << "copies of a divisor iterator don't walk independently" << std::endl;
+    throw 42;
+  }
+  const auto stepped = it->value;
+  const auto old = it++;
+  if (old->value != stepped || it->value == stepped || old->value != ivl::nt::id(old->factorization)) {
+    std::cout << "divisor iterator post-increment doesn't return the divisor before the step" << std::endl;
+    throw 42;
+  }
+  auto all = ivl::nt::generate_all_divisors(f);
+  std::sort(walked.begin(), walked.end());
+  std::sort(all.begin(), all.end());
+  if (f.size() != Inline::capacity() || walked != all) {
+    std::cout << "inline factorization of the primorial is wrong" << std::endl;
+    throw 42;
+  }
+  try {
+    ivl::nt::merge_factorizations(f, Inline{ ivl::nt::Factorization<std::uint64_t>{ { 53, 1 } } });
+    std::cout << "inline factorization capacity ignored" << std::endl;
+    throw 42;
+  } catch (const ivl::nt::FactorizationCapacityException &) {
+  }
+
+  auto left = ivl::nt::make_lazy<std::int64_t>(360);
+  const auto right = ivl::nt::make_lazy<std::int64_t>(-77);
+  ivl::nt::factorize(left);
+  ivl::nt::factorize(right);
+  left *= right;
+  using InlineSigned = ivl::nt::InlineFactorization<std::int64_t>;
+  if (ivl::nt::factorize(left) != ivl::nt::factorize<std::int64_t, ivl::nt::ExponentType, InlineSigned>(27720)) {
+    std::cout << "lazy product factorization mismatch" << std::endl;
+    throw 42;
+  }
+}
+
+void test_factorization_algebra()
+{
+  namespace in = ivl::nt::instrument;
+  using ivl::nt::Factorization, ivl::nt::factorize;
+  using Inline = ivl::nt::InlineFactorization<std::uint64_t>;
+  const auto fail = [](const char *what, std::uint64_t a, std::uint64_t b) {
+    std::cout << "factorization algebra: " << what << " of " << a << " and " << b << std::endl;
+    throw 42;
+  };
+  // products of a few small primes, so that the pairs share some of them and every result fits in 64 bits
+  constexpr std::uint64_t primes[]{ 2, 3, 5, 7, 11, 13, 1009 };
+  std::mt19937_64 rng{ 5 };
+  const auto random = [&] {
+    std::uint64_t n = 1;
+    for (auto k = rng() % 4; k > 0; --k) n *= primes[rng() % std::size(primes)];
+    return n;
+  };
+  for (std::uint32_t round = 0; round < 2000; ++round) {
+    const std::uint64_t a = random(), b = random(), c = random();
+    const Factorization<std::uint64_t> fa = factorize(a), fb = factorize(b);
+    if (ivl::nt::multiply_factorizations(std::vector{ fa, fb, Factorization<std::uint64_t>(factorize(c)) })
+        != factorize(a * b * c)) {
+      fail("product", a, b);
+    }
+    if (ivl::nt::gcd_factorizations(fa, fb) != factorize(std::gcd(a, b))
+        || ivl::nt::gcd_factorizations(Inline{ fa }, Inline{ fb }) != Inline{ factorize(std::gcd(a, b)) }) {
+      fail("gcd", a, b);
+    }
+    if (ivl::nt::lcm_factorizations(fa, fb) != factorize(std::lcm(a, b))) fail("lcm", a, b);
+    if (ivl::nt::divides_factorization(fb, fa) != (a % b == 0)) fail("divisibility", a, b);
+    if (a % b == 0 && ivl::nt::divide_factorizations(Inline{ fa }, Inline{ fb }) != Inline{ factorize(a / b) }) {
+      fail("quotient", a, b);
+    }
+    if (ivl::nt::pow_factorization(fa, 2U) != factorize(a * a)) fail("power", a, b);
+  }
+
+  // a pipeline that never factorizes anything but its inputs
+  using Lazy = ivl::nt::Lazy<ivl::nt::LazyDefaultTraits<std::int64_t>>;
+  std::vector<Lazy> inputs;
+  for (std::int64_t n : { 360, -77, 1009, 12, 49 }) inputs.emplace_back(n);
+  for (const auto &x : inputs) factorize(x);
+  in::reset();
+  const Lazy all = Lazy::product(inputs);
+  const Lazy quotient = all * inputs[0] / inputs[3] / inputs[2];
+  const Lazy squared = quotient.pow(2);
+  const Lazy g = gcd(squared, inputs[0] * inputs[4]);
+  const Lazy l = lcm(inputs[0], inputs[1]);
+  // moves take the factorization along
+  static_assert(std::is_nothrow_move_constructible_v<Lazy> && std::is_nothrow_move_assignable_v<Lazy>);
+  Lazy source = g, assigned{ 1 };
+  const Lazy moved = std::move(source);
+  source = l;
+  assigned = std::move(source);
+  std::vector<std::pair<const Lazy *, std::int64_t>> expected{ { &all, std::int64_t{ 360 } * -77 * 1009 * 12 * 49 },
+    { &quotient, 360 * 360 * -77 * 49 },
+    { &squared, std::int64_t{ 360 * 360 * 77 * 49 } * (360 * 360 * 77 * 49) },
+    { &g, 360 * 49 },
+    { &l, 360 * 77 },
+    { &moved, 360 * 49 },
+    { &assigned, 360 * 77 } };
+  using LazyFactorization = ivl::nt::LazyDefaultTraits<std::int64_t>::FactorizationType;
+  std::vector<LazyFactorization> got;
+  for (const auto &[x, value] : expected) {
+    if (x->get_value() != value) fail("lazy value", static_cast<std::uint64_t>(value), 0);
+    got.push_back(factorize(*x));
+  }
+  const auto s = in::snapshot();
+  if (s[in::Counter::factorizations] != 0 || s[in::Counter::lazy_misses] != 0) fail("lazy refactorization", 0, 0);
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    if (got[i] != factorize<std::int64_t, ivl::nt::ExponentType, LazyFactorization>(expected[i].second)) {
+      fail("lazy factorization", static_cast<std::uint64_t>(expected[i].second), 0);
+    }
+  }
+
+  // not a divisor, seen on the factorizations and on the values
+  for (bool known : { true, false }) {
+    const Lazy x{ 360 }, y{ 7 };
+    if (known) {
+      factorize(x);
+      factorize(y);
+    }
+    try {
+      (void)(x / y);
+      fail("inexact division", 360, 7);
+    } catch (const ivl::nt::FactorizationDivisionException &) {
+    }
+    // 0 is rejected before the values are looked at
+    try {
+      (void)(x / Lazy{ 0 });
+      fail("division by zero", 360, 0);
+    } catch (const ivl::nt::ZeroFactorizationException &) {
+    }
+  }
+}
+
+void test_factorization_cache()
+{
+  ivl::nt::FactorizationCache<std::uint64_t> cache{ 1024, 4 };
+  for (std::uint64_t round = 0; round < 3; ++round) {
+    for (std::uint64_t n = 1; n <= 512; ++n) {
+      if (ivl::nt::factorize(n, cache) != ivl::nt::InlineFactorization<std::uint64_t>{ ivl::nt::factorize(n) }) {
+        std::cout << "cached factorization mismatch at " << n << std::endl;
+        throw 42;
+      }
+    }
+  }
+  const auto warm = cache.stats();
+  if (warm.misses < 512 || warm.hits + warm.misses != 3 * 512 || warm.size > cache.capacity()) {
+    std::cout << "factorization cache counters are off" << std::endl;
+    throw 42;
+  }
+  // way more values than entries, the size stays bounded
+  for (std::uint64_t n = 1; n <= 100000; ++n) ivl::nt::factorize(n, cache);
+  const auto full = cache.stats();
+  if (full.size > cache.capacity() || full.evictions == 0) {
+    std::cout << "factorization cache isn't bounded" << std::endl;
+    throw 42;
+  }
+
+  // one shared `Lazy` hammered from several threads, and the shared cache behind it
+  using Traits = ivl::nt::LazySharedCacheTraits<std::int64_t>;
+  const ivl::nt::Lazy<Traits> lazy{ 2 * 3 * 5 * 7 * 11 * 13 * 17 * 19 * 23LL * 29 * 31 * 37 };
+  std::vector<std::jthread> threads;
+  std::atomic<bool> ok{ true };
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (std::int64_t n = 1; n <= 2000; ++n) {
+        const ivl::nt::Lazy<Traits> other{ n };
+        if (ivl::nt::id(ivl::nt::factorize(other)) != n || ivl::nt::factorize(lazy).size() != 12) ok = false;
+      }
+    });
+  }
+  threads.clear();
+  if (!ok || ivl::nt::shared_factorization_cache<std::int64_t>().stats().hits == 0) {
+    std::cout << "shared lazy factorization is wrong" << std::endl;
+    throw 42;
+  }
+}
+
+void test_safe()
+{
+  using Throwing = ivl::nt::Safe<std::int32_t>;
+  bool thrown = false;
+  try {
+    Throwing{ 1 << 30 } * 4;
+  } catch (const std::exception &) {
+    thrown = true;
+  }
+  if (!thrown) {
+    std::cout << "safe multiplication didn't throw" << std::endl;
+    throw 42;
+  }
+
+  // the batch kernels agree with the scalar `Safe` on every entry and on the overall flag
+  std::vector<std::int32_t> left, right;
+  for (std::int32_t i = -3000; i <= 3000; ++i) {
+    left.push_back(i * 7919);
+    right.push_back(i * i * 113 - 1000000);
+  }
+  std::vector<std::int32_t> sum(left.size()), product(left.size());
+  const bool add_overflow = ivl::nt::batch_add<std::int32_t>(left, right, sum);
+  const bool mul_overflow = ivl::nt::batch_mul<std::int32_t>(left, right, product);
+  using Sticky = ivl::nt::Safe<std::int32_t, ivl::nt::safe_policy::Sticky>;
+  bool sums_overflowed = false, products_overflowed = false;
+  for (std::size_t i = 0; i < left.size(); ++i) {
+    const auto s = Sticky{ left[i] } + right[i];
+    const auto p = Sticky{ left[i] } * right[i];
+    if (s.get() != sum[i] || p.get() != product[i]) {
+      std::cout << "batch arithmetic mismatch at " << left[i] << " " << right[i] << std::endl;
+      throw 42;
+    }
+    if (s.overflowed()) sums_overflowed = true;
+    if (p.overflowed()) products_overflowed = true;
+  }
+  if (add_overflow || sums_overflowed || !mul_overflow || !products_overflowed) {
+    std::cout << "batch overflow flags are off" << std::endl;
+    throw 42;
+  }
+  // comparisons only see the value, not the flag
+  const Sticky wrapped = Sticky{ std::numeric_limits<std::int32_t>::max() } + 1;
+  const Sticky lowest{ std::numeric_limits<std::int32_t>::min() };
+  if (!wrapped.overflowed() || wrapped != lowest || (wrapped <=> lowest) != 0 || !(wrapped < Sticky{ 0 })) {
+    std::cout << "sticky comparisons look at the overflow flag" << std::endl;
+    throw 42;
+  }
+
+  std::vector<std::uint64_t> primes{ 2, 3, 65537, 4294967291ULL };
+  std::vector<std::uint64_t> sigma(primes.size());
+  if (!ivl::nt::batch_powsum<std::uint64_t>(primes, 3, sigma) || sigma[2] != ivl::nt::powsum(65537ULL, 3)) {
+    std::cout << "batch powsum is wrong" << std::endl;
+    throw 42;
+  }
+  if (ivl::nt::batch_powsum<std::uint64_t>(std::span{ primes }.first(3), 3, std::span{ sigma }.first(3))) {
+    std::cout << "batch powsum overflowed on small primes" << std::endl;
+    throw 42;
+  }
+}
+
+struct TestModulusTag
+{
+};
+
+void test_modint()
+{
+  // every reducer against plain 128bit arithmetic
+  const auto check = []<typename M>(M, std::uint64_t n) {
+    std::uint64_t state = 12345;
+    for (int i = 0; i < 20000; ++i) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      const std::uint64_t a = state % n;
+      const std::uint64_t b = (state >> 17) % n;
+      const auto product = static_cast<std::uint64_t>(static_cast<ivl::nt::uint128_t>(a) * b % n);
+      const auto x = ivl::nt::Modint<M>{ a } * ivl::nt::Modint<M>{ b } - ivl::nt::Modint<M>{ b };
+      if (x.value() != (static_cast<ivl::nt::uint128_t>(product) + n - b) % n) {
+        std::cout << "modint mismatch mod " << n << " at " << a << " " << b << std::endl;
+        throw 42;
+      }
+    }
+  };
+  check(ivl::nt::StaticModulus<998244353>{}, 998244353);
+  check(ivl::nt::StaticModulus<(1ULL << 61) - 1>{}, (1ULL << 61) - 1);
+  check(ivl::nt::StaticModulus<1000000006>{}, 1000000006);
+  check(ivl::nt::StaticModulus<(1ULL << 62) + 2>{}, (1ULL << 62) + 2);
+  using Montgomery = ivl::nt::DynamicModulus<TestModulusTag, ivl::nt::Montgomery64>;
+  using Barrett = ivl::nt::DynamicModulus<TestModulusTag, ivl::nt::Barrett32>;
+  for (std::uint64_t n : { 1ULL, 3ULL, 1000000007ULL, 4294967291ULL }) {
+    Barrett::set(n);
+    check(Barrett{}, n);
+  }
+  for (std::uint64_t n : { 1ULL, 18446744073709551557ULL, 1000000000000000003ULL }) {
+    Montgomery::set(n);
+    check(Montgomery{}, n);
+  }
+  bool thrown = false;
+  try {
+    Montgomery::set(1ULL << 40);
+  } catch (const std::exception &) {
+    thrown = true;
+  }
+  if (!thrown) {
+    std::cout << "even modulus accepted by montgomery" << std::endl;
+    throw 42;
+  }
+
+  // `ivl::nt::pow` agrees with the member version, fermat holds
+  using M = ivl::nt::StaticModint<998244353>;
+  if (ivl::nt::pow(M{ 3 }, 998244352) != M{ 1 } || M{ 3 }.pow(998244353 * 5ULL) != ivl::nt::pow(M{ 3 }, 5)) {
+    std::cout << "modint pow is wrong" << std::endl;
+    throw 42;
+  }
+
+  // batch kernels, and the lazy montgomery operations they could be built from
+  std::vector<M> left, right;
+  for (std::uint32_t i = 0; i < 1000; ++i) {
+    left.emplace_back(i * 2654435761U);
+    right.emplace_back(i * i + 17);
+  }
+  std::vector<M> product(left.size()), sum(left.size());
+  ivl::nt::batch_mul<ivl::nt::StaticModulus<998244353>>(left, right, product);
+  ivl::nt::batch_add<ivl::nt::StaticModulus<998244353>>(left, right, sum);
+  const auto &reducer = M::Reducer{ 998244353 };
+  for (std::size_t i = 0; i < left.size(); ++i) {
+    const auto lazy = reducer.shrink(reducer.lazy_mul(reducer.lazy_add(left[i].raw(), left[i].raw()), right[i].raw()));
+    if (product[i] != left[i] * right[i] || sum[i] != left[i] + right[i] || M::raw(lazy) != left[i] * 2 * right[i]) {
+      std::cout << "modint batch mismatch at " << i << std::endl;
+      throw 42;
+    }
+  }
+  // every kernel this cpu can run, not just the best one
+  for (auto level : { ivl::nt::SimdLevel::scalar, ivl::nt::SimdLevel::avx2, ivl::nt::SimdLevel::avx512 }) {
+    if (level > ivl::nt::simd_level) continue;
+    std::vector<M> level_product(left.size()), level_sum(left.size());
+    ivl::nt::batch_mul<ivl::nt::StaticModulus<998244353>>(left, right, level_product, level);
+    ivl::nt::batch_add<ivl::nt::StaticModulus<998244353>>(left, right, level_sum, level);
+    if (level_product != product || level_sum != sum) {
+      std::cout << "modint batch kernels differ between simd levels" << std::endl;
+      throw 42;
+    }
+  }
+  if ((M{ 5 } / M{ 7 }) * 7 != M{ 5 }) {
+    std::cout << "modint division is wrong" << std::endl;
+    throw 42;
+  }
+}
+
+void test_ntt()
+{
+  using M = ivl::nt::StaticModint<998244353>;
+  std::uint64_t state = 777;
+  const auto random = [&] {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 20;
+  };
+  const auto naive = []<typename T>(const std::vector<T> &a, const std::vector<T> &b) {
+    std::vector<T> out(a.size() + b.size() - 1);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      for (std::size_t j = 0; j < b.size(); ++j) out[i + j] += a[i] * b[j];
+    }
+    return out;
+  };
+
+  ivl::nt::Polynomial<ivl::nt::StaticModulus<998244353>> a(1000), b(700);
+  for (auto &x : a) x = random();
+  for (auto &x : b) x = random();
+  if (ivl::nt::convolution(a, b) != naive(a, b)) {
+    std::cout << "ntt convolution is wrong" << std::endl;
+    throw 42;
+  }
+  // non ntt friendly moduli go through crt
+  using P = ivl::nt::StaticModint<1000000007>;
+  std::vector<P> c(a.size()), d(b.size());
+  for (std::size_t i = 0; i < a.size(); ++i) c[i] = a[i].value();
+  for (std::size_t i = 0; i < b.size(); ++i) d[i] = b[i].value();
+  if (ivl::nt::convolution(c, d) != naive(c, d)) {
+    std::cout << "crt convolution is wrong" << std::endl;
+    throw 42;
+  }
+
+  // the roots are cached per modulus, a dynamic one that changes in between gets new ones
+  using D = ivl::nt::DynamicModulus<struct NttModulusTag>;
+  for (std::uint64_t modulus : { 998244353, 1000000007, 469762049 }) {
+    D::set(modulus);
+    ivl::nt::Polynomial<D> e(c.size()), f(d.size());
+    for (std::size_t i = 0; i < c.size(); ++i) e[i] = c[i].value();
+    for (std::size_t i = 0; i < d.size(); ++i) f[i] = d[i].value();
+    if (ivl::nt::convolution(e, f) != naive(e, f)) {
+      std::cout << "convolution with a dynamic modulus of " << modulus << " is wrong" << std::endl;
+      throw 42;
+    }
+  }
+
+  // past the cache block and the threading threshold, threads don't change anything
+  ivl::nt::Polynomial<ivl::nt::StaticModulus<998244353>> big(1 << 17), copy;
+  for (auto &x : big) x = random();
+  copy = big;
+  ivl::nt::ntt<ivl::nt::StaticModulus<998244353>>(big, 1);
+  ivl::nt::ntt<ivl::nt::StaticModulus<998244353>>(copy, 4);
+  if (big != copy) {
+    std::cout << "threaded ntt differs" << std::endl;
+    throw 42;
+  }
+  ivl::nt::inverse_ntt<ivl::nt::StaticModulus<998244353>>(big, 3);
+  ivl::nt::inverse_ntt<ivl::nt::StaticModulus<998244353>>(copy, 1);
+  const auto big_square = ivl::nt::convolution(copy, copy, 4);
+  const std::vector<M> head(big.begin(), big.begin() + 6);
+  if (big != copy || big_square[5] != naive(head, head)[5]) {
+    std::cout << "inverse ntt doesn't invert" << std::endl;
+    throw 42;
+  }
+
+  // series: a * (1 / a) == 1, exp(log(a)) == a
+  a[0] = 1;
+  const std::size_t n = 777;
+  auto one = ivl::nt::convolution(a, ivl::nt::series_inverse(a, n));
+  one.resize(n);
+  auto log_a = ivl::nt::series_log(a, n);
+  auto back = ivl::nt::series_exp(log_a, n);
+  std::vector<M> a_prefix(a.begin(), a.begin() + n), unit(n);
+  unit[0] = 1;
+  if (one != unit || back != a_prefix) {
+    std::cout << "power series inverse / log / exp are wrong" << std::endl;
+    throw 42;
+  }
+
+  // evaluation at many points against horner
+  std::vector<M> points(300);
+  for (auto &x : points) x = random();
+  const auto values = ivl::nt::multipoint_evaluate(b, points);
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    M value;
+    for (std::size_t j = b.size(); j-- > 0;) value = value * points[i] + b[j];
+    if (values[i] != value) {
+      std::cout << "multipoint evaluation is wrong at " << i << std::endl;
+      throw 42;
+    }
+  }
+}
+
+void test_instrument()
+{
+  namespace in = ivl::nt::instrument;
+  static_assert(in::enabled);
+  in::reset();
+  // 1009 * 1013 by trial division: 2, then the odd primes of the small table up to 1009
+  ivl::nt::factorize(std::uint64_t{ 1009 } * 1013);
+  const ivl::nt::Lazy<> lazy{ 720 };
+  ivl::nt::factorize(lazy);
+  ivl::nt::factorize(lazy);
+  for ([[maybe_unused]] const auto &d : ivl::nt::DivisorIterable{ ivl::nt::factorize(lazy) }) {}
+  ivl::nt::factorize(std::uint64_t{ 1000000007 } * 998244353, ivl::nt::pollard_rho_strategy);
+  std::jthread{ [] { ivl::nt::merge_factorizations(ivl::nt::factorize(6), ivl::nt::factorize(10)); } }.join();
+  // one * id per prime power of 2^2 * 3, 3 + 2 products (the divisor pairs were 6)
+  ivl::nt::sigma_dirichlet(12);
+
+  const auto s = in::snapshot();
+  using C = in::Counter;
+  const bool ok = s[C::factorizations] >= 4 && s[C::trial_divisions] > 160 && s[C::rho_iterations] > 0
+                  && s[C::merges] == 1 && s[C::divisors_generated] == 30 && s[C::lazy_hits] == 2
+                  && s[C::lazy_misses] == 1 && s[C::dirichlet_terms] == 5 && s[in::Max::cofactor] == 1013
+                  && s[in::Histogram::cofactor_bits][10] >= 1;
+  std::ostringstream text, json;
+  in::dump_text(text, s);
+  in::dump_json(json, s);
+  if (!ok || text.str().find("merges 1\n") == std::string::npos
+      || json.str().find("\"merges\": 1") == std::string::npos) {
+    std::cout << "instrumentation counters are off:\n";
+    in::dump_text(std::cout, s);
+    throw 42;
+  }
+}
+
+void test_stream_factorize()
+{
+  // uneven spacing, 0 and 1, the largest uint64, and enough numbers to make a lot of tiny chunks
+  std::string input = "12 0\t1\n\n  18446744073709551615\r\n4295098369";
+  for (std::uint64_t i = 0; i < 2000; ++i) {
+    input += i % 7 ? ' ' : '\n';
+    input += std::to_string(i * i * 1000003 + 1);
+  }
+  input += "\n";
+  std::string expected;
+  ivl::nt::stream_detail::parse(input, 0, [&](std::uint64_t n) {
+    expected += std::to_string(n) + ":";
+    if (n > 1) {
+      for (auto [p, e] : ivl::nt::factorize(n)) expected += " " + std::to_string(p) + "^" + std::to_string(e);
+    }
+    expected += "\n";
+  });
+  if (!expected.starts_with("12: 2^2 3^1\n0:\n1:\n"
+                            "18446744073709551615: 3^1 5^1 17^1 257^1 641^1 65537^1 6700417^1\n")) {
+    std::cout << "stream parsing is off" << std::endl;
+    throw 42;
+  }
+
+  const ivl::nt::StreamOptions options{ .threads = 3, .chunk_bytes = 64, .window = 2 };
+  std::ostringstream from_text, from_stream;
+  std::istringstream in{ input };
+  const auto stats = ivl::nt::factorize_stream(input, from_text, options);
+  ivl::nt::factorize_stream(in, from_stream, options);
+  const auto path = std::filesystem::temp_directory_path() / "ivl-nt-test-stream-factorize.txt";
+  std::ofstream{ path } << input;
+  std::ostringstream from_file;
+  ivl::nt::factorize_file(path.string(), from_file, options);
+  std::filesystem::remove(path);
+  if (from_text.str() != expected || from_stream.str() != expected || from_file.str() != expected
+      || stats.numbers != 2005 || stats.chunks < 100 || stats.bytes_in > input.size()
+      || stats.bytes_out != expected.size()) {
+    std::cout << "stream factorization doesn't match factorizing one by one" << std::endl;
+    throw 42;
+  }
+
+  std::ostringstream binary;
+  ivl::nt::factorize_stream("0 1 4295098369", binary, { .format = ivl::nt::StreamFormat::binary });
+  // 0 and 1 with no factors, then 4295098369 = 65537^2
+  const std::string binary_expected{ "\0\0\0\0\0\0\0\0\0"
+                                     "\x01\0\0\0\0\0\0\0\0"
+                                     "\x01\0\x02\0\x01\0\0\0\x01"
+                                     "\x01\0\x01\0\0\0\0\0\x02",
+    36 };
+  if (binary.str() != binary_expected) {
+    std::cout << "binary stream output is off" << std::endl;
+    throw 42;
+  }
+
+  // the error says where
+  const std::pair<std::string, std::uint64_t> bad_inputs[]{
+    { "1 2 x 4", 4 }, { "1 2 18446744073709551616", 4 }, { "1 -2", 2 }, { "1 2.5", 2 }
+  };
+  for (const auto &[bad, offset] : bad_inputs) {
+    bool thrown = false;
+    try {
+      std::ostringstream out;
+      ivl::nt::factorize_stream(bad, out, options);
+    } catch (const ivl::nt::StreamParseException &e) {
+      thrown = e.offset() == offset;
+    }
+    if (!thrown) {
+      std::cout << "stream factorization accepted '" << bad << "'" << std::endl;
+      throw 42;
+    }
+  }
+}
+
+void test_lazy_strategy()
+{
+  // too big for trial division to finish in any reasonable time
+  const std::uint64_t p = 4294967291, q = 4294967279;
+  using Traits = ivl::nt::LazyStrategyTraits<std::uint64_t, ivl::nt::pollard_rho_strategy>;
+  static_assert(ivl::nt::LazyHasStrategy<Traits> && !ivl::nt::LazyHasStrategy<ivl::nt::LazyDefaultTraits<>>);
+  const ivl::nt::Lazy<Traits> lazy{ p * q };
+  const auto &f = ivl::nt::factorize(lazy);
+  if (f.size() != 2 || f.prime(0) != q || f.prime(1) != p || f.exponent(0) != 1 || f.exponent(1) != 1) {
+    std::cout << "Lazy ignored its strategy" << std::endl;
+    throw 42;
+  }
+}
+
+void test_bignum()
+{
+  using ivl::nt::Bignum, ivl::nt::UnsignedBignum, ivl::nt::int128_t, ivl::nt::uint128_t;
+  std::mt19937_64 rng{ 42 };
+  // a random number of random limbs, so that every length of divisor shows up
+  const auto random = [&]<typename T>(std::type_identity<T>) {
+    std::array<std::uint64_t, T::limbs> limbs{};
+    const std::size_t used = 1 + rng() % T::limbs;
+    for (std::size_t i = 0; i < used; ++i) limbs[i] = rng() >> (rng() % 4 == 0 ? rng() % 64 : 0);
+    return T::from_limbs(limbs);
+  };
+  const auto fail = [](const char *what) {
+    std::cout << "bignum: " << what << std::endl;
+    throw 42;
+  };
+
+  // everything against the builtin 128bit types
+  for (std::uint32_t i = 0; i < 20000; ++i) {
+    const auto a = random(std::type_identity<Bignum<128>>{}) * (rng() % 2 ? 1 : -1);
+    const auto b = random(std::type_identity<Bignum<128>>{}) * (rng() % 2 ? 1 : -1);
+    const auto x = a.get<int128_t>(), y = b.get<int128_t>();
+    const auto ux = static_cast<uint128_t>(x), uy = static_cast<uint128_t>(y);
+    const std::size_t shift = rng() % 128;
+    if ((a + b).get<uint128_t>() != ux + uy || (a - b).get<uint128_t>() != ux - uy
+        || (a * b).get<uint128_t>() != ux * uy || (a << shift).get<uint128_t>() != ux << shift
+        || (a >> shift).get<int128_t>() != x >> shift || (a < b) != (x < y) || (a == b) != (x == y)) {
+      fail("+ - * << >> < == disagree with int128");
+    }
+    if (y != 0 && (x / y != (a / b).get<int128_t>() || x % y != (a % b).get<int128_t>())) fail("signed / % disagree");
+    const UnsignedBignum<128> ua{ a }, ub{ b };
+    if (uy != 0 && (ux / uy != (ua / ub).get<uint128_t>() || ux % uy != (ua % ub).get<uint128_t>())) {
+      fail("unsigned / % disagree");
+    }
+  }
+
+  // long division: a == q b + r with |r| < |b|
+  for (std::uint32_t i = 0; i < 20000; ++i) {
+    const auto a = random(std::type_identity<UnsignedBignum<1024>>{});
+    const auto b = random(std::type_identity<UnsignedBignum<1024>>{});
+    if (b == 0) continue;
+    const auto [q, r] = divmod(a, b);
+    if (q * b + r != a || r >= b) fail("long division");
+    // the top bit would make them negative
+    const auto [hq, hr] = divmod(a >> 1, b >> 1 | 1);
+    const Bignum<1024> sa{ a >> 1 }, sb{ -Bignum<1024>{ b >> 1 | 1 } };
+    if (sa / sb != -Bignum<1024>{ hq } || sa % sb != Bignum<1024>{ hr }) fail("signed long division");
+  }
+
+  // karatsuba (two levels of it) against schoolbook, whole and low half
+  for (std::uint32_t i = 0; i < 50; ++i) {
+    const auto a = random(std::type_identity<UnsignedBignum<8192>>{});
+    const auto b = random(std::type_identity<UnsignedBignum<8192>>{});
+    std::array<std::uint64_t, 256> expected{};
+    ivl::nt::bignum_detail::mul_schoolbook(a.limb_array().data(), 128, b.limb_array().data(), 128, expected.data());
+    const auto product = ivl::nt::bignum_detail::mul_full<128>(a.limb_array().data(), b.limb_array().data());
+    if (product != expected || !std::equal(expected.begin(), expected.begin() + 128, (a * b).limb_array().begin())) {
+      fail("karatsuba");
+    }
+  }
+
+  // montgomery against plain arithmetic on twice the width, with moduli up to 2^512 - 1
+  for (std::uint32_t i = 0; i < 500; ++i) {
+    auto n = random(std::type_identity<UnsignedBignum<512>>{}) | 1;
+    if (i % 4 == 0) n |= UnsignedBignum<512>{ 1 } << 511;
+    const ivl::nt::BignumMontgomery<512> mont{ n };
+    const auto a = random(std::type_identity<UnsignedBignum<512>>{}) % n;
+    const auto b = random(std::type_identity<UnsignedBignum<512>>{}) % n;
+    using Wide = UnsignedBignum<1024>;
+    const auto wide_mul = [&](const UnsignedBignum<512> &x, const UnsignedBignum<512> &y) {
+      return UnsignedBignum<512>{ Wide{ x } * Wide{ y } % Wide{ n } };
+    };
+    const UnsignedBignum<512> sum{ (Wide{ a } + Wide{ b }) % Wide{ n } };
+    const auto e = rng() % 100;
+    auto power = UnsignedBignum<512>{ 1 } % n;
+    for (std::uint64_t j = 0; j < e; ++j) power = wide_mul(power, a);
+    if (mont.from(mont.mul(mont.to(a), mont.to(b))) != wide_mul(a, b)
+        || mont.from(mont.add(mont.to(a), mont.to(b))) != sum || mont.add(mont.sub(a, b), b) != a
+        || mont.from(mont.pow(mont.to(a), e)) != power) {
+      fail("montgomery");
+    }
+  }
+
+  // decimal both ways
+  for (std::uint32_t i = 0; i < 2000; ++i) {
+    const auto a = random(std::type_identity<Bignum<1024>>{}) * (rng() % 2 ? 1 : -1);
+    if (Bignum<1024>::parse(a.to_string()) != a) fail("to_string / parse");
+    const auto small = static_cast<std::int64_t>(rng());
+    if (Bignum<256>{ small }.to_string() != std::to_string(small)) fail("to_string");
+  }
+
+  // what factorize, pow and powsum need
+  const Bignum<256> n = Bignum<256>{ 8 } * 3 * 1000003 * 1000033;
+  const ivl::nt::Factorization<Bignum<256>> expected{ { 2, 3 }, { 3, 1 }, { 1000003, 1 }, { 1000033, 1 } };
+  if (ivl::nt::factorize(n) != expected) {
+    fail("factorize");
+  }
+  const Bignum<256> p = 1000003;
+  if (ivl::nt::powsum(p, 10) != (ivl::nt::pow(p, 11) - 1) / (p - 1) || ivl::nt::pow(p, 12).bit_width() != 240) {
+    fail("pow / powsum");
+  }
+}
+
+#ifdef IVL_NT_TEST_FLINT
+void test_flint_accumulate()
+{
+  using flint::fmpzxx;
+  const auto fail = [](const char *what) {
+    std::cout << "flint accumulate: " << what << std::endl;
+    throw 42;
+  };
+  // past what fits in a flint word, so there are limbs to keep
+  fmpzxx big;
+  fmpz_ui_pow_ui(big._fmpz(), 3, 130);
+
+  // the in place `pow`, `powsum` and `id` against the generic loops
+  for (const fmpzxx &n : { fmpzxx{ 1 }, fmpzxx{ 2 }, fmpzxx{ 1000003 }, big }) {
+    for (std::uint32_t e = 0; e < 12; ++e) {
+      fmpzxx power{ 1 }, sum{ 1 };
+      for (std::uint32_t i = 0; i < e; ++i) {
+        power = power * n;
+        sum = sum * n + fmpzxx{ 1 };
+      }
+      if (ivl::nt::pow(n, e) != power || ivl::nt::powsum(n, e) != sum) fail("pow / powsum");
+    }
+  }
+  static_assert(ivl::nt::HasInPlaceArithmetic<fmpzxx>);
+  const ivl::nt::Factorization<fmpzxx> f{ { fmpzxx{ 2 }, 5 }, { fmpzxx{ 3 }, 4 }, { fmpzxx{ 1000003 }, 2 } };
+  const ivl::nt::Factorization<fmpzxx> with_big{ { fmpzxx{ 2 }, 5 }, { big, 2 } };
+  const std::uint64_t small = 32 * 81 * std::uint64_t{ 1000003 } * 1000003;
+  if (ivl::nt::sigma_compiletime(f) != fmpzxx{ ivl::nt::sigma_compiletime(small) }
+      || ivl::nt::id(f) != fmpzxx{ small }) {
+    fail("sigma / id against uint64");
+  }
+  const fmpzxx big_sigma = fmpzxx{ 63 } * (big * big + big + fmpzxx{ 1 }), big_id = fmpzxx{ 32 } * big * big;
+  if (ivl::nt::sigma_compiletime(with_big) != big_sigma || ivl::nt::id(with_big) != big_id) {
+    fail("sigma / id with a big prime");
+  }
+
+  // c = c * a + a * c + b, accumulated and as an expression
+  fmpzxx a{ 123 }, b{ 10219 }, c{ 1092 }, d{ 1092 };
+  for (std::uint32_t i = 0; i < 20; ++i) {
+    ivl::nt::FmpzAccumulator{}.addmul(c, a).addmul(a, c).add(b).store(c);
+    d = d * a + a * d + b;
+    if (c != d) fail("addmul / add");
+  }
+  ivl::nt::FmpzAccumulator acc;
+  acc.sub(std::uint64_t{ 5 }).submul(a, b).mul(fmpzxx{ 3 }).add(std::uint64_t{ 7 }).sub(a);
+  const fmpzxx expected = (fmpzxx{ 0 } - fmpzxx{ 5 } - a * b) * fmpzxx{ 3 } + fmpzxx{ 7 } - a;
+  if (acc.value() != expected) fail("sub / submul / mul");
+  ivl::nt::FmpzAccumulator empty;
+  if (empty.mul(a).value() != fmpzxx{ 0 }) fail("an empty accumulator isn't 0");
+
+  // same sizes over and over, the pool keeps the limbs and nothing allocates once it's warm
+  fmpzxx out;
+  const fmpzxx step_value = big * big + big;
+  const auto step = [&] { ivl::nt::FmpzAccumulator{}.addmul(big, big).add(big).store(out); };
+  for (std::uint32_t i = 0; i < 4; ++i) step();
+  const std::uint64_t before = ivl::nt::fmpz_allocations();
+  for (std::uint32_t i = 0; i < 100; ++i) step();
+  if (ivl::nt::fmpz_allocations() != before || out != step_value) fail("the pool didn't keep its limbs");
+  // bigger than anything flint could have cached
+  fmpzxx huge;
+  fmpz_ui_pow_ui(huge._fmpz(), 7, 100000);
+  if (ivl::nt::fmpz_allocations() == before) fail("fmpz_allocations counts nothing");
+}
+
+void test_flint_factorize()
+{
+  using flint::fmpzxx;
+  const auto from_ui = ivl::nt::flint_detail::from_ui;
+  // a 128bit value from its halves
+  const auto from_halves = [&](std::uint64_t high, std::uint64_t low) {
+    fmpzxx out = from_ui(high);
+    fmpz_mul_2exp(out._fmpz(), out._fmpz(), 64);
+    fmpz_add_ui(out._fmpz(), out._fmpz(), low);
+    return out;
+  };
+  const auto power = [](const fmpzxx &n, std::uint64_t e) {
+    fmpzxx out;
+    fmpz_pow_ui(out._fmpz(), n._fmpz(), e);
+    return out;
+  };
+  const fmpzxx m61 = from_ui((std::uint64_t{ 1 } << 61) - 1), p30 = from_ui(1000000007);
+  const fmpzxx p64 = from_ui(18446744073709551557ull), q64 = from_ui(18446744073709551533ull);
+  const fmpzxx p40 = from_ui(1099511627791ull), q40 = from_ui(1099511627689ull);
+  const std::vector<fmpzxx> inputs{
+    // semiprimes past 64 bits, balanced and not
+    m61 * p30,
+    p40 * q40,
+    // prime powers, and one with small factors around it
+    power(m61, 3),
+    power(p40, 2),
+    fmpzxx{ 1024 } * fmpzxx{ 243 } * power(m61, 2) * p30,
+    // 128bit ones, two 64bit primes and a full width random looking value
+    p64 * q64,
+    from_halves(0xfedcba9876543210ull, 0x0123456789abcdefull),
+  };
+  const auto check = [&](const fmpzxx &n, const ivl::nt::Factorization<fmpzxx> &f) {
+    fmpzxx product{ 1 };
+    for (std::size_t i = 0; i < f.size(); ++i) {
+      const auto &[p, e] = f[i];
+      if (e == 0 || !fmpz_is_probabprime(p._fmpz()) || (i > 0 && fmpz_cmp(f[i - 1].first._fmpz(), p._fmpz()) >= 0)) {
+        std::cout << "flint factorize: a non prime, a repeated or an unsorted factor" << std::endl;
+        throw 42;
+      }
+      product = product * power(p, e);
+    }
+    if (product != n) {
+      std::cout << "flint factorize: the factors don't multiply to the input" << std::endl;
+      throw 42;
+    }
+  };
+  using ivl::nt::FlintStrategyChain, ivl::nt::flint_strategy::FlintFactor;
+  for (const auto &n : inputs) {
+    check(n, ivl::nt::factorize(n, ivl::nt::default_flint_chain));
+    // every stage has to make it alone, the ones that can give up get the last one behind them
+    check(n, ivl::nt::factorize(n, FlintStrategyChain{ FlintFactor{} }));
+    check(n, ivl::nt::factorize(n, FlintStrategyChain{ ivl::nt::flint_strategy::PollardBrent{}, FlintFactor{} }));
+    check(n, ivl::nt::factorize(n, FlintStrategyChain{ ivl::nt::flint_strategy::Ecm{}, FlintFactor{} }));
+    // the sign is dropped
+    fmpzxx negative;
+    fmpz_neg(negative._fmpz(), n._fmpz());
+    check(n, ivl::nt::factorize(negative, ivl::nt::default_flint_chain));
+  }
+  check(power(m61, 3),
+    ivl::nt::factorize(power(m61, 3), ivl::nt::FlintStrategyChain{ ivl::nt::flint_strategy::PerfectPower{} }));
+
+  // trial division can't split two large primes
+  try {
+    ivl::nt::factorize(fmpzxx{ m61 * p64 }, ivl::nt::FlintStrategyChain{ ivl::nt::flint_strategy::TrialDivision{} });
+    std::cout << "flint factorize: trial division split a product of two large primes" << std::endl;
+    throw 42;
+  } catch (const ivl::nt::IncompleteFactorizationException &) {}
+}
+
+void test_batch_gcd()
+{
+  using flint::fmpzxx;
+  const auto fail = [](const char *what) {
+    std::cout << "batch gcd: " << what << std::endl;
+    throw 42;
+  };
+  const auto from_ui = ivl::nt::flint_detail::from_ui;
+  std::mt19937_64 rng{ 42 };
+  const auto random_prime = [&](std::uint32_t bits) {
+    fmpzxx p = from_ui((rng() >> (64 - bits)) | std::uint64_t{ 1 } << (bits - 1) | 1);
+    while (!fmpz_is_probabprime(p._fmpz())) fmpz_add_ui(p._fmpz(), p._fmpz(), 2);
+    return p;
+  };
+
+  // products and remainders against the plain gcd with the product of the others,
+  // from a small pool of primes so that plenty is shared, with negative and repeated values
+  for (std::size_t size : { 1, 2, 3, 7, 40 }) {
+    std::vector<fmpzxx> pool;
+    for (std::uint32_t i = 0; i < 12; ++i) pool.push_back(random_prime(16 + 2 * i));
+    std::vector<fmpzxx> values;
+    for (std::size_t i = 0; i < size; ++i) {
+      fmpzxx x = from_ui(1 + rng() % 100);
+      for (std::uint32_t k = rng() % 4; k-- > 0;) x = x * pool[rng() % pool.size()];
+      if (rng() % 5 == 0) fmpz_neg(x._fmpz(), x._fmpz());
+      values.push_back(x);
+      if (rng() % 6 == 0) values.push_back(x);
+    }
+    for (std::uint32_t threads : { 1u, 3u }) {
+      const auto shared = ivl::nt::batch_gcd(values, threads);
+      if (shared.size() != values.size()) fail("one gcd per value");
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        fmpzxx others{ 1 }, expected;
+        for (std::size_t j = 0; j < values.size(); ++j) {
+          if (j != i) others = others * values[j];
+        }
+        fmpz_gcd(expected._fmpz(), values[i]._fmpz(), others._fmpz());
+        if (shared[i] != expected) fail("differs from the plain gcd");
+      }
+      const auto factorizations = ivl::nt::batch_factorize(values, ivl::nt::default_flint_chain, threads);
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        fmpzxx abs;
+        fmpz_abs(abs._fmpz(), values[i]._fmpz());
+        if (factorizations[i] != ivl::nt::factorize(abs, ivl::nt::default_flint_chain)) {
+          fail("batch_factorize differs from factorize");
+        }
+      }
+    }
+  }
+  if (!ivl::nt::batch_gcd({}).empty()) fail("an empty batch");
+
+  // x = pq next to pr and qs, all of x is shared but p and q are still told apart,
+  // trial division alone can't split any of these, so the batch has to
+  const fmpzxx p = random_prime(60), q = random_prime(61), r = random_prime(62), t = random_prime(63);
+  const std::vector<fmpzxx> values{ p * q, p * r, q * t, p * p * q };
+  const auto factorizations =
+    ivl::nt::batch_factorize(values, ivl::nt::FlintStrategyChain{ ivl::nt::flint_strategy::TrialDivision{} });
+  const auto sorted = [](ivl::nt::Factorization<fmpzxx> f) {
+    std::sort(f.begin(), f.end(),
+      [](const auto &a, const auto &b) { return fmpz_cmp(a.first._fmpz(), b.first._fmpz()) < 0; });
+    return f;
+  };
+  const std::vector<ivl::nt::Factorization<fmpzxx>> expected{ sorted({ { p, 1 }, { q, 1 } }),
+    sorted({ { p, 1 }, { r, 1 } }),
+    sorted({ { q, 1 }, { t, 1 } }),
+    sorted({ { p, 2 }, { q, 1 } }) };
+  if (factorizations != expected) fail("a fully shared value wasn't split");
+
+  try {
+    const std::vector<fmpzxx> with_zero{ from_ui(6), fmpzxx{ 0 } };
+    ivl::nt::batch_gcd(with_zero);
+    fail("a zero got through");
+  } catch (const ivl::nt::BatchGcdZeroException &) {}
+}
+#endif
+
+void test_small_tables()
+{
+  using ivl::nt::small_table_bound, ivl::nt::small_tables;
+  const auto tau = ivl::nt::runtime::multiplicative_completion([](auto, auto e) { return e + 1; });
+  const auto phi = ivl::nt::runtime::multiplicative_completion(ivl::nt::phi_prime_power);
+  for (std::uint32_t n = 1; n < small_table_bound; ++n) {
+    if (ivl::nt::tau_compiletime(n) != tau(n) || ivl::nt::phi_compiletime(n) != phi(n)
+        || (n > 1 && small_tables.spf[n] != ivl::nt::factorize(ivl::nt::uint128_t{ n })[0].first)) {
+      std::cout << "small tables are wrong at " << n << std::endl;
+      throw 42;
+    }
+  }
+
+  // the tabled path (64 bits) against the plain one (128 bits), on both sides of the bound and beyond the primes
+  std::mt19937_64 rng{ 7 };
+  for (std::uint32_t i = 0; i < 5000; ++i) {
+    // random factors below 2^32, so trial division is quick either way
+    std::uint64_t n = 1;
+    while (true) {
+      const std::uint64_t r = 1 + (rng() >> (32 + rng() % 32));
+      if (n > ~std::uint64_t{ 0 } / r) break;
+      n *= r;
+    }
+    const auto expected = ivl::nt::factorize(ivl::nt::uint128_t{ n });
+    const auto got = ivl::nt::factorize(n);
+    if (!std::equal(got.begin(), got.end(), expected.begin(), expected.end(),
+          [](const auto &a, const auto &b) { return a.first == b.first && a.second == b.second; })) {
+      std::cout << "tabled factorization of " << n << " is wrong" << std::endl;
+      throw 42;
+    }
+    for (const auto &d : ivl::nt::small_divisibility_primes) {
+      if (d.divides(n) != (n % d.p == 0)) {
+        std::cout << "divisibility test by " << d.p << " is wrong for " << n << std::endl;
+        throw 42;
+      }
+    }
+  }
+}
+
+void test_simd_divisibility()
+{
+  using ivl::nt::SimdLevel;
+  constexpr std::size_t count = ivl::nt::DivisibilityPrimes::size();
+  std::mt19937_64 rng{ 11 };
+  std::vector<std::uint64_t> values;
+  for (std::uint32_t i = 0; i < 3000; ++i) {
+    // random factors below 2^32 (so that the reference is quick) and a few primes from the table, some of them even
+    std::uint64_t n = 1;
+    while (true) {
+      const std::uint64_t r = (1 + (rng() >> (32 + rng() % 32))) | 1;
+      if (n > ~std::uint64_t{ 0 } / r / 4) break;
+      n *= r;
+    }
+    for (std::uint64_t k = rng() % 4; k > 0; --k) {
+      const std::uint64_t p = ivl::nt::small_divisibility_primes.primes[rng() % count].p;
+      if (n <= ~std::uint64_t{ 0 } / p) n *= p;
+    }
+    values.push_back(n << (rng() % 3 == 0 ? rng() % (std::countl_zero(n) + 1) : 0));
+  }
+
+  for (auto level : { SimdLevel::scalar, SimdLevel::avx2, SimdLevel::avx512 }) {
+    if (level > ivl::nt::simd_level) continue;
+    for (auto n : values) {
+      const std::size_t from = rng() % count, to = from + rng() % (count - from + 1);
+      std::size_t expected = from;
+      while (expected < to && n % ivl::nt::small_divisibility_primes.primes[expected].p != 0) ++expected;
+      if (ivl::nt::first_divisor(n, from, to, level) != expected) {
+        std::cout << "first divisor of " << n << " is wrong at level " << static_cast<int>(level) << std::endl;
+        throw 42;
+      }
+    }
+    for (std::size_t b = 0; b + 64 <= values.size(); b += 64) {
+      const std::size_t k = rng() % 8, size = rng() % 65;
+      std::uint64_t expected = 0;
+      for (std::size_t i = 0; i < size; ++i) {
+        expected |= std::uint64_t{ values[b + i] % ivl::nt::small_divisibility_primes.primes[k].p == 0 } << i;
+      }
+      if (ivl::nt::divisible_mask(values.data() + b, size, k, level) != expected) {
+        std::cout << "divisible mask is wrong at level " << static_cast<int>(level) << std::endl;
+        throw 42;
+      }
+    }
+
+    // what's stripped, then the cofactor, is the whole factorization
+    auto left = values;
+    std::vector<ivl::nt::Factorization<std::uint64_t>> stripped(values.size());
+    ivl::nt::strip_small_factors(
+      left, [&](std::size_t i, std::uint64_t p, std::uint32_t e) { stripped[i].emplace_back(p, e); }, level);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      if (left[i] != 1) {
+        for (const auto &[p, e] : ivl::nt::factorize(left[i])) stripped[i].emplace_back(p, e);
+      }
+      const auto expected = ivl::nt::factorize(ivl::nt::uint128_t{ values[i] });
+      if (!std::equal(stripped[i].begin(), stripped[i].end(), expected.begin(), expected.end(),
+            [](const auto &a, const auto &b) { return a.first == b.first && a.second == b.second; })) {
+        std::cout << "stripping small factors of " << values[i] << " is wrong" << std::endl;
+        throw 42;
+      }
+    }
+  }
+}
+
+void test_table_file()
+{
+  const auto fail = [](const char *what) {
+    std::cout << "table file: " << what << std::endl;
+    throw 42;
+  };
+  constexpr std::uint64_t limit = 100000;
+  const auto path = (std::filesystem::temp_directory_path() / "ivl-nt-test-tables.bin").string();
+  const ivl::nt::SpfTable<std::uint16_t> spf{ limit };
+  std::vector<std::uint64_t> sigma(limit + 1);
+  ivl::nt::multiplicative_table(ivl::nt::powsum, std::span{ sigma }, 2);
+  {
+    ivl::nt::TableFileWriter out{ path };
+    out.add_primes("primes", limit);
+    out.add_spf("spf", spf);
+    out.add_spf<std::uint16_t>("spf-streamed", limit, 4321);
+    out.add_values<std::uint64_t>("sigma", sigma);
+    bool threw = false;
+    try {
+      out.end_section();
+    } catch (const ivl::nt::TableFileException &) {
+      threw = true;
+    }
+    if (!threw) fail("end_section without a section");
+    out.finish();
+  }
+
+  {
+    const ivl::nt::TableFile file{ path };
+    file.verify();
+    if (file.sections().size() != 4 || !file.contains("sigma") || file.contains("tau")) fail("directory");
+    const auto streamed_spf = file.spf<std::uint16_t>("spf-streamed");
+    const auto primes = file.primes();
+    const auto mapped_spf = file.spf<std::uint16_t>();
+    const auto mapped_sigma = file.values<std::uint64_t>("sigma");
+    const auto sigma_of = ivl::nt::runtime::with_table(mapped_sigma, ivl::nt::sigma_compiletime);
+    for (std::uint64_t n = 1; n <= limit; ++n) {
+      if (primes.is_prime(n) != spf.is_prime(n) || (n > 1 && mapped_spf[n] != spf[n])) fail("primes / spf");
+      if (n > 1 && streamed_spf[n] != spf[n]) fail("streamed spf");
+      if (sigma_of(n) != ivl::nt::sigma_compiletime(n)) fail("values");
+    }
+    if (sigma_of(std::uint64_t{ 1000003 } * 3) != 4 * 1000004
+        || ivl::nt::factorize(99990u, mapped_spf) != ivl::nt::factorize(99990u)) {
+      fail("fallback / factorize");
+    }
+    bool threw = false;
+    try {
+      (void)file.values<std::uint32_t>("sigma");
+    } catch (const ivl::nt::TableFileException &) {
+      threw = true;
+    }
+    if (!threw) fail("wrong element type accepted");
+  }
+
+  // one flipped bit in a section is only found by `verify()`, a truncated file already on open
+  const auto expect_failure = [&](auto &&damage, bool on_open) {
+    {
+      std::fstream file{ path, std::ios::in | std::ios::out | std::ios::binary };
+      damage(file);
+    }
+    try {
+      const ivl::nt::TableFile file{ path };
+      if (on_open) fail("damage not found on open");
+      file.verify();
+      fail("damage not found by verify");
+    } catch (const ivl::nt::TableFileException &) {
+    }
+  };
+  expect_failure(
+    [](std::fstream &file) {
+      file.seekg(3 * 4096 + 7);
+      const auto c = static_cast<char>(file.get() ^ 4);
+      file.seekp(3 * 4096 + 7);
+      file.put(c);
+    },
+    false);
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+  expect_failure([](std::fstream &) {}, true);
+  std::filesystem::remove(path);
+}
+
 int main()
 {
-  // multitest<ivl::nt::Bignum<std::int32_t, 10>>();
-  // multitest<ivl::nt::Bignum<std::int32_t, 10000>>();
-  // // multitest<ivl::nt::Bignum<std::int16_t, 10>>();
-  // multitest<ivl::nt::Bignum<std::int32_t, 2>>();
-  // // this is stupid, we dont need Base*Base to be valid, but [0, Base*Base>
-  // // TODO
-  // multitest<ivl::nt::Bignum<std::uint32_t, (1 << 16) - 1>>();
-  // multitest<ivl::nt::Bignum<std::uint64_t, (1ULL << 32) - 1>>();
+  test_spf();
+  test_pollard_rho();
+  test_primes();
+  test_interval_factorize();
+  test_inline_factorization();
+  test_factorization_algebra();
+  test_factorization_cache();
+  test_safe();
+  test_modint();
+  test_ntt();
+  test_instrument();
+  test_stream_factorize();
+  test_lazy_strategy();
+  test_bignum();
+#ifdef IVL_NT_TEST_FLINT
+  test_flint_accumulate();
+  test_flint_factorize();
+  test_batch_gcd();
+#endif
+  test_small_tables();
+  test_simd_divisibility();
+  test_multiplicative_table();
+  test_dirichlet_convolution();
+  test_table_file();
+  test_summatory();
+  test_prime_count();
+
+  // complicated_expression needs ~300 bits
+  multitest<ivl::nt::Bignum<512>>();
+  multitest<ivl::nt::Bignum<1024>>();
   return 0;
 }